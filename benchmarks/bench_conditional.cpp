@@ -0,0 +1,47 @@
+#include <string>
+
+#include "bench_utils.h"
+#include "sheet.h"
+
+namespace {
+
+    /// Pricing model: quantity and unit price inputs, tiered discount, guarded margin ratio
+    /// and a flag column. Every output row is driven by conditional formulas.
+    void BuildPricingModel(spreadsheet::Sheet& sheet, int rows) {
+        for (int row = 0; row < rows; ++row) {
+            const std::string r = std::to_string(row + 1);
+            sheet.SetCell({row, 0}, std::to_string(row % 2000));
+            sheet.SetCell({row, 1}, std::to_string(10 + row % 7));
+            sheet.SetCell({row, 2}, std::to_string(row % 5));
+            sheet.SetCell({row, 3}, "=IF(A" + r + ">1000,B" + r + "*0.8,IF(A" + r + ">100,B" + r + "*0.9,B" + r + "))*A" + r);
+            sheet.SetCell({row, 4}, "=IF(C" + r + "=0,0,D" + r + "/C" + r + ")");
+            sheet.SetCell({row, 5}, "=IF(AND(A" + r + ">0,OR(C" + r + ">2,D" + r + ">5000)),1,0)");
+        }
+    }
+
+    void ReadOutputs(const spreadsheet::Sheet& sheet, int rows) {
+        for (int row = 0; row < rows; ++row) {
+            for (int col = 3; col < 6; ++col) {
+                static_cast<void>(sheet.GetValue({row, col}));
+            }
+        }
+    }
+
+    void BenchConditionalPricing() {
+        constexpr int rows = 10000;
+        spreadsheet::Sheet sheet;
+
+        bench::Report("build pricing model", bench::MeasureMs([&] { BuildPricingModel(sheet, rows); }), std::to_string(rows * 6) + " cells");
+        bench::Report("evaluate all outputs", bench::MeasureMs([&] { ReadOutputs(sheet, rows); }));
+        bench::Report("re-evaluate cached outputs", bench::MeasureMs([&] { ReadOutputs(sheet, rows); }));
+        bench::Report(
+            "edit inputs and re-evaluate", bench::MeasureMs([&] {
+                for (int row = 0; row < rows; row += 10) {
+                    sheet.SetCell({row, 0}, std::to_string(row % 3000));
+                }
+                ReadOutputs(sheet, rows);
+            }));
+    }
+
+    BENCHMARK("conditional/pricing_model", BenchConditionalPricing);
+}
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+
+#include "bench_utils.h"
+#include "graph.h"
+
+namespace {
+
+    constexpr int CHAIN_LENGTH = 200'000;
+    constexpr int CHECKS = 10'000;
+
+    Position GetChainPosition(int index) {
+        return {index % Position::MAX_ROWS, index / Position::MAX_ROWS};
+    }
+
+    /// Cycle checks of new references near the root of a deep model: each cell i references cell i - 1
+    template <typename Graph>
+    double MeasureChecks(const Graph& graph, int checks, size_t& cycles) {
+        return bench::MeasureMs([&] {
+            for (int i = 0; i < checks; ++i) {
+                /// A formula near the end references a cell near the start: no cycle, but all of the chain lies below
+                const Position from = GetChainPosition(CHAIN_LENGTH - 1 - i % 100);
+                const std::vector<Position> refs = {GetChainPosition(i % 100), GetChainPosition(CHAIN_LENGTH / 2 + i)};
+                cycles += graph.DetectCircularDependency(from, refs) ? 1 : 0;
+            }
+        });
+    }
+
+    void BenchDeepModelChecks() {
+        graph::DependencyGraph ordered;
+        graph::DirectedGraph plain;
+        for (int i = 1; i < CHAIN_LENGTH; ++i) {
+            ordered.AddEdge({GetChainPosition(i), GetChainPosition(i - 1)});
+            plain.AddEdge({GetChainPosition(i), GetChainPosition(i - 1)});
+        }
+
+        size_t cycles = 0;
+        const double ordered_ms = MeasureChecks(ordered, CHECKS, cycles);
+        bench::Report("topological order checks", ordered_ms, std::to_string(CHECKS) + " checks over " + std::to_string(CHAIN_LENGTH) + " chain");
+        bench::ReportValue("per check with topological order", ordered_ms * 1000.0 / CHECKS, "us");
+        /// Full searches are slow enough to sample fewer of them
+        const double plain_ms = MeasureChecks(plain, CHECKS / 100, cycles);
+        bench::ReportValue("per check with full search", plain_ms * 1000.0 / (CHECKS / 100), "us");
+        bench::ReportValue("cycles found", static_cast<double>(cycles), "");
+    }
+
+    /// Worst case for the order: each new formula is referenced by all previous ones, so every
+    /// insertion moves the whole chain built so far
+    void BenchReversedChain() {
+        constexpr int LENGTH = 20'000;
+        graph::DependencyGraph graph;
+        const double ms = bench::MeasureMs([&] {
+            for (int i = 1; i < LENGTH; ++i) {
+                const Position from = GetChainPosition(i - 1);
+                const Position to = GetChainPosition(i);
+                if (!graph.DetectCircularDependency(from, {to})) {
+                    graph.AddEdge({from, to});
+                }
+            }
+        });
+        bench::Report("reversed chain insertion", ms, std::to_string(LENGTH) + " cells");
+        bench::ReportValue("per insertion", ms * 1000.0 / LENGTH, "us");
+    }
+
+    BENCHMARK("cycles/deep_model_checks", BenchDeepModelChecks);
+    BENCHMARK("cycles/reversed_chain", BenchReversedChain);
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_utils.h"
+#include "graph.h"
+#include "sheet.h"
+
+namespace {
+
+    /// 1M formulas with 10 references each, spread over the sheet like a large model
+    constexpr int FORMULAS = 1'000'000;
+    constexpr int REFS_PER_FORMULA = 10;
+
+    Position GetFormulaPosition(int index) {
+        return {index % Position::MAX_ROWS, index / Position::MAX_ROWS};
+    }
+
+    Position GetReferencePosition(std::uint64_t& state) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const auto value = static_cast<int>(state >> 33);
+        return {value % Position::MAX_ROWS, 100 + (value / Position::MAX_ROWS) % 200};
+    }
+
+    void BenchGraphMemoryAndTraversal() {
+        graph::DependencyGraph graph;
+        std::uint64_t state = 42;
+        const double build_ms = bench::MeasureMs([&] {
+            for (int i = 0; i < FORMULAS; ++i) {
+                const Position from = GetFormulaPosition(i);
+                for (int j = 0; j < REFS_PER_FORMULA; ++j) {
+                    graph.AddEdge({from, GetReferencePosition(state)});
+                }
+            }
+        });
+        const size_t edges = graph.GetEdgeCount();
+        bench::Report("build", build_ms, std::to_string(edges) + " edges");
+        bench::ReportValue("memory per edge, both directions and vertex ids", static_cast<double>(graph.GetMemoryUsage()) / static_cast<double>(edges),
+                           "bytes");
+
+        size_t visited = 0;
+        double ms = bench::MeasureMs([&] {
+            for (int i = 0; i < FORMULAS; ++i) {
+                for (const graph::Edge& edge : graph.GetIncidentEdges(GetFormulaPosition(i))) {
+                    visited += static_cast<size_t>(edge.to.col);
+                }
+            }
+        });
+        bench::Report("scan forward adjacency", ms);
+        bench::ReportValue("forward scan throughput", static_cast<double>(edges) / ms / 1000.0, "M edges/s");
+
+        ms = bench::MeasureMs([&] {
+            for (int row = 0; row < Position::MAX_ROWS; ++row) {
+                for (const graph::Edge& edge : graph.GetIncidentEdges({row, 100}, graph::DependencyGraph::Direction::backward)) {
+                    visited += static_cast<size_t>(edge.to.row);
+                }
+            }
+        });
+        bench::Report("scan backward adjacency of one column", ms, std::to_string(visited % 2) + " checksum");
+    }
+
+    /// Re-enters formulas in a graph where one input cell is referenced by every formula
+    void BenchGraphEditLatency() {
+        constexpr int EDITS = 100'000;
+        const Position input{0, 99};
+
+        graph::DependencyGraph graph;
+        std::uint64_t state = 7;
+        for (int i = 0; i < FORMULAS; ++i) {
+            const Position from = GetFormulaPosition(i);
+            graph.AddEdge({from, input});
+            for (int j = 1; j < REFS_PER_FORMULA; ++j) {
+                graph.AddEdge({from, GetReferencePosition(state)});
+            }
+        }
+
+        std::vector<double> latencies_us;
+        latencies_us.reserve(EDITS);
+        const double ms = bench::MeasureMs([&] {
+            for (int i = 0; i < EDITS; ++i) {
+                const Position from = GetFormulaPosition(static_cast<int>(state % FORMULAS));
+                const double edit_ms = bench::MeasureMs([&] {
+                    graph.EraseVertex(from);
+                    graph.AddEdge({from, input});
+                    for (int j = 1; j < REFS_PER_FORMULA; ++j) {
+                        graph.AddEdge({from, GetReferencePosition(state)});
+                    }
+                });
+                latencies_us.push_back(edit_ms * 1000.0);
+            }
+        });
+        bench::Report("re-enter formulas", ms, std::to_string(EDITS) + " edits over " + std::to_string(graph.GetEdgeCount()) + " edges");
+
+        std::sort(latencies_us.begin(), latencies_us.end());
+        bench::ReportValue("median edit latency", latencies_us[latencies_us.size() / 2], "us");
+        bench::ReportValue("p99.9 edit latency, including merges", latencies_us[latencies_us.size() * 999 / 1000], "us");
+        bench::ReportValue("max edit latency", latencies_us.back(), "us");
+    }
+
+    /// Loads a 5M-edge model edge by edge and in bulk, and a sheet cell by cell and in one batch
+    void BenchBulkLoad() {
+        constexpr int LOADED_FORMULAS = 500'000;
+        graph::EdgeContainer edges;
+        edges.reserve(static_cast<size_t>(LOADED_FORMULAS) * REFS_PER_FORMULA);
+        std::uint64_t state = 42;
+        for (int i = 0; i < LOADED_FORMULAS; ++i) {
+            for (int j = 0; j < REFS_PER_FORMULA; ++j) {
+                edges.push_back({GetFormulaPosition(i), GetReferencePosition(state)});
+            }
+        }
+
+        graph::DependencyGraph one_by_one;
+        double ms = bench::MeasureMs([&] { std::for_each(edges.begin(), edges.end(), [&](const graph::Edge& edge) { one_by_one.AddEdge(edge); }); });
+        bench::Report("graph, edge by edge", ms, std::to_string(one_by_one.GetEdgeCount()) + " edges");
+
+        graph::DependencyGraph bulk;
+        ms = bench::MeasureMs([&] { bulk.AddEdges(edges.begin(), edges.end()); });
+        bench::Report("graph, AddEdges", ms, std::to_string(bulk.GetEdgeCount()) + " edges");
+
+        constexpr int SHEET_FORMULAS = 100'000;
+        std::vector<std::pair<Position, std::string>> cells;
+        cells.reserve(SHEET_FORMULAS);
+        for (int i = 0; i < SHEET_FORMULAS; ++i) {
+            const Position from = GetFormulaPosition(i);
+            std::string text = "=" + GetReferencePosition(state).ToString();
+            for (int j = 1; j < REFS_PER_FORMULA; ++j) {
+                text += "+" + GetReferencePosition(state).ToString();
+            }
+            cells.emplace_back(from, std::move(text));
+        }
+
+        spreadsheet::Sheet cell_by_cell;
+        ms = bench::MeasureMs([&] { std::for_each(cells.begin(), cells.end(), [&](const auto& cell) { cell_by_cell.SetCell(cell.first, cell.second); }); });
+        bench::Report("sheet, SetCell", ms, std::to_string(SHEET_FORMULAS) + " formulas");
+
+        spreadsheet::Sheet batch;
+        ms = bench::MeasureMs([&] { batch.SetCells(cells); });
+        bench::Report("sheet, SetCells", ms, std::to_string(batch.GetGraph().GetEdgeCount()) + " edges");
+    }
+
+    BENCHMARK("graph/bulk_load", BenchBulkLoad);
+    BENCHMARK("graph/csr_10m_edges", BenchGraphMemoryAndTraversal);
+    BENCHMARK("graph/edit_latency", BenchGraphEditLatency);
+}
@@ -0,0 +1,53 @@
+#include <string>
+#include <vector>
+
+#include "bench_utils.h"
+#include "query.h"
+#include "sheet.h"
+
+namespace {
+
+    using spreadsheet::query::AggregateKind;
+
+    /// Sales table: region, product and amount; the sheet is limited to `Position::MAX_ROWS` rows
+    void BenchSheetGroupBy() {
+        constexpr int rows = Position::MAX_ROWS;
+        spreadsheet::Sheet sheet;
+        for (int row = 0; row < rows; ++row) {
+            sheet.SetCell({row, 0}, "region" + std::to_string(row % 10));
+            sheet.SetCell({row, 1}, std::to_string(row % 1000));
+            sheet.SetCell({row, 2}, std::to_string(row % 97));
+        }
+
+        size_t groups = 0;
+        const double ms = bench::MeasureMs([&] {
+            spreadsheet::query::Query query(sheet);
+            groups = query.GroupBy({0, 1}, {{2, AggregateKind::Sum}, {2, AggregateKind::Average}}).GetGroupCount();
+        });
+        bench::Report("sheet group by 2 keys", ms, std::to_string(rows) + " rows, " + std::to_string(groups) + " groups");
+    }
+
+    /// Aggregation over column data of 5M rows and 10k groups, beyond the sheet size limits
+    void BenchColumnGroupBy() {
+        constexpr size_t rows = 5'000'000;
+        constexpr size_t groups = 10'000;
+        spreadsheet::query::ColumnData keys{std::vector<double>(rows), std::vector<std::string_view>(rows)};
+        spreadsheet::query::ColumnData values{std::vector<double>(rows), std::vector<std::string_view>(rows)};
+        for (size_t row = 0; row < rows; ++row) {
+            keys.numbers[row] = static_cast<double>((row * 7919) % groups);
+            values.numbers[row] = static_cast<double>(row % 1000);
+        }
+
+        for (size_t threads : {1, 2, 4, 8}) {
+            size_t result_groups = 0;
+            const double ms = bench::MeasureMs([&] {
+                result_groups = spreadsheet::query::GroupBy({&keys}, {{&values, AggregateKind::Sum}, {&values, AggregateKind::Max}}, nullptr, threads)
+                                    .GetGroupCount();
+            });
+            bench::Report("5M rows group by, threads " + std::to_string(threads), ms, std::to_string(result_groups) + " groups");
+        }
+    }
+
+    BENCHMARK("query/group_by_sheet", BenchSheetGroupBy);
+    BENCHMARK("query/group_by_columns", BenchColumnGroupBy);
+}
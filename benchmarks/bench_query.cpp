@@ -0,0 +1,77 @@
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "bench_utils.h"
+#include "query.h"
+#include "sheet.h"
+
+namespace {
+
+    using spreadsheet::query::Column;
+
+    /// Orders table: amount, status and a formula column with the amount including tax
+    void BuildOrders(spreadsheet::Sheet& sheet, int rows) {
+        const std::vector<std::string> statuses = {"OPEN", "CLOSED", "PENDING", "CANCELLED"};
+        for (int row = 0; row < rows; ++row) {
+            sheet.SetCell({row, 0}, std::to_string((row * 7919) % 5000));
+            sheet.SetCell({row, 1}, statuses[row % statuses.size()]);
+            sheet.SetCell({row, 2}, "=A" + std::to_string(row + 1) + "*1.2");
+        }
+    }
+
+    /// Row-at-a-time filter through the public cell interface, copying every value
+    std::vector<int> FilterByValues(const spreadsheet::Sheet& sheet, int rows) {
+        std::vector<int> result;
+        for (int row = 0; row < rows; ++row) {
+            const auto amount = sheet.GetValue({row, 2});
+            const auto status = sheet.GetValue({row, 1});
+            const auto* amount_ptr = std::get_if<double>(&amount);
+            const auto* status_ptr = std::get_if<std::string>(&status);
+            if (amount_ptr != nullptr && *amount_ptr > 1000 && status_ptr != nullptr && *status_ptr == "OPEN") {
+                result.push_back(row);
+            }
+        }
+        return result;
+    }
+
+    void BenchQueryFilter() {
+        constexpr int rows = Position::MAX_ROWS;
+        constexpr int repeats = 20;
+        spreadsheet::Sheet sheet;
+        BuildOrders(sheet, rows);
+        FilterByValues(sheet, rows);  // evaluate formulas once
+
+        size_t matched = 0;
+        const auto details = [&matched] {
+            return std::to_string(repeats) + " scans, " + std::to_string(matched) + " rows";
+        };
+
+        double ms = bench::MeasureMs([&] {
+            for (int i = 0; i < repeats; ++i) {
+                matched = FilterByValues(sheet, rows).size();
+            }
+        });
+        bench::Report("value-by-value filter", ms, details());
+
+        ms = bench::MeasureMs([&] {
+            for (int i = 0; i < repeats; ++i) {
+                spreadsheet::query::Query query(sheet);
+                matched = query.SelectAll({Column{2} > 1000., Column{1} == "OPEN"}).ToRows().size();
+            }
+        });
+        bench::Report("query with column extraction", ms, details());
+
+        spreadsheet::query::Query query(sheet);
+        static_cast<void>(query.GetColumn(1));
+        static_cast<void>(query.GetColumn(2));
+        ms = bench::MeasureMs([&] {
+            for (int i = 0; i < repeats; ++i) {
+                matched = query.SelectAll({Column{2} > 1000., Column{1} == "OPEN"}).ToRows().size();
+            }
+        });
+        bench::Report("query over extracted columns", ms, details());
+    }
+
+    BENCHMARK("query/filter_orders", BenchQueryFilter);
+}
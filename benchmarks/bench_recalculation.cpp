@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <string>
+
+#include "bench_utils.h"
+#include "parallel.h"
+#include "sheet.h"
+
+namespace {
+
+    constexpr int CHAIN_LENGTH = 200'000;
+
+    Position GetChainPosition(int index) {
+        return {index % Position::MAX_ROWS, index / Position::MAX_ROWS};
+    }
+
+    void BuildChain(spreadsheet::Sheet& sheet) {
+        sheet.SetCell(GetChainPosition(0), "1");
+        for (int i = 1; i < CHAIN_LENGTH; ++i) {
+            sheet.SetCell(GetChainPosition(i), "=" + GetChainPosition(i - 1).ToString() + "+1");
+        }
+    }
+
+    void BenchDeepChain() {
+        spreadsheet::Sheet sheet;
+        double ms = bench::MeasureMs([&] { BuildChain(sheet); });
+        bench::Report("build chain", ms, std::to_string(CHAIN_LENGTH) + " cells");
+
+        ms = bench::MeasureMs([&] { static_cast<void>(sheet.GetValue(GetChainPosition(CHAIN_LENGTH - 1))); });
+        bench::Report("lazy read of the last cell", ms);
+
+        sheet.SetCell(GetChainPosition(0), "2");
+        ms = bench::MeasureMs([&] { sheet.Recalculate(); });
+        bench::Report("Recalculate after editing the first cell", ms);
+
+        sheet.SetRecalculationMode(spreadsheet::RecalculationMode::eager);
+        ms = bench::MeasureMs([&] { sheet.SetCell(GetChainPosition(0), "3"); });
+        bench::Report("eager edit of the first cell", ms);
+    }
+
+    /// Wide sheet: 16384 independent rows of 8 formulas; deep sheet: 64 chains of 2048 cells
+    void BuildWide(spreadsheet::Sheet& sheet) {
+        for (int row = 0; row < Position::MAX_ROWS; ++row) {
+            const std::string r = std::to_string(row + 1);
+            sheet.SetCell({row, 0}, std::to_string(row % 100));
+            for (int col = 1; col <= 8; ++col) {
+                const std::string prev = Position{row, col - 1}.ToString();
+                sheet.SetCell({row, col}, "=IF(" + prev + ">50," + prev + "*1.01-A" + r + "/7," + prev + "+A" + r + "/3)");
+            }
+        }
+    }
+
+    void BuildDeep(spreadsheet::Sheet& sheet) {
+        for (int col = 0; col < 64; ++col) {
+            sheet.SetCell({0, col}, std::to_string(col));
+            for (int row = 1; row < 2048; ++row) {
+                const std::string prev = Position{row - 1, col}.ToString();
+                sheet.SetCell({row, col}, "=IF(" + prev + ">1000," + prev + "/2," + prev + "*1.5+1)");
+            }
+        }
+    }
+
+    void MeasureScaling(const std::string& name, const std::function<void(spreadsheet::Sheet&)>& build, int inputs_col, int input_count) {
+        spreadsheet::Sheet sheet;
+        sheet.SetRecalculationMode(spreadsheet::RecalculationMode::manual);
+        build(sheet);
+        sheet.Recalculate();
+
+        const size_t max_threads = std::max<size_t>(parallel::ResolveThreadCount(0), 8);
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            /// Starts the workers, so the measured recalculation runs on a pool that is already waiting
+            sheet.SetRecalculationThreads(threads);
+            /// Editing every input recalculates the whole sheet
+            for (int row = 0; row < input_count; ++row) {
+                const Position input = inputs_col >= 0 ? Position{row, inputs_col} : Position{0, row};
+                sheet.SetCell(input, std::to_string(threads + static_cast<size_t>(row) % 13));
+            }
+            const double ms = bench::MeasureMs([&] { sheet.Recalculate(); });
+            bench::Report(name + ", " + std::to_string(threads) + " threads", ms);
+        }
+    }
+
+    /// Clamped inputs feeding long chains: edits inside the saturated range change no clamp value
+    void BenchEarlyCutoff() {
+        constexpr int CHAINS = 64;
+        constexpr int LENGTH = 2048;
+
+        spreadsheet::Sheet sheet;
+        sheet.SetRecalculationMode(spreadsheet::RecalculationMode::manual);
+        for (int col = 0; col < CHAINS; ++col) {
+            const std::string input = Position{0, col}.ToString();
+            sheet.SetCell({0, col}, "500");
+            sheet.SetCell({1, col}, "=MAX(0,MIN(100," + input + "))");
+            for (int row = 2; row < LENGTH; ++row) {
+                sheet.SetCell({row, col}, "=" + Position{row - 1, col}.ToString() + "*1.001+1");
+            }
+        }
+        sheet.Recalculate();
+
+        const auto edit = [&](int value) {
+            for (int col = 0; col < CHAINS; ++col) {
+                sheet.SetCell({0, col}, std::to_string(value + col));
+            }
+        };
+        const auto measure = [&](const std::string& name, int value) {
+            edit(value);
+            spreadsheet::RecalculationStats stats;
+            const double ms = bench::MeasureMs([&] { stats = sheet.Recalculate(); });
+            bench::Report(name, ms, std::to_string(stats.evaluated) + " evaluated, " + std::to_string(stats.revalidated) + " revalidated");
+        };
+
+        measure("edits inside the saturated range", 1000);
+        measure("edits changing every clamp", 10);
+    }
+
+    void BenchParallelScaling() {
+        MeasureScaling("wide sheet recalculation", BuildWide, 0, Position::MAX_ROWS);
+        MeasureScaling("deep sheet recalculation", BuildDeep, -1, 64);
+        bench::ReportValue("hardware threads", static_cast<double>(parallel::ResolveThreadCount(0)), "");
+    }
+
+    /// Edits of one input referenced by every formula of a 16384 x 12 block
+    void BenchEditBurst() {
+        constexpr int COLS = 12;
+        constexpr int EDITS = 1000;
+        const Position input{0, COLS + 1};
+
+        spreadsheet::Sheet sheet;
+        sheet.SetCell(input, "1");
+        for (int row = 0; row < Position::MAX_ROWS; ++row) {
+            for (int col = 0; col < COLS; ++col) {
+                sheet.SetCell({row, col}, "=" + input.ToString() + "+" + std::to_string(col));
+            }
+        }
+        for (int row = 0; row < Position::MAX_ROWS; ++row) {
+            for (int col = 0; col < COLS; ++col) {
+                static_cast<void>(sheet.GetValue({row, col}));
+            }
+        }
+
+        double ms = bench::MeasureMs([&] { sheet.SetCell(input, "2"); });
+        bench::Report("first edit after reading everything", ms, std::to_string(Position::MAX_ROWS * COLS) + " dependents");
+
+        ms = bench::MeasureMs([&] {
+            for (int i = 0; i < EDITS; ++i) {
+                sheet.SetCell(input, std::to_string(i));
+            }
+        });
+        bench::ReportValue("edit in a burst without reads", ms * 1000.0 / EDITS, "us");
+
+        ms = bench::MeasureMs([&] {
+            for (int i = 0; i < EDITS; ++i) {
+                sheet.SetCell(input, std::to_string(i));
+                static_cast<void>(sheet.GetValue({i, 0}));
+            }
+        });
+        bench::ReportValue("edit followed by reading one dependent", ms * 1000.0 / EDITS, "us");
+    }
+
+    /// Slices of a 2 ms budget against one blocking call, after an edit outdating the whole chain
+    void BenchTimeSliced() {
+        spreadsheet::Sheet sheet;
+        sheet.SetRecalculationThreads(1);
+        BuildChain(sheet);
+        sheet.Recalculate();
+
+        sheet.SetCell(GetChainPosition(0), "2");
+        double ms = bench::MeasureMs([&] { sheet.Recalculate(); });
+        bench::Report("Recalculate, one call", ms, std::to_string(CHAIN_LENGTH) + " cells");
+
+        sheet.SetCell(GetChainPosition(0), "3");
+        size_t slices = 0;
+        double longest = 0;
+        ms = bench::MeasureMs([&] {
+            spreadsheet::RecalculationProgress progress;
+            do {
+                longest = std::max(longest, bench::MeasureMs([&] { progress = sheet.RunFor(std::chrono::milliseconds(2)); }));
+                ++slices;
+            } while (!progress.IsComplete());
+        });
+        bench::Report("RunFor(2 ms) until complete", ms, std::to_string(slices) + " slices");
+        bench::Report("longest slice", longest);
+    }
+
+    /// A screen of the wide sheet after an edit of every input, against evaluating the whole sheet
+    void BenchViewport() {
+        static constexpr Rect VIEWPORT{{8000, 0}, {50, 9}};
+
+        spreadsheet::Sheet sheet;
+        BuildWide(sheet);
+        sheet.Recalculate();
+        const auto edit = [&sheet](int round) {
+            for (int row = 0; row < Position::MAX_ROWS; ++row) {
+                sheet.SetCell({row, 0}, std::to_string((row + round) % 100));
+            }
+        };
+
+        edit(1);
+        double ms = bench::MeasureMs([&] { static_cast<void>(sheet.GetValues(VIEWPORT)); });
+        bench::Report("GetValues of one screen", ms, std::to_string(VIEWPORT.size.rows * VIEWPORT.size.cols) + " cells");
+
+        edit(2);
+        std::ostringstream output;
+        ms = bench::MeasureMs([&] { sheet.PrintValues(output); });
+        bench::Report("PrintValues of the whole sheet", ms, std::to_string(Position::MAX_ROWS * 9) + " cells");
+    }
+
+    BENCHMARK("recalc/deep_chain", BenchDeepChain);
+    BENCHMARK("recalc/early_cutoff", BenchEarlyCutoff);
+    BENCHMARK("recalc/edit_burst", BenchEditBurst);
+    BENCHMARK("recalc/parallel_scaling", BenchParallelScaling);
+    BENCHMARK("recalc/time_sliced", BenchTimeSliced);
+    BENCHMARK("recalc/viewport", BenchViewport);
+}
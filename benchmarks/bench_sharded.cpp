@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_utils.h"
+#include "sharded_sheet.h"
+#include "sheet.h"
+
+namespace {
+
+    constexpr int PRODUCERS = 4;
+    constexpr int BAND_ROWS = 2048;
+    constexpr int COLS = 4;
+
+    /// Every producer writes its own band: inputs in A, formulas over the row in the other columns
+    template <typename Write>
+    void Ingest(Write write) {
+        std::vector<std::thread> producers;
+        for (int producer = 0; producer < PRODUCERS; ++producer) {
+            producers.emplace_back([&write, producer] {
+                for (int row = producer * BAND_ROWS; row < (producer + 1) * BAND_ROWS; ++row) {
+                    const std::string r = std::to_string(row + 1);
+                    write(Position{row, 0}, std::to_string(row % 100));
+                    for (int col = 1; col < COLS; ++col) {
+                        write(Position{row, col}, "=" + Position{row, col - 1}.ToString() + "*2+A" + r);
+                    }
+                }
+            });
+        }
+        std::for_each(producers.begin(), producers.end(), [](std::thread& producer) { producer.join(); });
+    }
+
+    void BenchIngest() {
+        const std::string details = std::to_string(PRODUCERS) + " producers, " + std::to_string(PRODUCERS * BAND_ROWS * COLS) + " cells";
+
+        spreadsheet::Sheet sheet;
+        std::mutex mutex;
+        double ms = bench::MeasureMs([&] {
+            Ingest([&](Position pos, std::string text) {
+                const std::lock_guard lock(mutex);
+                sheet.SetCell(pos, std::move(text));
+            });
+        });
+        bench::Report("Sheet behind one mutex", ms, details);
+
+        spreadsheet::ShardedSheet sharded(BAND_ROWS);
+        ms = bench::MeasureMs([&] { Ingest([&](Position pos, std::string text) { sharded.SetCell(pos, std::move(text)); }); });
+        bench::Report("ShardedSheet, one band per producer", ms, details);
+
+        int mismatches = 0;
+        for (int row = 0; row < PRODUCERS * BAND_ROWS; row += 97) {
+            mismatches += sheet.GetValue({row, COLS - 1}) == sharded.GetValue({row, COLS - 1}) ? 0 : 1;
+        }
+        bench::ReportValue("mismatching values", mismatches, "cells");
+    }
+
+    BENCHMARK("sharded/multi_producer_ingest", BenchIngest);
+}
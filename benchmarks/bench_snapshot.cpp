@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_utils.h"
+#include "sheet.h"
+
+namespace {
+
+    constexpr int ROWS = 10'000;
+    constexpr int READERS = 2;
+    constexpr int READS_PER_SNAPSHOT = 1000;
+    constexpr auto DURATION = std::chrono::milliseconds(500);
+
+    /// Inputs in A, formulas over them in B and C
+    void BuildModel(spreadsheet::Sheet& sheet) {
+        std::vector<std::pair<Position, std::string>> cells;
+        for (int row = 0; row < ROWS; ++row) {
+            const std::string r = std::to_string(row + 1);
+            cells.emplace_back(Position{row, 0}, std::to_string(row % 100));
+            cells.emplace_back(Position{row, 1}, "=A" + r + "*2");
+            cells.emplace_back(Position{row, 2}, "=B" + r + "+A" + std::to_string(ROWS - row));
+        }
+        sheet.SetCells(std::move(cells));
+    }
+
+    struct Throughput {
+        double reads_per_ms = 0;
+        double edits_per_ms = 0;
+    };
+
+    /// Runs `read(rng)` on the readers and `write(rng)` on one writer if given, for `DURATION`
+    template <typename Read, typename Write>
+    Throughput Run(Read read, Write write, bool with_writer) {
+        std::atomic<bool> done = false;
+        std::atomic<size_t> reads = 0;
+        size_t edits = 0;
+
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < READERS; ++thread) {
+            threads.emplace_back([&, thread] {
+                std::mt19937 rng(thread);
+                while (!done.load(std::memory_order_relaxed)) {
+                    read(rng);
+                    reads.fetch_add(READS_PER_SNAPSHOT, std::memory_order_relaxed);
+                }
+            });
+        }
+        if (with_writer) {
+            threads.emplace_back([&] {
+                std::mt19937 rng(READERS);
+                while (!done.load(std::memory_order_relaxed)) {
+                    write(rng);
+                    ++edits;
+                }
+            });
+        }
+        std::this_thread::sleep_for(DURATION);
+        done = true;
+        std::for_each(threads.begin(), threads.end(), [](std::thread& thread) { thread.join(); });
+
+        const double ms = std::chrono::duration<double, std::milli>(DURATION).count();
+        return {static_cast<double>(reads.load()) / ms, static_cast<double>(edits) / ms};
+    }
+
+    /// Readers of snapshots against readers holding a shared lock that the writer takes exclusively
+    void BenchReadsUnderWrites() {
+        spreadsheet::Sheet sheet;
+        BuildModel(sheet);
+        std::shared_mutex mutex;
+
+        const auto random_row = [](std::mt19937& rng) { return static_cast<int>(rng() % ROWS); };
+        const auto read_snapshot = [&](std::mt19937& rng) {
+            const auto snapshot = sheet.Snapshot();
+            for (int i = 0; i < READS_PER_SNAPSHOT; ++i) {
+                static_cast<void>(snapshot.GetValue({random_row(rng), 2}));
+            }
+        };
+        const auto read_locked = [&](std::mt19937& rng) {
+            const std::shared_lock lock(mutex);
+            for (int i = 0; i < READS_PER_SNAPSHOT; ++i) {
+                static_cast<void>(sheet.GetValue({random_row(rng), 2}));
+            }
+        };
+        const auto write = [&](std::mt19937& rng) {
+            const std::lock_guard lock(mutex);
+            sheet.SetCell({random_row(rng), 0}, std::to_string(rng() % 100));
+        };
+
+        const auto report = [](const std::string& name, const Throughput& result) {
+            bench::ReportValue(name + " reads", result.reads_per_ms, "reads/ms");
+            if (result.edits_per_ms > 0) {
+                bench::ReportValue(name + " edits", result.edits_per_ms, "edits/ms");
+            }
+        };
+        report("snapshots, no writer", Run(read_snapshot, write, false));
+        report("snapshots, concurrent writer", Run(read_snapshot, write, true));
+        report("shared lock, no writer", Run(read_locked, write, false));
+        report("shared lock, concurrent writer", Run(read_locked, write, true));
+        bench::ReportValue("retained versions", static_cast<double>(sheet.GetVersions().GetRetainedCount()), "entries");
+    }
+
+    BENCHMARK("snapshot/reads_under_writes", BenchReadsUnderWrites);
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "bench_utils.h"
+#include "sheet.h"
+
+namespace {
+
+    std::string MakeFormula(int row, int rate_row) {
+        return "=A" + std::to_string(row + 1) + "*E" + std::to_string(rate_row + 1);
+    }
+
+    /// Rows of a key, a label and a formula over the key of the same row and a rate outside the block
+    void BuildRows(spreadsheet::Sheet& sheet, int rows) {
+        for (int row = 0; row < 100; ++row) {
+            sheet.SetCell({row, 4}, std::to_string(row));
+        }
+        for (int row = 0; row < rows; ++row) {
+            sheet.SetCell({row, 0}, std::to_string((row * 7919) % 10007));
+            sheet.SetCell({row, 1}, "item" + std::to_string(row));
+            sheet.SetCell({row, 2}, MakeFormula(row, row % 100));
+        }
+    }
+
+    /// What a client has to do without SortRange: read the keys, then set every cell again
+    /// with the references rewritten to the new rows
+    void SortBySetCell(spreadsheet::Sheet& sheet, int rows) {
+        std::vector<double> keys(rows);
+        std::vector<std::string> labels(rows);
+        for (int row = 0; row < rows; ++row) {
+            keys[row] = std::stod(sheet.GetCell({row, 0})->GetText());
+            labels[row] = sheet.GetCell({row, 1})->GetText();
+        }
+
+        std::vector<int> order(rows);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&keys](int lhs, int rhs) { return keys[lhs] < keys[rhs]; });
+
+        for (int row = 0; row < rows; ++row) {
+            sheet.SetCell({row, 0}, std::to_string(static_cast<int>(keys[order[row]])));
+            sheet.SetCell({row, 1}, labels[order[row]]);
+            sheet.SetCell({row, 2}, MakeFormula(row, order[row] % 100));
+        }
+    }
+
+    void BenchSortRange() {
+        constexpr int rows = 4096;
+        {
+            spreadsheet::Sheet sheet;
+            BuildRows(sheet, rows);
+            bench::Report("sort by reading and setting cells", bench::MeasureMs([&] { SortBySetCell(sheet, rows); }), std::to_string(rows) + " rows");
+        }
+        {
+            spreadsheet::Sheet sheet;
+            BuildRows(sheet, rows);
+            bench::Report("SortRange", bench::MeasureMs([&] { sheet.SortRange({{0, 0}, {rows, 3}}, {{0, true}}); }), std::to_string(rows) + " rows");
+        }
+        {
+            spreadsheet::Sheet sheet;
+            BuildRows(sheet, Position::MAX_ROWS);
+            bench::Report("SortRange, full height", bench::MeasureMs([&] { sheet.SortRange({{0, 0}, {Position::MAX_ROWS, 3}}, {{0, false}}); }),
+                          std::to_string(Position::MAX_ROWS) + " rows");
+        }
+    }
+
+    BENCHMARK("sort/sort_range", BenchSortRange);
+}
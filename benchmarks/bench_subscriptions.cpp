@@ -0,0 +1,73 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_utils.h"
+#include "sheet.h"
+
+namespace {
+
+    constexpr int ROWS = 10000;
+    constexpr int ROUNDS = 200;
+    /// Inputs edited per round, spread over the sheet
+    constexpr int EDITS = 10;
+
+    /// Inputs in A, watched formulas in B
+    void Build(spreadsheet::Sheet& sheet) {
+        std::vector<std::pair<Position, std::string>> cells;
+        for (int row = 0; row < ROWS; ++row) {
+            cells.emplace_back(Position{row, 0}, std::to_string(row % 100));
+            cells.emplace_back(Position{row, 1}, "=A" + std::to_string(row + 1) + "*2");
+        }
+        sheet.SetCells(std::move(cells));
+        sheet.Recalculate();
+    }
+
+    void Edit(spreadsheet::Sheet& sheet, int round) {
+        for (int i = 0; i < EDITS; ++i) {
+            sheet.SetCell({(round * 7919 + i * (ROWS / EDITS)) % ROWS, 0}, std::to_string(round + i));
+        }
+        sheet.Recalculate();
+    }
+
+    /// A client finding the changes of column B after every edit: re-reading the column and comparing it with the previous
+    /// read, against a subscription to it
+    void BenchSubscriptions() {
+        const Rect watched{{0, 1}, {ROWS, 1}};
+        const std::string details = std::to_string(EDITS) + " of " + std::to_string(ROWS) + " rows edited per round";
+
+        spreadsheet::Sheet polled;
+        Build(polled);
+        size_t polled_changes = 0;
+        std::vector<CellInterface::Value> previous = polled.GetValues(watched);
+        double ms = bench::MeasureMs([&] {
+            for (int round = 1; round <= ROUNDS; ++round) {
+                Edit(polled, round);
+                std::vector<CellInterface::Value> current = polled.GetValues(watched);
+                for (size_t i = 0; i < current.size(); ++i) {
+                    polled_changes += current[i] == previous[i] ? 0 : 1;
+                }
+                previous = std::move(current);
+            }
+        });
+        bench::Report("polling: edit, recalculate, read and compare", ms / ROUNDS, details);
+
+        spreadsheet::Sheet subscribed;
+        Build(subscribed);
+        size_t delivered_changes = 0;
+        subscribed.Subscribe(watched, [&delivered_changes](const std::vector<spreadsheet::CellChange>& changes) {
+            delivered_changes += changes.size();
+        });
+        ms = bench::MeasureMs([&] {
+            for (int round = 1; round <= ROUNDS; ++round) {
+                Edit(subscribed, round);
+                subscribed.DeliverChanges();
+            }
+        });
+        bench::Report("subscription: edit, recalculate, deliver", ms / ROUNDS, details);
+        bench::ReportValue("changes found by polling", static_cast<double>(polled_changes), "cells");
+        bench::ReportValue("changes delivered", static_cast<double>(delivered_changes), "cells");
+    }
+
+    BENCHMARK("subscriptions/changed_values", BenchSubscriptions);
+}
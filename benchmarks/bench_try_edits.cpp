@@ -0,0 +1,80 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_utils.h"
+#include "sheet.h"
+
+namespace {
+
+    constexpr int ROWS = 16000;
+
+    bool IsInvalid(int row) {
+        return row % 10 == 9;
+    }
+
+    /// Formulas over column A in column B, every tenth one invalid: a syntax error, an unknown function or a cycle
+    std::vector<std::pair<Position, std::string>> MakeImport() {
+        std::vector<std::pair<Position, std::string>> cells;
+        for (int row = 0; row < ROWS; ++row) {
+            const std::string input = "A" + std::to_string(row + 1);
+            cells.emplace_back(Position{row, 0}, std::to_string(row % 100));
+            switch (IsInvalid(row) ? row % 3 : -1) {
+            case 0:
+                cells.emplace_back(Position{row, 1}, "=" + input + "*2+");
+                break;
+            case 1:
+                cells.emplace_back(Position{row, 1}, "=SUM(" + input + ")");
+                break;
+            case 2:
+                cells.emplace_back(Position{row, 1}, "=B" + std::to_string(row + 1) + "+" + input);
+                break;
+            default:
+                cells.emplace_back(Position{row, 1}, "=" + input + "*2+1");
+            }
+        }
+        return cells;
+    }
+
+    /// Imports row by row with the throwing and the non-throwing edits, counting the rejected rows. The invalid rows are
+    /// also timed alone, on a sheet holding the valid ones: that is the cost of the failure path.
+    void BenchTryEdits() {
+        const auto cells = MakeImport();
+        const std::string details = std::to_string(ROWS) + " rows, 10% invalid";
+        const auto import = [&cells](auto&& set_cell, bool valid, bool invalid) {
+            size_t rejected = 0;
+            for (const auto& [pos, text] : cells) {
+                if ((pos.col == 1 && IsInvalid(pos.row)) ? invalid : valid) {
+                    rejected += set_cell(pos, text) ? 0 : 1;
+                }
+            }
+            return rejected;
+        };
+
+        spreadsheet::Sheet throwing;
+        const auto set_cell = [&throwing](const Position& pos, const std::string& text) {
+            try {
+                throwing.SetCell(pos, text);
+            } catch (const std::exception&) {
+                return false;
+            }
+            return true;
+        };
+        spreadsheet::Sheet reporting;
+        const auto try_set_cell = [&reporting](const Position& pos, const std::string& text) { return reporting.TrySetCell(pos, text).IsOk(); };
+
+        size_t rejected = 0;
+        double ms = bench::MeasureMs([&] { rejected = import(set_cell, true, true); });
+        bench::Report("SetCell with exceptions", ms, details);
+        ms = bench::MeasureMs([&] { rejected = import(try_set_cell, true, true); });
+        bench::Report("TrySetCell with status codes", ms, details);
+        bench::ReportValue("rejected rows", static_cast<double>(rejected), "rows");
+
+        ms = bench::MeasureMs([&] { import(set_cell, false, true); });
+        bench::Report("SetCell: invalid rows only", ms, std::to_string(ROWS / 10) + " rows");
+        ms = bench::MeasureMs([&] { import(try_set_cell, false, true); });
+        bench::Report("TrySetCell: invalid rows only", ms, std::to_string(ROWS / 10) + " rows");
+    }
+
+    BENCHMARK("edits/import_with_invalid_rows", BenchTryEdits);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Benchmark {
+        std::string name;
+        std::function<void()> run;
+    };
+
+    inline std::vector<Benchmark>& GetRegistry() {
+        static std::vector<Benchmark> registry;
+        return registry;
+    }
+
+    struct Registrar {
+        Registrar(std::string name, std::function<void()> run) {
+            GetRegistry().push_back({std::move(name), std::move(run)});
+        }
+    };
+
+    /// Runs `action` once and returns the elapsed wall time in milliseconds
+    template <typename Action>
+    double MeasureMs(Action&& action) {
+        const auto start = Clock::now();
+        std::forward<Action>(action)();
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    inline void Report(std::string_view name, double ms, std::string_view details = {}) {
+        std::cout << "  " << std::left << std::setw(48) << name << std::right << std::setw(12) << std::fixed << std::setprecision(3) << ms
+                  << " ms";
+        if (!details.empty()) {
+            std::cout << "  " << details;
+        }
+        std::cout << std::endl;
+    }
+
+    /// Reports a measured quantity other than time
+    inline void ReportValue(std::string_view name, double value, std::string_view unit) {
+        std::cout << "  " << std::left << std::setw(48) << name << std::right << std::setw(12) << std::fixed << std::setprecision(3) << value << ' '
+                  << unit << std::endl;
+    }
+}
+
+namespace bench {
+
+    /// Heap allocations made by the process so far and bytes allocated and not freed yet, counted by the global
+    /// `operator new` and `operator delete` replaced in main.cpp
+    struct HeapUsage {
+        size_t allocations = 0;
+        size_t bytes = 0;
+    };
+
+    HeapUsage GetHeapUsage();
+}
+
+#define BENCH_CAT_(a, b) a##b
+#define BENCH_CAT(a, b) BENCH_CAT_(a, b)
+#define BENCHMARK(name, func) static const bench::Registrar BENCH_CAT(bench_registrar_, __LINE__)(name, func)
@@ -0,0 +1,80 @@
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_utils.h"
+#include "sheet.h"
+
+namespace {
+
+    constexpr int ROWS = 10000;
+    constexpr int ROUNDS = 10;
+
+    /// Discards what is printed, so only the sheet allocates
+    class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override {
+            return c;
+        }
+        std::streamsize xsputn(const char*, std::streamsize count) override {
+            return count;
+        }
+    };
+
+    /// Labels, numbers stored as texts and formulas over them
+    void Build(spreadsheet::Sheet& sheet) {
+        std::vector<std::pair<Position, std::string>> cells;
+        for (int row = 0; row < ROWS; ++row) {
+            const std::string number = "A" + std::to_string(row + 1);
+            cells.emplace_back(Position{row, 0}, std::to_string(row % 1000) + ".25");
+            cells.emplace_back(Position{row, 1}, "item number " + std::to_string(row) + " of the inventory");
+            cells.emplace_back(Position{row, 2}, "=" + number + "*2");
+        }
+        sheet.SetCells(std::move(cells));
+        sheet.Recalculate();
+    }
+
+    /// Reads of computed values, copied and viewed, and printing: allocations per round
+    void BenchValueReads() {
+        spreadsheet::Sheet sheet;
+        Build(sheet);
+        const std::string details = std::to_string(ROWS * 3) + " cells per round";
+
+        const auto measure = [&](std::string_view name, auto&& read) {
+            const bench::HeapUsage before = bench::GetHeapUsage();
+            const double ms = bench::MeasureMs([&] {
+                for (int round = 0; round < ROUNDS; ++round) {
+                    read();
+                }
+            });
+            bench::Report(name, ms / ROUNDS, details);
+            bench::ReportValue(std::string(name) + ": allocations", static_cast<double>(bench::GetHeapUsage().allocations - before.allocations) / ROUNDS,
+                               "per round");
+        };
+
+        size_t texts = 0;
+        measure("GetValue", [&] {
+            for (int row = 0; row < ROWS; ++row) {
+                for (int col = 0; col < 3; ++col) {
+                    texts += std::holds_alternative<std::string>(sheet.GetValue({row, col})) ? 1 : 0;
+                }
+            }
+        });
+        measure("GetValueRef", [&] {
+            for (int row = 0; row < ROWS; ++row) {
+                for (int col = 0; col < 3; ++col) {
+                    texts += std::holds_alternative<std::string_view>(sheet.GetValueRef({row, col})) ? 1 : 0;
+                }
+            }
+        });
+
+        NullBuffer buffer;
+        std::ostream output(&buffer);
+        measure("PrintValues", [&] { sheet.PrintValues(output); });
+        bench::ReportValue("texts read", static_cast<double>(texts) / (2 * ROUNDS), "per round");
+    }
+
+    BENCHMARK("values/read_heavy", BenchValueReads);
+}
@@ -0,0 +1,95 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_utils.h"
+#include "sheet.h"
+#include "workbook.h"
+
+namespace {
+
+    constexpr int SHEETS = 8;
+    constexpr int ROWS = 2000;
+
+    /// Inputs in A of the first sheet, every other sheet scales them in A and derives B from A: the sheets depend on the
+    /// first one only. The flattened layout stacks the same blocks in one sheet, the block of sheet `k` at row `k * ROWS`.
+    std::vector<std::pair<Position, std::string>> MakeBlock(int sheet, int first_row, const std::string& inputs) {
+        std::vector<std::pair<Position, std::string>> cells;
+        for (int row = 0; row < ROWS; ++row) {
+            if (sheet == 0) {
+                cells.emplace_back(Position{first_row + row, 0}, std::to_string(row % 100));
+                continue;
+            }
+            const std::string input = inputs + Position{row, 0}.ToString();
+            cells.emplace_back(Position{first_row + row, 0}, '=' + input + '*' + std::to_string(sheet));
+            cells.emplace_back(Position{first_row + row, 1}, '=' + Position{first_row + row, 0}.ToString() + "*2+" + input);
+        }
+        return cells;
+    }
+
+    std::vector<std::pair<Position, std::string>> MakeInputs(int first_row, int round) {
+        std::vector<std::pair<Position, std::string>> cells;
+        for (int row = 0; row < ROWS; ++row) {
+            cells.emplace_back(Position{first_row + row, 0}, std::to_string((row + round) % 100));
+        }
+        return cells;
+    }
+
+    std::string SheetName(int sheet) {
+        return "S" + std::to_string(sheet);
+    }
+
+    void BenchWorkbook() {
+        const std::string details = std::to_string(SHEETS) + " sheets of " + std::to_string(ROWS) + " rows";
+
+        bench::HeapUsage before = bench::GetHeapUsage();
+        spreadsheet::Workbook book;
+        double ms = bench::MeasureMs([&] {
+            for (int sheet = 0; sheet < SHEETS; ++sheet) {
+                book.AddSheet(SheetName(sheet));
+                book.SetCells(SheetName(sheet), MakeBlock(sheet, 0, SheetName(0) + '!'));
+            }
+            book.Recalculate();
+        });
+        bench::Report("workbook: build and compute", ms, details);
+        bench::ReportValue("workbook: heap in use", static_cast<double>(bench::GetHeapUsage().bytes - before.bytes) / (1024.0 * 1024.0), "MiB");
+
+        before = bench::GetHeapUsage();
+        spreadsheet::Sheet flat;
+        ms = bench::MeasureMs([&] {
+            for (int sheet = 0; sheet < SHEETS; ++sheet) {
+                flat.SetCells(MakeBlock(sheet, sheet * ROWS, ""));
+            }
+            flat.Recalculate();
+        });
+        bench::Report("flattened sheet: build and compute", ms, details);
+        bench::ReportValue("flattened sheet: heap in use", static_cast<double>(bench::GetHeapUsage().bytes - before.bytes) / (1024.0 * 1024.0), "MiB");
+
+        /// Every round changes all inputs, which outdates every formula of every sheet
+        constexpr int ROUNDS = 5;
+        ms = bench::MeasureMs([&] {
+            for (int round = 1; round <= ROUNDS; ++round) {
+                book.SetCells(SheetName(0), MakeInputs(0, round));
+                book.Recalculate();
+            }
+        });
+        bench::Report("workbook: edit inputs and recalculate", ms / ROUNDS, "per round");
+        ms = bench::MeasureMs([&] {
+            for (int round = 1; round <= ROUNDS; ++round) {
+                flat.SetCells(MakeInputs(0, round));
+                flat.Recalculate();
+            }
+        });
+        bench::Report("flattened sheet: edit inputs and recalculate", ms / ROUNDS, "per round");
+
+        int mismatches = 0;
+        for (int sheet = 1; sheet < SHEETS; ++sheet) {
+            for (int row = 0; row < ROWS; row += 97) {
+                mismatches += book.GetValue(SheetName(sheet), {row, 1}) == flat.GetValue({sheet * ROWS + row, 1}) ? 0 : 1;
+            }
+        }
+        bench::ReportValue("mismatching values", mismatches, "cells");
+    }
+
+    BENCHMARK("workbook/cross_sheet_recalculation", BenchWorkbook);
+}
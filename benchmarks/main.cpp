@@ -0,0 +1,77 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string_view>
+
+#include "bench_utils.h"
+
+namespace {
+    std::atomic<size_t> heap_allocations = 0;
+    std::atomic<size_t> heap_bytes = 0;
+
+    /// Every block starts with a header holding its size, so unsized deletes know what they free
+    constexpr size_t HEADER = alignof(std::max_align_t);
+
+    void* Allocate(size_t size) {
+        auto* block = static_cast<unsigned char*>(std::malloc(size + HEADER));
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+        *reinterpret_cast<size_t*>(block) = size;
+        heap_allocations.fetch_add(1, std::memory_order_relaxed);
+        heap_bytes.fetch_add(size, std::memory_order_relaxed);
+        return block + HEADER;
+    }
+
+    void Deallocate(void* ptr) {
+        if (ptr == nullptr) {
+            return;
+        }
+        unsigned char* block = static_cast<unsigned char*>(ptr) - HEADER;
+        heap_bytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+        std::free(block);
+    }
+}
+
+void* operator new(size_t size) {
+    return Allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t /* size */) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t /* size */) noexcept {
+    Deallocate(ptr);
+}
+
+bench::HeapUsage bench::GetHeapUsage() {
+    return {heap_allocations.load(std::memory_order_relaxed), heap_bytes.load(std::memory_order_relaxed)};
+}
+
+/// Usage: spreadsheet_benchmarks [name-filter]
+int main(int argc, char** argv) {
+    const std::string_view filter = argc > 1 ? argv[1] : "";
+
+    for (const auto& benchmark : bench::GetRegistry()) {
+        if (benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        std::cout << benchmark.name << std::endl;
+        benchmark.run();
+    }
+}
@@ -1,16 +1,18 @@
 message(STATUS "DEVELOP SETTING...")
 
-# Enable address sanitizer
+# Enable sanitizer: address, thread or undefined (ThreadSanitizer cannot be combined with AddressSanitizer)
 option(ENABLE_SANITIZER "Enable sanitizer(Debug+Gcc/Clang/AppleClang)" ON)
+set(SPREADSHEET_SANITIZER "address" CACHE STRING "Sanitizer enabled by ENABLE_SANITIZER")
+set_property(CACHE SPREADSHEET_SANITIZER PROPERTY STRINGS address thread undefined)
 
 if(ENABLE_SANITIZER AND NOT MSVC)
     if(CMAKE_BUILD_TYPE STREQUAL "Debug")
-        check_asan(HAS_ASAN)
-        if(HAS_ASAN)
-            set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fsanitize=address")
-            message(STATUS "AddressSanitizer enabled")
+        check_sanitizer(${SPREADSHEET_SANITIZER} HAS_SANITIZER_${SPREADSHEET_SANITIZER})
+        if(HAS_SANITIZER_${SPREADSHEET_SANITIZER})
+            set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fsanitize=${SPREADSHEET_SANITIZER}")
+            message(STATUS "Sanitizer enabled: ${SPREADSHEET_SANITIZER}")
         else()
-            message(WARNING "sanitizer is no supported with current tool-chains")
+            message(WARNING "sanitizer ${SPREADSHEET_SANITIZER} is no supported with current tool-chains")
         endif()
     endif()
 endif()
@@ -0,0 +1,5 @@
+# Registering benchmarks
+message(STATUS "BUILD_BENCHMARKS: ${SPREADSHEET_BUILD_BENCHMARKS}")
+if(SPREADSHEET_BUILD_BENCHMARKS)
+    add_subdirectory(${PROJECT_BENCHMARKS_DIR})
+endif()
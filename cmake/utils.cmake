@@ -1,6 +1,6 @@
-macro(check_asan _RESULT)
+macro(check_sanitizer _SANITIZER _RESULT)
     include(CheckCXXSourceRuns)
-    set(CMAKE_REQUIRED_FLAGS "-fsanitize=address")
+    set(CMAKE_REQUIRED_FLAGS "-fsanitize=${_SANITIZER}")
     check_cxx_source_runs(
             [====[
 int main()
@@ -4,6 +4,8 @@
 #include <functional>
 #include <optional>
 #include <stdexcept>
+#include <string_view>
+#include <vector>
 
 #include "common.h"
 
@@ -16,25 +18,59 @@ class ParsingError : public std::runtime_error {
 };
 
 using LookupValue = std::optional<std::function<double(const Position&)>>;
+/// Reads a cell of another sheet of the workbook by the sheet name
+using LookupSheetValue = std::function<double(std::string_view, const Position&)>;
+
+/**
+ * @brief State shared by all nodes of one formula evaluation.
+ *
+ * Array formulas are evaluated element by element: a range reference yields the cell
+ * that corresponds to the evaluated element of the `shape` block. Ordinary formulas
+ * are evaluated as a single 1x1 element. Without `lookup_sheet_value` references to
+ * other sheets evaluate to a reference error.
+ */
+struct EvaluationContext {
+    LookupValue lookup_value;
+    Size shape = {1, 1};
+    Position element = {0, 0};
+    LookupSheetValue lookup_sheet_value = {};
+};
 
 class FormulaAST {
 public:
-    FormulaAST(std::unique_ptr<ASTImpl::Expr> root_expr, std::forward_list<Position> cells);
+    FormulaAST(std::unique_ptr<ASTImpl::Expr> root_expr, std::forward_list<Position> cells, std::forward_list<Rect> ranges,
+               std::forward_list<SheetReference> sheet_refs = {});
     FormulaAST(FormulaAST&&) = default;
     FormulaAST& operator=(FormulaAST&&) = default;
     ~FormulaAST();
 
     [[nodiscard]] double Execute(LookupValue lookup_value) const;
+    [[nodiscard]] double Execute(const EvaluationContext& context) const;
     void Print(std::ostream& out) const;
     void PrintFormula(std::ostream& out) const;
     void PrintCells(std::ostream& out) const;
     std::forward_list<Position>& GetCells();
     [[nodiscard]] const std::forward_list<Position>& GetCells() const;
+    [[nodiscard]] const std::forward_list<Rect>& GetRanges() const;
+    /// Cells read by every evaluation that does not fail earlier, unsorted and with duplicates
+    [[nodiscard]] std::vector<Position> GetUnconditionalCells() const;
+    /// References to cells and ranges of other sheets, such as `Sheet2!A1`
+    [[nodiscard]] const std::forward_list<SheetReference>& GetSheetReferences() const;
 
 private:
     std::unique_ptr<ASTImpl::Expr> root_expr_;
     std::forward_list<Position> cells_;
+    std::forward_list<Rect> ranges_;
+    std::forward_list<SheetReference> sheet_refs_;
 };
 
 FormulaAST ParseFormulaAST(std::istream& in);
 FormulaAST ParseFormulaAST(const std::string& in_str);
+
+/**
+ * @brief Checks an expression against the grammar and the checks of `ParseFormulaAST` without throwing.
+ *
+ * Returns nothing for the expressions `ParseFormulaAST` accepts. Rejecting a bad formula this way does
+ * not unwind through the generated parser, which costs far more than parsing.
+ */
+std::optional<FormulaSyntaxError> CheckFormulaSyntax(std::string_view expression);
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "common.h"
+#include "parallel.h"
+#include "sheet.h"
+#include "snapshot.h"
+
+namespace spreadsheet /* Task */ {
+
+    /// Resumes a coroutine suspended on a `Task`, e.g. by posting it to the event loop of the host
+    using Resume = std::function<void(std::coroutine_handle<>)>;
+
+    /**
+     * @brief Result of an operation submitted to `AsyncSheet`: a future that can also be awaited.
+     *
+     * `Get()` blocks until the result is ready; `co_await task` suspends the awaiting coroutine
+     * instead and resumes it through the `Resume` of the sheet, or on the worker thread if there is
+     * none. An exception thrown by the operation is rethrown by `Get()` and by `co_await`.
+     */
+    template <typename T>
+    class Task {
+    public:
+        [[nodiscard]] bool IsReady() const;
+        /// Blocks until the operation finished; must not be called from the worker thread
+        T Get() const;
+
+        bool await_ready() const {
+            return IsReady();
+        }
+        /// Returns false if the operation finished meanwhile and the coroutine goes on right away
+        bool await_suspend(std::coroutine_handle<> awaiting) const;
+        T await_resume() const {
+            return Get();
+        }
+
+    private:
+        friend class AsyncSheet;
+
+        struct State {
+            mutable std::mutex mutex;
+            std::condition_variable finished;
+            bool done = false;
+            std::optional<std::conditional_t<std::is_void_v<T>, std::monostate, T>> value;
+            std::exception_ptr error;
+            std::coroutine_handle<> continuation;
+            Resume resume;
+        };
+
+        explicit Task(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+        /// Runs `job` and stores its result or exception, then resumes the awaiting coroutine if any
+        template <typename Job>
+        static void Complete_(State& state, Job& job);
+
+    private:
+        std::shared_ptr<State> state_;
+    };
+}
+
+namespace spreadsheet /* AsyncSheet */ {
+
+    /**
+     * @brief Sheet whose edits, recalculations and reads run on an internal worker thread.
+     *
+     * Every call returns a `Task` at once; operations run one at a time in submission order, so a
+     * read submitted after an edit sees it, and the single-writer contract of `Sheet` holds without
+     * locks in the host. `Snapshot()` is synchronous and never waits for the worker.
+     */
+    class AsyncSheet {
+    public:
+        /// `resume` schedules coroutines awaiting tasks, they resume on the worker thread if it is empty
+        explicit AsyncSheet(Resume resume = {});
+
+        Task<void> SetCellAsync(Position pos, std::string text);
+        Task<void> SetCellsAsync(std::vector<std::pair<Position, std::string>> cells);
+        Task<void> ClearCellAsync(Position pos);
+        Task<RecalculationStats> RecalculateAsync();
+        Task<CellInterface::Value> GetValueAsync(Position pos);
+
+        /// Runs `job(sheet)` on the worker thread after the operations submitted before it
+        template <typename Job>
+        Task<std::invoke_result_t<Job&, Sheet&>> Submit(Job job);
+
+        SheetSnapshot Snapshot() const;
+
+    private:
+        Sheet sheet_;
+        Resume resume_;
+        /// Destroyed first: queued operations finish while the sheet is alive
+        parallel::SerialExecutor executor_;
+    };
+}
+
+namespace spreadsheet /* Task implementation */ {
+
+    template <typename T>
+    bool Task<T>::IsReady() const {
+        const std::lock_guard lock(state_->mutex);
+        return state_->done;
+    }
+
+    template <typename T>
+    T Task<T>::Get() const {
+        std::unique_lock lock(state_->mutex);
+        state_->finished.wait(lock, [this] { return state_->done; });
+        if (state_->error != nullptr) {
+            std::rethrow_exception(state_->error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return *state_->value;
+        }
+    }
+
+    template <typename T>
+    bool Task<T>::await_suspend(std::coroutine_handle<> awaiting) const {
+        const std::lock_guard lock(state_->mutex);
+        if (state_->done) {
+            return false;
+        }
+        state_->continuation = awaiting;
+        return true;
+    }
+
+    template <typename T>
+    template <typename Job>
+    void Task<T>::Complete_(State& state, Job& job) {
+        std::optional<std::conditional_t<std::is_void_v<T>, std::monostate, T>> value;
+        std::exception_ptr error;
+        try {
+            if constexpr (std::is_void_v<T>) {
+                job();
+                value.emplace();
+            } else {
+                value.emplace(job());
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::coroutine_handle<> continuation;
+        {
+            const std::lock_guard lock(state.mutex);
+            state.value = std::move(value);
+            state.error = std::move(error);
+            state.done = true;
+            continuation = std::exchange(state.continuation, nullptr);
+        }
+        state.finished.notify_all();
+
+        if (continuation) {
+            if (state.resume) {
+                state.resume(continuation);
+            } else {
+                continuation.resume();
+            }
+        }
+    }
+}
+
+namespace spreadsheet /* AsyncSheet template implementation */ {
+
+    template <typename Job>
+    Task<std::invoke_result_t<Job&, Sheet&>> AsyncSheet::Submit(Job job) {
+        using Result = Task<std::invoke_result_t<Job&, Sheet&>>;
+        auto state = std::make_shared<typename Result::State>();
+        state->resume = resume_;
+        executor_.Submit([this, state, job = std::move(job)]() mutable {
+            auto run = [&] { return job(sheet_); };
+            Result::Complete_(*state, run);
+        });
+        return Result(std::move(state));
+    }
+}
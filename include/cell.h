@@ -1,27 +1,76 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
 #include "common.h"
 #include "formula.h"
 
+/**
+ * Values are computed lazily and cached. Const methods may run concurrently with each other: the
+ * first reader of an outdated value claims the cell and computes it, readers arriving meanwhile wait
+ * for it on an atomic state, later ones read the published value without locking. Modifications must
+ * not overlap with any other call.
+ */
 class Cell : public CellInterface {
 public:
     Cell(SheetInterface& sheet);
     ~Cell();
 
     void Set(std::string text);
+    void SetArray(Size size, std::string text);
     void Clear();
 
     Value GetValue() const override;
+    /// View of the value without copying its text, valid until the cell is modified or outdated
+    ValueRef GetValueRef() const;
     std::string GetText() const override;
+    /// Immutable buffer of `GetText()`, shared rather than copied, e.g. with snapshots; nullptr if the text is empty
+    std::shared_ptr<const std::string> GetSharedText() const;
+
+    /// View of the value of a text cell without copying it, valid until the cell is modified
+    std::optional<std::string_view> GetTextValue() const;
 
     std::vector<Position> GetReferencedCells() const override;
+    std::vector<Rect> GetReferencedRanges() const;
+    /// Referenced cells every evaluation reads, see FormulaInterface::GetUnconditionalCells
+    std::vector<Position> GetUnconditionalCells() const;
+    /// References of a formula to other sheets, see FormulaInterface::GetSheetReferences
+    std::vector<SheetReference> GetSheetReferences() const;
+
+    /// Relabels single-cell references of a formula in place, see FormulaInterface::RemapReferences
+    void RemapReferences(const std::function<Position(Position)>& remap);
 
+    /// Marks the value outdated. The old value is kept to tell whether recomputing changes it.
     void ClearCache();
     bool HasCache() const;
+    bool IsEmpty() const;
+
+    /**
+     * Value versions for early cutoff. Both are ticks of one global clock: the value last changed at
+     * `GetChangedAt()` and was last computed or confirmed at `GetVerifiedAt()`. An outdated value is
+     * still right if no precedent changed after it was verified, then `Revalidate()` keeps it.
+     */
+    std::uint64_t GetChangedAt() const;
+    std::uint64_t GetVerifiedAt() const;
+    /// Keeps the outdated value, returns false if there is none or it was computed again meanwhile
+    bool Revalidate() const;
+
+    /// Array formula support: the cell anchors a block of `GetArraySize()` spilled values
+    bool IsArray() const;
+    Size GetArraySize() const;
+    Value GetArrayValue(Position offset) const;
+    ValueRef GetArrayValueRef(Position offset) const;
+    const Cell* GetArrayElement(Position offset) const;
 
 private:
     class Impl {
@@ -29,9 +78,29 @@ private:
         virtual ~Impl() = default;
         [[nodiscard]] virtual CellInterface::Value GetValue() const = 0;
         [[nodiscard]] virtual std::string GetText() const = 0;
+        [[nodiscard]] virtual std::shared_ptr<const std::string> GetSharedText() const {
+            return nullptr;
+        }
         [[nodiscard]] virtual std::vector<Position> GetReferencedCells() const {
             return {};
         }
+        [[nodiscard]] virtual std::vector<Rect> GetReferencedRanges() const {
+            return {};
+        }
+        [[nodiscard]] virtual std::vector<Position> GetUnconditionalCells() const {
+            return {};
+        }
+        [[nodiscard]] virtual std::vector<SheetReference> GetSheetReferences() const {
+            return {};
+        }
+        virtual void RemapReferences(const std::function<Position(Position)>& /* remap */) {}
+        [[nodiscard]] virtual std::optional<std::string_view> GetTextValue() const {
+            return std::nullopt;
+        }
+        virtual void ClearCache() {}
+        [[nodiscard]] virtual bool IsEmpty() const {
+            return false;
+        }
     };
 
     class EmptyImpl : public Impl {
@@ -43,25 +112,38 @@ private:
         [[nodiscard]] std::string GetText() const override {
             return {};
         }
+        [[nodiscard]] bool IsEmpty() const override {
+            return true;
+        }
     };
 
     class TextImpl : public Impl {
     public:
-        explicit TextImpl(std::string text) : text_{std::move(text)} {}
+        explicit TextImpl(std::string text) : text_{std::make_shared<const std::string>(std::move(text))} {}
         [[nodiscard]] CellInterface::Value GetValue() const override {
-            return text_.length() > 0 && text_[0] == '\'' ? text_.substr(1) : text_;
+            return text_->length() > 0 && (*text_)[0] == '\'' ? text_->substr(1) : *text_;
         }
         [[nodiscard]] std::string GetText() const override {
+            return *text_;
+        }
+        [[nodiscard]] std::shared_ptr<const std::string> GetSharedText() const override {
             return text_;
         }
+        [[nodiscard]] std::optional<std::string_view> GetTextValue() const override {
+            std::string_view value = *text_;
+            if (value.length() > 0 && value[0] == '\'') {
+                value.remove_prefix(1);
+            }
+            return value;
+        }
 
     private:
-        std::string text_;
+        std::shared_ptr<const std::string> text_;
     };
 
     class FormulaImpl : public Impl {
     public:
-        FormulaImpl(std::string text, SheetInterface& sheet) : formula_{ParseFormula(std::move(text))}, sheet_{sheet} {}
+        FormulaImpl(std::string text, SheetInterface& sheet) : formula_{ParseFormula(std::move(text))}, sheet_{sheet}, text_{PrintText_()} {}
         [[nodiscard]] CellInterface::Value GetValue() const override {
             FormulaInterface::Value val = formula_->Evaluate(sheet_);
             if (std::holds_alternative<double>(val)) {
@@ -70,20 +152,151 @@ private:
             return std::get<FormulaError>(val);
         }
         [[nodiscard]] std::string GetText() const override {
-            return '=' + formula_->GetExpression();
+            return *text_;
+        }
+        [[nodiscard]] std::shared_ptr<const std::string> GetSharedText() const override {
+            return text_;
         }
 
         [[nodiscard]] std::vector<Position> GetReferencedCells() const override {
             return formula_->GetReferencedCells();
         }
+        [[nodiscard]] std::vector<Rect> GetReferencedRanges() const override {
+            return formula_->GetReferencedRanges();
+        }
+        [[nodiscard]] std::vector<Position> GetUnconditionalCells() const override {
+            return formula_->GetUnconditionalCells();
+        }
+        [[nodiscard]] std::vector<SheetReference> GetSheetReferences() const override {
+            return formula_->GetSheetReferences();
+        }
+        void RemapReferences(const std::function<Position(Position)>& remap) override {
+            formula_->RemapReferences(remap);
+            text_ = PrintText_();
+        }
+
+    private:
+        [[nodiscard]] std::shared_ptr<const std::string> PrintText_() const {
+            return std::make_shared<const std::string>('=' + formula_->GetExpression());
+        }
 
     private:
         std::unique_ptr<FormulaInterface> formula_;
         const SheetInterface& sheet_;
+        /// Printed once per change of the formula rather than on every `GetText()`
+        std::shared_ptr<const std::string> text_;
     };
 
+    /// Anchor of an array formula. The whole block is computed by one evaluation into
+    /// a contiguous row-major buffer; spilled positions read from it by offset.
+    class ArrayImpl : public Impl {
+    public:
+        ArrayImpl(std::string text, Size size, SheetInterface& sheet)
+            : formula_{ParseFormula(std::move(text))}, size_{size}, sheet_{sheet}, text_{PrintText_()} {}
+        [[nodiscard]] CellInterface::Value GetValue() const override {
+            return GetValue({0, 0});
+        }
+        [[nodiscard]] CellInterface::Value GetValue(Position offset) const {
+            return CopyValue(GetValueRef(offset));
+        }
+        [[nodiscard]] CellInterface::ValueRef GetValueRef(Position offset) const {
+            if (values_.empty()) {
+                values_ = formula_->EvaluateArray(sheet_, size_);
+            }
+
+            const FormulaInterface::Value& val = values_[static_cast<size_t>(offset.row) * size_.cols + offset.col];
+            if (std::holds_alternative<double>(val)) {
+                return std::get<double>(val);
+            }
+            return std::get<FormulaError>(val);
+        }
+        [[nodiscard]] std::string GetText() const override {
+            return *text_;
+        }
+        [[nodiscard]] std::shared_ptr<const std::string> GetSharedText() const override {
+            return text_;
+        }
+        [[nodiscard]] std::vector<Position> GetReferencedCells() const override {
+            return formula_->GetReferencedCells();
+        }
+        [[nodiscard]] std::vector<Rect> GetReferencedRanges() const override {
+            return formula_->GetReferencedRanges();
+        }
+        [[nodiscard]] std::vector<Position> GetUnconditionalCells() const override {
+            return formula_->GetUnconditionalCells();
+        }
+        [[nodiscard]] std::vector<SheetReference> GetSheetReferences() const override {
+            return formula_->GetSheetReferences();
+        }
+        void RemapReferences(const std::function<Position(Position)>& remap) override {
+            formula_->RemapReferences(remap);
+            text_ = PrintText_();
+        }
+        void ClearCache() override {
+            values_.clear();
+            for (auto& [index, element] : elements_) {
+                element->ClearCache();
+            }
+        }
+        [[nodiscard]] Size GetSize() const {
+            return size_;
+        }
+        [[nodiscard]] const Cell* GetElement(const Cell& anchor, Position offset) const;
+
+    private:
+        [[nodiscard]] std::shared_ptr<const std::string> PrintText_() const {
+            return std::make_shared<const std::string>("{=" + formula_->GetExpression() + '}');
+        }
+
+    private:
+        std::unique_ptr<FormulaInterface> formula_;
+        Size size_;
+        SheetInterface& sheet_;
+        std::shared_ptr<const std::string> text_;
+        /// Filled while the anchor cell is claimed, see `Cell::GetValue`
+        mutable std::vector<FormulaInterface::Value> values_;
+        /// Cell objects for spilled positions, created only on explicit GetCell() requests
+        mutable std::unordered_map<int, std::unique_ptr<Cell>> elements_;
+        mutable std::mutex elements_mutex_;
+    };
+
+    /// Spilled position of an array formula. Owns no value: reads the anchor's buffer.
+    class ArrayElementImpl : public Impl {
+    public:
+        ArrayElementImpl(const Cell& anchor, Position offset) : anchor_{anchor}, offset_{offset} {}
+        [[nodiscard]] CellInterface::Value GetValue() const override {
+            return anchor_.GetArrayValue(offset_);
+        }
+        [[nodiscard]] std::string GetText() const override {
+            return {};
+        }
+
+    private:
+        const Cell& anchor_;
+        Position offset_;
+    };
+
+private:
+    enum class CacheState : std::uint8_t {
+        outdated,   ///< No value or an old one kept for early cutoff
+        computing,  ///< Claimed by a reader that computes or revalidates it
+        ready,
+    };
+
+    const ArrayImpl* AsArray() const;
+    /// Computes and caches the value unless it is up to date
+    void Compute_() const;
+    /// Waits until the cell is not claimed; returns true if the caller claimed an outdated cell, false if it is ready
+    bool Claim_() const;
+    /// Ends the claim, waking readers that wait for it
+    void Publish_(CacheState state) const;
+
 private:
     std::unique_ptr<Impl> impl_;
     SheetInterface& sheet_;
+    /// Written only by the reader that claimed the cell, published by the release store of `state_`
     mutable std::unique_ptr<Value> cache_;
+    mutable std::atomic<CacheState> state_ = CacheState::outdated;
+    mutable std::atomic<std::uint64_t> changed_at_ = 0;
+    mutable std::atomic<std::uint64_t> verified_at_ = 0;
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+
+namespace spreadsheet /* Change subscriptions */ {
+
+    using SubscriptionId = std::uint64_t;
+
+    /// New value of a watched position
+    struct CellChange {
+        Position pos;
+        CellInterface::Value value;
+    };
+
+    /// Receives the changes of one subscription, ordered by row and column, every position once with its latest value
+    using ChangeCallback = std::function<void(const std::vector<CellChange>&)>;
+
+    /**
+     * @brief Queue of value changes from a sheet to its subscribers, delivered on the thread calling `Deliver()`.
+     *
+     * Producers push messages (a new subscription, a cancelled one, the changes found by one recalculation)
+     * with a CAS on the head of an intrusive list; the consumer detaches the whole list with one exchange
+     * and restores the order, so neither side locks or waits for the other. Subscriptions travel through
+     * the same queue, so the table of subscribers is owned by the consumer alone.
+     *
+     * Changes of a subscription are coalesced until its window has passed since its last batch: a position
+     * changed several times meanwhile is delivered once, with its latest value.
+     */
+    class ChangeFeed {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        ChangeFeed() = default;
+        ~ChangeFeed();
+        ChangeFeed(const ChangeFeed&) = delete;
+        ChangeFeed& operator=(const ChangeFeed&) = delete;
+
+        /// Producer, any thread
+        void PushSubscribe(SubscriptionId id, ChangeCallback callback, Clock::duration window);
+        void PushUnsubscribe(SubscriptionId id);
+        void PushChanges(std::vector<std::pair<SubscriptionId, CellChange>> changes);
+
+        /**
+         * @brief Consumer: applies the queued messages and calls back every subscription with pending changes
+         * whose window has passed at `now`. Returns the number of batches delivered.
+         *
+         * Must not run on two threads at once, nor be called from a callback.
+         */
+        size_t Deliver(Clock::time_point now = Clock::now());
+
+    private:
+        struct Message {
+            enum class Kind { subscribe, unsubscribe, changes } kind;
+            SubscriptionId id = 0;
+            ChangeCallback callback;
+            Clock::duration window{};
+            std::vector<std::pair<SubscriptionId, CellChange>> changes;
+            Message* next = nullptr;
+        };
+
+        struct Subscriber {
+            ChangeCallback callback;
+            Clock::duration window{};
+            std::optional<Clock::time_point> delivered_at;
+            std::map<Position, CellInterface::Value> pending;
+        };
+
+        void Push_(Message* message);
+        void Apply_(Message& message);
+
+    private:
+        /// Messages pushed since the last `Deliver()`, newest first
+        std::atomic<Message*> head_ = nullptr;
+        std::unordered_map<SubscriptionId, Subscriber> subscribers_;
+    };
+}
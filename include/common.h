@@ -39,6 +39,31 @@ struct Size {
     bool operator==(Size rhs) const;
 };
 
+/**
+ * Rect represents a rectangular block of cells defined by its top-left position and size.
+ */
+struct Rect {
+    Position position;
+    Size size;
+
+    bool operator==(Rect rhs) const;
+
+    [[nodiscard]] bool IsValid() const;
+    [[nodiscard]] bool Contains(Position pos) const;
+    [[nodiscard]] bool Intersects(Rect rhs) const;
+};
+
+/**
+ * SheetReference is a reference to a block of cells of another sheet of the same workbook,
+ * such as `Sheet2!A1` or `'Q1 data'!A1:B3`.
+ */
+struct SheetReference {
+    std::string sheet;
+    Rect range;
+
+    bool operator==(const SheetReference& rhs) const;
+};
+
 /**
  * Describes errors that can occur when computing a formula.
  */
@@ -81,6 +106,15 @@ public:
     using std::runtime_error::runtime_error;
 };
 
+/**
+ * FormulaSyntaxError describes the first error in a syntactically invalid formula without
+ * throwing: what is wrong and the offset of the offending token in the expression.
+ */
+struct FormulaSyntaxError {
+    std::string_view message;
+    size_t offset = 0;
+};
+
 /**
  * CyclicDependencyException is an exception that is thrown when a circular
  * dependency between cells is detected while computing a formula.
@@ -90,6 +124,24 @@ public:
     using std::runtime_error::runtime_error;
 };
 
+/**
+ * UnknownSheetException is an exception that is thrown when a workbook has no sheet
+ * with the requested name.
+ */
+class UnknownSheetException : public std::out_of_range {
+public:
+    using std::out_of_range::out_of_range;
+};
+
+/**
+ * ArrayFormulaException is an exception that is thrown when an array formula
+ * cannot be spilled into its target block or when a part of an array is modified.
+ */
+class ArrayFormulaException : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
 /**
  * @class CellInterface
  * @brief An interface representing a cell in a spreadsheet.
@@ -102,6 +154,13 @@ public:
 class CellInterface {
 public:
     using Value = std::variant<std::string, double, FormulaError>;
+    /// Value whose text is referenced, not copied; valid as long as the viewed value is
+    using ValueRef = std::variant<std::string_view, double, FormulaError>;
+
+    /// Views `value` without copying its text
+    static ValueRef ViewValue(const Value& value);
+    /// Copies the viewed value, e.g. to keep it past a modification of its sheet
+    static Value CopyValue(ValueRef value);
 
     virtual ~CellInterface() = default;
 
@@ -170,6 +229,41 @@ public:
      */
     [[nodiscard]] virtual const CellInterface* GetCell(Position pos) const = 0;
 
+    /**
+     * @brief Returns the visible value of the cell at the given position.
+     *
+     * Unlike GetCell(), this also works for cells spilled by an array formula, which
+     * have no cell objects of their own. A position without a cell is treated as
+     * an empty cell, whose value is the number zero.
+     *
+     * @param pos The position of the cell to read.
+     * @return The visible value of the cell.
+     */
+    [[nodiscard]] virtual CellInterface::Value GetValue(Position pos) const = 0;
+
+    /**
+     * @brief Returns the visible value of the cell at the given position without copying its text.
+     *
+     * The view is valid until the next modification of the sheet. Formulas read referenced values
+     * through this method.
+     *
+     * @param pos The position of the cell to read.
+     * @return A view of the visible value of the cell.
+     */
+    [[nodiscard]] virtual CellInterface::ValueRef GetValueRef(Position pos) const = 0;
+
+    /**
+     * @brief Returns the visible value of a cell of another sheet of the same workbook.
+     *
+     * Formulas read references such as `Sheet2!A1` through this method. A sheet outside of
+     * a workbook has no other sheets, so the default implementation yields a reference error.
+     *
+     * @param sheet The name of the sheet to read.
+     * @param pos The position of the cell to read.
+     * @return The visible value of the cell.
+     */
+    [[nodiscard]] virtual CellInterface::Value GetSheetValue(std::string_view sheet, Position pos) const;
+
     /**
      * @brief Retrieves a modifiable pointer to the cell at the given position.
      *
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "graph.h"
+
+namespace spreadsheet /* Cross-region links */ {
+
+    /// Cell of one region of a grid split into regions, e.g. a band of `ShardedSheet` or a sheet of `Workbook`
+    struct RegionCell {
+        size_t region = 0;
+        Position pos;
+
+        bool operator==(const RegionCell& rhs) const;
+    };
+
+    struct RegionCellHasher {
+        size_t operator()(const RegionCell& cell) const;
+    };
+
+    /**
+     * @brief References between cells of regions that keep dependency graphs of their own, see `Region`.
+     *
+     * Every reference is recorded by both regions: the referencing cell lists the cells it reads, and
+     * the read cell lists its readers. Regions report the cells whose values they drop with
+     * `Invalidated()`; their readers are collected right away, so finding them costs as much as the
+     * invalidation did, not as much as all links between regions.
+     *
+     * Data of different regions may be used concurrently, e.g. each with the lock of its region held.
+     */
+    class CrossLinks {
+    public:
+        /// Cells to invalidate, by region
+        using Readers = std::map<size_t, std::vector<Position>>;
+
+        explicit CrossLinks(size_t region_count = 0);
+
+        /// Adds a region with the next index, must not run concurrently with other calls
+        void AddRegion();
+
+        /// Replaces the references of `cell` to cells of other regions with `refs`
+        void Link(const RegionCell& cell, std::vector<RegionCell> refs);
+        void Unlink(const RegionCell& cell);
+
+        /// References of the cell, empty if it has none
+        [[nodiscard]] const std::vector<RegionCell>& GetReferences(const RegionCell& cell) const;
+        [[nodiscard]] bool HasReferences(size_t region) const;
+        [[nodiscard]] bool HasReaders(size_t region) const;
+        /// Number of references of the region to cells of each region, by region index
+        [[nodiscard]] const std::map<size_t, size_t>& GetReadRegions(size_t region) const;
+
+        /// Records the readers of `positions` of the region, whose values were dropped
+        void Invalidated(size_t region, const std::vector<Position>& positions);
+        /// Readers recorded by `Invalidated()` since the last call
+        [[nodiscard]] Readers TakeReaders(size_t region);
+
+        /**
+         * @brief Invalidates `readers` one region at a time and, in turn, the readers of the values this drops.
+         *
+         * `invalidate(region, positions)` drops the values of the positions and of their dependents in the
+         * region, and returns `TakeReaders(region)`.
+         */
+        template <typename Invalidate>
+        static void InvalidateReaders(Readers readers, Invalidate invalidate);
+
+    private:
+        struct Links {
+            /// Cells of other regions referenced by cell of the region
+            std::unordered_map<Position, std::vector<RegionCell>, graph::Hasher> refs;
+            /// Cells of other regions by the cell of the region they reference
+            std::unordered_map<Position, std::vector<RegionCell>, graph::Hasher> readers;
+            std::map<size_t, size_t> reads;
+            /// Readers of dropped values, not taken yet
+            Readers pending;
+        };
+
+        std::vector<Links> regions_;
+    };
+}
+
+namespace spreadsheet /* CrossLinks template implementation */ {
+
+    template <typename Invalidate>
+    void CrossLinks::InvalidateReaders(Readers readers, Invalidate invalidate) {
+        while (!readers.empty()) {
+            auto [region, positions] = std::move(*readers.begin());
+            readers.erase(readers.begin());
+            for (auto& [reader_region, reader_positions] : invalidate(region, positions)) {
+                auto& region_readers = readers[reader_region];
+                region_readers.insert(region_readers.end(), reader_positions.begin(), reader_positions.end());
+            }
+        }
+    }
+}
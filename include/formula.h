@@ -1,6 +1,9 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <optional>
+#include <string_view>
 #include <vector>
 
 #include "common.h"
@@ -30,6 +33,18 @@ public:
      */
     [[nodiscard]] virtual Value Evaluate(const SheetInterface& sheet) const = 0;
 
+    /**
+     * @brief Evaluates the formula as an array formula spilled into a block of the given size.
+     *
+     * Range references are resolved element-wise: each element of the result reads the cell
+     * of the range at the same offset. Single-row and single-column ranges are broadcast.
+     *
+     * @param sheet The sheet interface containing the cell values referenced by the formula.
+     * @param size The size of the target block.
+     * @return Row-major buffer with `size.rows * size.cols` computed values or errors.
+     */
+    [[nodiscard]] virtual std::vector<Value> EvaluateArray(const SheetInterface& sheet, Size size) const = 0;
+
     /**
      * @brief Returns the expression that describes the formula.
      *
@@ -42,11 +57,38 @@ public:
     /**
      * @brief Returns a list of cells that are directly involved in the evaluation of the formula.
      *
-     * The list is sorted in ascending order and does not contain duplicate cells.
+     * Range references contribute every cell of the range. The list is sorted in ascending order and does not contain duplicate cells.
      *
      * @return A vector of Position objects representing the cells referenced by the formula.
      */
     [[nodiscard]] virtual std::vector<Position> GetReferencedCells() const = 0;
+
+    /**
+     * @brief Returns the range references of the formula, such as `A1:B3`.
+     */
+    [[nodiscard]] virtual std::vector<Rect> GetReferencedRanges() const = 0;
+
+    /**
+     * @brief Returns the cells of GetReferencedCells() that every evaluation reads, unless it fails before.
+     *
+     * Cells referenced only by an IF branch or by an AND/OR argument after the first are left out.
+     * The list is sorted in ascending order and does not contain duplicate cells.
+     */
+    [[nodiscard]] virtual std::vector<Position> GetUnconditionalCells() const = 0;
+
+    /**
+     * @brief Returns the references to cells and ranges of other sheets, such as `Sheet2!A1`.
+     *
+     * They are not part of GetReferencedCells(), which lists cells of the sheet of the formula only.
+     */
+    [[nodiscard]] virtual std::vector<SheetReference> GetSheetReferences() const = 0;
+
+    /**
+     * @brief Replaces every single-cell reference `pos` with `remap(pos)` without re-parsing.
+     *
+     * Range references are positional and stay as they are.
+     */
+    virtual void RemapReferences(const std::function<Position(Position)>& remap) = 0;
 };
 
 /**
@@ -58,3 +100,18 @@ public:
  * @return A unique_ptr to a FormulaInterface object representing the parsed formula.
  */
 std::unique_ptr<FormulaInterface> ParseFormula(std::string expression);
+
+/**
+ * @brief Checks the given expression without parsing it into a formula and without throwing.
+ *
+ * @return The first syntax error, or nothing if `ParseFormula` accepts the expression.
+ */
+std::optional<FormulaSyntaxError> CheckFormula(std::string_view expression);
+
+/**
+ * @brief Reads a text as a number the way formulas read text cells: the whole text must be a number
+ * accepted by `std::strtod` that fits a double.
+ *
+ * @return The number, or nothing if the text does not read as one.
+ */
+std::optional<double> TextToNumber(std::string_view text);
@@ -3,22 +3,30 @@
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
 #include <type_traits>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "common.h"
+#include "parallel.h"
 #include "ranges.h"
 
 namespace graph {
 
     using VertexId = Position;
 
+    /// Dense vertex id, see `VertexIds`
+    using VertexIndex = std::uint32_t;
+    inline constexpr VertexIndex NO_VERTEX = std::numeric_limits<VertexIndex>::max();
+
     struct Edge {
         VertexId from;
         VertexId to;
@@ -28,8 +36,9 @@ namespace graph {
     };
 
     struct Hasher {
+        /// Row-major index: distinct for all valid positions, unlike a weighted sum of row and column
         std::size_t operator()(const Position& pos) const {
-            return std::hash<int>()(pos.row) + std::hash<int>()(pos.col) * INDEX;
+            return std::hash<std::size_t>()(static_cast<std::size_t>(pos.row) * Position::MAX_COLS + static_cast<std::size_t>(pos.col));
         }
 
         std::size_t operator()(const Edge& edge) const {
@@ -54,13 +63,200 @@ namespace graph {
         static const size_t INDEX = 42;
     };
 
-    using IncidenceList = std::unordered_set<const Edge*, Hasher>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
-    using EdgeContainer = std::unordered_set<Edge, Hasher>;
-    using IncidentEdges = std::unordered_map<VertexId, IncidenceList, Hasher>;
+    using EdgeContainer = std::vector<Edge>;
+}
+
+namespace graph /* VertexIds */ {
+
+    /**
+     * @brief Maps vertices to dense ids `0..Size()-1` so adjacency is stored in flat arrays.
+     *
+     * Ids are never reused: a vertex keeps its id for the lifetime of the graph. Each vertex also has
+     * a generation; advancing it invalidates all adjacency entries stamped with the previous one.
+     *
+     * Ids are looked up in a flat open-addressing table (linear probing, at most 3/4 full): loading a
+     * model resolves every edge end here, and a node-based hash map spends most of that time on cache
+     * misses and allocations.
+     */
+    class VertexIds {
+    public:
+        [[nodiscard]] VertexIndex Find(const VertexId& vertex) const;
+        VertexIndex Add(const VertexId& vertex);
+        [[nodiscard]] const VertexId& Get(VertexIndex index) const;
+        [[nodiscard]] size_t Size() const;
+        [[nodiscard]] std::uint32_t GetGeneration(VertexIndex index) const;
+        void AdvanceGeneration(VertexIndex index);
+        [[nodiscard]] size_t GetMemoryUsage() const;
+
+    private:
+        struct Slot {
+            VertexId vertex;
+            VertexIndex index = NO_VERTEX;
+        };
+
+        /// Slot holding `vertex`, or the empty slot where it would be inserted
+        [[nodiscard]] size_t FindSlot_(const VertexId& vertex) const;
+        void Grow_();
+
+    private:
+        /// Power-of-two sized, empty slots have index `NO_VERTEX`
+        std::vector<Slot> slots_;
+        std::vector<VertexId> vertices_;
+        std::vector<std::uint32_t> generations_;
+    };
+}
+
+namespace graph /* Adjacency */ {
+
+    /**
+     * @brief Compressed sparse row adjacency over dense vertex ids.
+     *
+     * Neighbors of vertex `v` are `targets_[offsets_[v]..offsets_[v + 1])`, one contiguous array for
+     * the whole graph. Removed neighbors are overwritten with `NO_VERTEX` tombstones and added ones go
+     * to a small per-vertex delta. Once the delta and dead entries outgrow a fraction of the graph they
+     * are merged into new contiguous arrays. Any modification invalidates neighbor iterators.
+     *
+     * A stamped adjacency also stores the generation of every neighbor (see `VertexIds`) at insertion:
+     * entries of older generations are stale and skipped, so all entries pointing to a vertex are
+     * dropped in O(1) by advancing its generation, without searching the lists that hold them.
+     */
+    class Adjacency {
+    public:
+        struct Slot {
+            VertexIndex vertex;
+            std::uint32_t stamp;
+        };
+
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = VertexIndex;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const VertexIndex*;
+            using reference = const VertexIndex&;
+
+            Iterator() = default;
+            Iterator(const Adjacency* adjacency, const VertexIndex* base, const VertexIndex* base_end, const Slot* delta, const Slot* delta_end);
+
+            reference operator*() const;
+            Iterator& operator++();
+            Iterator operator++(int);
+            bool operator==(const Iterator& other) const;
+            bool operator!=(const Iterator& other) const;
+
+        private:
+            void SkipDead_();
+
+        private:
+            const Adjacency* adjacency_ = nullptr;
+            const VertexIndex* base_ = nullptr;
+            const VertexIndex* base_end_ = nullptr;
+            const Slot* delta_ = nullptr;
+            const Slot* delta_end_ = nullptr;
+        };
+
+        using NeighborRange = ranges::Range<Iterator>;
+
+        Adjacency() = default;
+        /// Adjacency whose entries are stamped with the generations kept by `vertices`
+        explicit Adjacency(const VertexIds* vertices);
+
+        /// Adds the edge without checking for duplicates
+        void Add(VertexIndex from, VertexIndex to);
+        bool Remove(VertexIndex from, VertexIndex to);
+        /// Removes all edges of `from`, calling `on_removed(to)` for each of them
+        template <typename Action>
+        size_t RemoveAll(VertexIndex from, Action on_removed);
+        /// Accounts for an entry of `from` that went stale because its neighbor advanced the generation.
+        /// Does not compact: all stale entries must be discounted before the next modification.
+        void DiscountStale(VertexIndex from);
+        [[nodiscard]] bool Has(VertexIndex from, VertexIndex to) const;
+        [[nodiscard]] NeighborRange GetNeighbors(VertexIndex from) const;
+        [[nodiscard]] size_t GetDegree(VertexIndex from) const;
+        /// Number of vertices with at least one neighbor
+        [[nodiscard]] size_t GetVertexCount() const;
+        [[nodiscard]] size_t GetEdgeCount() const;
+        [[nodiscard]] size_t GetMemoryUsage() const;
+        /// Merges the delta into the contiguous arrays and drops dead entries
+        void Compact();
+        /// Compacts once the delta and dead entries outgrow a quarter of the arrays
+        void CompactIfNeeded();
+        /// Replaces all edges with contiguous arrays built elsewhere: neighbors of `v` are `targets[offsets[v]..offsets[v + 1])`
+        void Assign(std::vector<std::uint32_t> offsets, std::vector<VertexIndex> targets);
+
+    private:
+        [[nodiscard]] bool IsLive_(const VertexIndex* base) const;
+        [[nodiscard]] bool IsLive_(const Slot& slot) const;
+        [[nodiscard]] std::uint32_t GetStamp_(VertexIndex to) const;
+        [[nodiscard]] std::pair<VertexIndex*, VertexIndex*> GetBase_(VertexIndex from);
+        [[nodiscard]] std::pair<const VertexIndex*, const VertexIndex*> GetBase_(VertexIndex from) const;
+        void ChangeDegree_(VertexIndex from, bool increase);
+
+    private:
+        static constexpr size_t MIN_COMPACTION_SIZE = 1024;
+
+        const VertexIds* vertices_ = nullptr;
+        std::vector<std::uint32_t> offsets_ = {0};
+        std::vector<VertexIndex> targets_;
+        /// Generations of `targets_`, empty unless the adjacency is stamped
+        std::vector<std::uint32_t> stamps_;
+        std::unordered_map<VertexIndex, std::vector<Slot>> delta_;
+        std::vector<std::uint32_t> degrees_;
+        size_t edge_count_ = 0;
+        size_t vertex_count_ = 0;
+        size_t delta_size_ = 0;
+        size_t dead_ = 0;
+    };
+}
+
+namespace graph /* Traverser */ {
+
+    /**
+     * @brief Iterative graph search over dense vertex ids.
+     *
+     * Uses an explicit stack or queue instead of recursion, so arbitrarily long dependency chains
+     * cannot overflow the call stack. Visited vertices are marked with a per-search generation in an
+     * array indexed by vertex id; the array is kept between searches, so starting one costs O(1)
+     * instead of clearing or allocating a visited set.
+     */
+    class Traverser {
+    public:
+        enum class Order { depth_first, breadth_first };
+
+        /**
+         * @brief Visits every vertex reachable from `starts` once.
+         *
+         * `vertex_count` bounds the vertex ids of the graph. Calls `visit(from, to)` for the edge that
+         * discovered each new vertex `to`; the search stops as soon as `visit` returns true. Start
+         * vertices are marked before the search and never visited, even if an edge from another
+         * start vertex reaches them.
+         *
+         * @return true if stopped by `visit`
+         */
+        template <typename Visit>
+        bool Run(const Adjacency& adjacency, size_t vertex_count, const std::vector<VertexIndex>& starts, Order order, Visit visit);
+        /// Same as `Run`, but neither visits nor expands vertices for which `enter(vertex)` is false
+        template <typename Visit, typename Enter>
+        bool Run(const Adjacency& adjacency, size_t vertex_count, const std::vector<VertexIndex>& starts, Order order, Visit visit, Enter enter);
+
+    private:
+        /// Returns true if `vertex` was not marked in the current search yet
+        bool Mark_(VertexIndex vertex);
+        /// Starts a new search
+        void Reset_(size_t vertex_count);
+
+    private:
+        std::vector<std::uint32_t> marks_;
+        std::uint32_t generation_ = 0;
+        std::vector<VertexIndex> frontier_;
+    };
 }
 
 namespace graph /* IGraph */ {
+
+    class EdgeIterator;
+    using IncidentEdgesRange = ranges::Range<EdgeIterator>;
+
     class IGraph {
     public:
         virtual bool AddEdge(Edge edge) = 0;
@@ -70,12 +266,50 @@ namespace graph /* IGraph */ {
         [[nodiscard]] virtual IncidentEdgesRange GetIncidentEdges(VertexId vertex) const = 0;
         virtual bool EraseEdge(const Edge& edge) = 0;
         virtual bool EraseVertex(const VertexId& vertex_id) = 0;
-        virtual void Traversal(const VertexId& vertex_id, std::function<bool(const Edge*)> action) const = 0;
+        virtual void Traversal(const VertexId& vertex_id, std::function<bool(const Edge&)> action) const = 0;
         [[nodiscard]] virtual bool DetectCircularDependency(const VertexId& from, const std::vector<VertexId>& to_refs) const = 0;
 
     protected:
         virtual size_t AddEdgesImpl(EdgeContainer::iterator begin, EdgeContainer::iterator end) = 0;
     };
+
+    /// Yields the incident edges of a vertex as `Edge` values built from adjacency ids
+    class EdgeIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Edge;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Edge;
+
+        EdgeIterator() = default;
+        EdgeIterator(const VertexIds* vertices, VertexId from, Adjacency::Iterator neighbor)
+            : vertices_(vertices), from_(from), neighbor_(neighbor) {}
+
+        Edge operator*() const {
+            return {from_, vertices_->Get(*neighbor_)};
+        }
+        EdgeIterator& operator++() {
+            ++neighbor_;
+            return *this;
+        }
+        EdgeIterator operator++(int) {
+            EdgeIterator result = *this;
+            ++neighbor_;
+            return result;
+        }
+        bool operator==(const EdgeIterator& other) const {
+            return neighbor_ == other.neighbor_;
+        }
+        bool operator!=(const EdgeIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const VertexIds* vertices_ = nullptr;
+        VertexId from_;
+        Adjacency::Iterator neighbor_;
+    };
 }
 
 namespace graph /* DirectedGraph */ {
@@ -86,11 +320,13 @@ namespace graph /* DirectedGraph */ {
         friend DependencyGraph;
 
     public:
-        DirectedGraph() = default;
+        DirectedGraph();
+        /// Graph whose vertex ids are shared with other graphs over the same vertices, see `Adjacency` for `stamped`
+        explicit DirectedGraph(std::shared_ptr<VertexIds> vertices, bool stamped = false);
+        DirectedGraph(DirectedGraph&&) = default;
+        DirectedGraph& operator=(DirectedGraph&&) = default;
         ~DirectedGraph() = default;
 
-        DirectedGraph(EdgeContainer&& edges, IncidentEdges&& incidence_lists);
-
         bool AddEdge(Edge edge) override;
         template <typename It, std::enable_if_t<std::is_same_v<typename std::iterator_traits<It>::value_type, Edge>, bool> = true>
         size_t AddEdges(It begin, It end);
@@ -100,30 +336,444 @@ namespace graph /* DirectedGraph */ {
         IncidentEdgesRange GetIncidentEdges(VertexId vertex) const override;
         virtual bool EraseEdge(const Edge& edge) override;
         virtual bool EraseVertex(const VertexId& vertex_id) override;
-        void Traversal(const VertexId& vertex_id, std::function<bool(const Edge*)> action) const override;
+        /// Calls `action` for the edge discovering each vertex reachable from `vertex_id`, stops when it returns true
+        void Traversal(const VertexId& vertex_id, std::function<bool(const Edge&)> action) const override;
+        /// Iterative search from all `starts` at once, `visit(from, to)` as in `Traverser::Run`
+        template <typename Visit>
+        bool Search(const std::vector<VertexId>& starts, Traverser::Order order, Visit visit) const;
+        /// Search that neither visits nor expands vertices for which `enter(vertex)` is false
+        template <typename Visit, typename Enter>
+        bool Search(const std::vector<VertexId>& starts, Traverser::Order order, Visit visit, Enter enter) const;
         bool DetectCircularDependency(const VertexId& from, const std::vector<VertexId>& to_refs) const override;
 
+        /// Bytes used by the adjacency arrays, without the shared vertex ids
+        [[nodiscard]] size_t GetMemoryUsage() const;
+
     protected:
-        EdgeContainer edges_;
-        IncidentEdges incidence_lists_;
+        std::shared_ptr<VertexIds> vertices_;
+        Adjacency adjacency_;
+        /// Reused by searches, which are therefore not reentrant
+        mutable Traverser traverser_;
 
     protected:
         size_t AddEdgesImpl(EdgeContainer::iterator begin, EdgeContainer::iterator end) override;
     };
 }
 
+namespace graph /* VertexIds implementation */ {
+
+    inline VertexIndex VertexIds::Find(const VertexId& vertex) const {
+        return slots_.empty() ? NO_VERTEX : slots_[FindSlot_(vertex)].index;
+    }
+
+    inline VertexIndex VertexIds::Add(const VertexId& vertex) {
+        if ((vertices_.size() + 1) * 4 > slots_.size() * 3) {
+            Grow_();
+        }
+        Slot& slot = slots_[FindSlot_(vertex)];
+        if (slot.index == NO_VERTEX) {
+            slot = {vertex, static_cast<VertexIndex>(vertices_.size())};
+            vertices_.push_back(vertex);
+            generations_.push_back(0);
+        }
+        return slot.index;
+    }
+
+    inline size_t VertexIds::FindSlot_(const VertexId& vertex) const {
+        /// Row-major indices of neighboring cells are consecutive, the multiplication spreads them over the table
+        const size_t mask = slots_.size() - 1;
+        size_t slot = static_cast<size_t>((static_cast<std::uint64_t>(Hasher()(vertex)) * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+        while (slots_[slot].index != NO_VERTEX && (slots_[slot].vertex.row != vertex.row || slots_[slot].vertex.col != vertex.col)) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    inline void VertexIds::Grow_() {
+        slots_.assign(std::max<size_t>(slots_.size() * 2, 16), Slot{});
+        for (VertexIndex index = 0; index < vertices_.size(); ++index) {
+            slots_[FindSlot_(vertices_[index])] = {vertices_[index], index};
+        }
+    }
+
+    inline const VertexId& VertexIds::Get(VertexIndex index) const {
+        assert(index < vertices_.size());
+        return vertices_[index];
+    }
+
+    inline size_t VertexIds::Size() const {
+        return vertices_.size();
+    }
+
+    inline std::uint32_t VertexIds::GetGeneration(VertexIndex index) const {
+        assert(index < generations_.size());
+        return generations_[index];
+    }
+
+    inline void VertexIds::AdvanceGeneration(VertexIndex index) {
+        assert(index < generations_.size());
+        ++generations_[index];
+    }
+
+    inline size_t VertexIds::GetMemoryUsage() const {
+        return vertices_.capacity() * sizeof(VertexId) + generations_.capacity() * sizeof(std::uint32_t) + slots_.capacity() * sizeof(Slot);
+    }
+}
+
+namespace graph /* Adjacency implementation */ {
+
+    inline Adjacency::Iterator::Iterator(const Adjacency* adjacency, const VertexIndex* base, const VertexIndex* base_end, const Slot* delta,
+                                         const Slot* delta_end)
+        : adjacency_(adjacency), base_(base), base_end_(base_end), delta_(delta), delta_end_(delta_end) {
+        SkipDead_();
+    }
+
+    inline Adjacency::Iterator::reference Adjacency::Iterator::operator*() const {
+        return base_ != base_end_ ? *base_ : delta_->vertex;
+    }
+
+    inline Adjacency::Iterator& Adjacency::Iterator::operator++() {
+        if (base_ != base_end_) {
+            ++base_;
+        } else {
+            ++delta_;
+        }
+        SkipDead_();
+        return *this;
+    }
+
+    inline Adjacency::Iterator Adjacency::Iterator::operator++(int) {
+        Iterator result = *this;
+        ++*this;
+        return result;
+    }
+
+    inline bool Adjacency::Iterator::operator==(const Iterator& other) const {
+        return base_ == other.base_ && delta_ == other.delta_;
+    }
+
+    inline bool Adjacency::Iterator::operator!=(const Iterator& other) const {
+        return !(*this == other);
+    }
+
+    inline void Adjacency::Iterator::SkipDead_() {
+        while (base_ != base_end_ && !adjacency_->IsLive_(base_)) {
+            ++base_;
+        }
+        if (base_ == base_end_) {
+            while (delta_ != delta_end_ && !adjacency_->IsLive_(*delta_)) {
+                ++delta_;
+            }
+        }
+    }
+
+    inline Adjacency::Adjacency(const VertexIds* vertices) : vertices_(vertices) {}
+
+    inline void Adjacency::Add(VertexIndex from, VertexIndex to) {
+        delta_[from].push_back({to, GetStamp_(to)});
+        ++delta_size_;
+        ++edge_count_;
+        ChangeDegree_(from, true);
+        CompactIfNeeded();
+    }
+
+    inline bool Adjacency::Remove(VertexIndex from, VertexIndex to) {
+        auto [base, base_end] = GetBase_(from);
+        if (const auto it = std::find_if(base, base_end, [&](const VertexIndex& target) { return target == to && IsLive_(&target); }); it != base_end) {
+            *it = NO_VERTEX;
+            ++dead_;
+        } else {
+            const auto delta_it = delta_.find(from);
+            if (delta_it == delta_.end()) {
+                return false;
+            }
+            auto& slots = delta_it->second;
+            const auto slot_it = std::find_if(slots.begin(), slots.end(), [&](const Slot& slot) { return slot.vertex == to && IsLive_(slot); });
+            if (slot_it == slots.end()) {
+                return false;
+            }
+            *slot_it = slots.back();
+            slots.pop_back();
+            --delta_size_;
+            if (slots.empty()) {
+                delta_.erase(delta_it);
+            }
+        }
+
+        --edge_count_;
+        ChangeDegree_(from, false);
+        CompactIfNeeded();
+        return true;
+    }
+
+    template <typename Action>
+    size_t Adjacency::RemoveAll(VertexIndex from, Action on_removed) {
+        size_t count = 0;
+        auto [base, base_end] = GetBase_(from);
+        for (VertexIndex* target = base; target != base_end; ++target) {
+            if (*target != NO_VERTEX) {
+                if (IsLive_(target)) {
+                    on_removed(*target);
+                    ++count;
+                } else {
+                    --dead_;  // counted as dead already
+                }
+                *target = NO_VERTEX;
+                ++dead_;
+            }
+        }
+
+        if (const auto delta_it = delta_.find(from); delta_it != delta_.end()) {
+            for (const Slot& slot : delta_it->second) {
+                if (IsLive_(slot)) {
+                    on_removed(slot.vertex);
+                    ++count;
+                } else {
+                    --dead_;
+                }
+            }
+            delta_size_ -= delta_it->second.size();
+            delta_.erase(delta_it);
+        }
+
+        if (count > 0) {
+            edge_count_ -= count;
+            degrees_[from] = 0;
+            --vertex_count_;
+        }
+        CompactIfNeeded();
+        return count;
+    }
+
+    inline void Adjacency::DiscountStale(VertexIndex from) {
+        --edge_count_;
+        ++dead_;
+        ChangeDegree_(from, false);
+    }
+
+    inline bool Adjacency::Has(VertexIndex from, VertexIndex to) const {
+        const auto neighbors = GetNeighbors(from);
+        return std::find(neighbors.begin(), neighbors.end(), to) != neighbors.end();
+    }
+
+    inline Adjacency::NeighborRange Adjacency::GetNeighbors(VertexIndex from) const {
+        const auto [base, base_end] = GetBase_(from);
+        const Slot* delta = nullptr;
+        const Slot* delta_end = nullptr;
+        if (const auto delta_it = delta_.find(from); delta_it != delta_.end()) {
+            delta = delta_it->second.data();
+            delta_end = delta + delta_it->second.size();
+        }
+        return {Iterator(this, base, base_end, delta, delta_end), Iterator(this, base_end, base_end, delta_end, delta_end)};
+    }
+
+    inline size_t Adjacency::GetDegree(VertexIndex from) const {
+        return from < degrees_.size() ? degrees_[from] : 0;
+    }
+
+    inline size_t Adjacency::GetVertexCount() const {
+        return vertex_count_;
+    }
+
+    inline size_t Adjacency::GetEdgeCount() const {
+        return edge_count_;
+    }
+
+    inline size_t Adjacency::GetMemoryUsage() const {
+        size_t delta_bytes = delta_.bucket_count() * sizeof(void*);
+        for (const auto& [from, slots] : delta_) {
+            delta_bytes += sizeof(std::pair<const VertexIndex, std::vector<Slot>>) + sizeof(void*) + slots.capacity() * sizeof(Slot);
+        }
+        return offsets_.capacity() * sizeof(std::uint32_t) + targets_.capacity() * sizeof(VertexIndex) + stamps_.capacity() * sizeof(std::uint32_t) +
+               degrees_.capacity() * sizeof(std::uint32_t) + delta_bytes;
+    }
+
+    inline void Adjacency::Compact() {
+        std::vector<std::uint32_t> offsets(degrees_.size() + 1);
+        std::vector<VertexIndex> targets;
+        std::vector<std::uint32_t> stamps;
+        targets.reserve(edge_count_);
+        stamps.reserve(vertices_ != nullptr ? edge_count_ : 0);
+
+        const auto append = [&](VertexIndex to, std::uint32_t stamp) {
+            targets.push_back(to);
+            if (vertices_ != nullptr) {
+                stamps.push_back(stamp);
+            }
+        };
+        for (VertexIndex from = 0; from < degrees_.size(); ++from) {
+            offsets[from] = static_cast<std::uint32_t>(targets.size());
+            if (degrees_[from] == 0) {
+                continue;
+            }
+
+            const auto [base, base_end] = std::as_const(*this).GetBase_(from);
+            for (const VertexIndex* target = base; target != base_end; ++target) {
+                if (IsLive_(target)) {
+                    append(*target, vertices_ != nullptr ? stamps_[target - targets_.data()] : 0);
+                }
+            }
+            if (const auto delta_it = delta_.find(from); delta_it != delta_.end()) {
+                for (const Slot& slot : delta_it->second) {
+                    if (IsLive_(slot)) {
+                        append(slot.vertex, slot.stamp);
+                    }
+                }
+            }
+        }
+        offsets.back() = static_cast<std::uint32_t>(targets.size());
+        assert(targets.size() == edge_count_);
+
+        offsets_ = std::move(offsets);
+        targets_ = std::move(targets);
+        stamps_ = std::move(stamps);
+        delta_.clear();
+        delta_size_ = 0;
+        dead_ = 0;
+    }
+
+    inline bool Adjacency::IsLive_(const VertexIndex* base) const {
+        return *base != NO_VERTEX && (vertices_ == nullptr || stamps_[base - targets_.data()] == vertices_->GetGeneration(*base));
+    }
+
+    inline bool Adjacency::IsLive_(const Slot& slot) const {
+        return vertices_ == nullptr || slot.stamp == vertices_->GetGeneration(slot.vertex);
+    }
+
+    inline std::uint32_t Adjacency::GetStamp_(VertexIndex to) const {
+        return vertices_ != nullptr ? vertices_->GetGeneration(to) : 0;
+    }
+
+    inline std::pair<VertexIndex*, VertexIndex*> Adjacency::GetBase_(VertexIndex from) {
+        if (static_cast<size_t>(from) + 1 >= offsets_.size()) {
+            return {nullptr, nullptr};
+        }
+        return {targets_.data() + offsets_[from], targets_.data() + offsets_[from + 1]};
+    }
+
+    inline std::pair<const VertexIndex*, const VertexIndex*> Adjacency::GetBase_(VertexIndex from) const {
+        if (static_cast<size_t>(from) + 1 >= offsets_.size()) {
+            return {nullptr, nullptr};
+        }
+        return {targets_.data() + offsets_[from], targets_.data() + offsets_[from + 1]};
+    }
+
+    inline void Adjacency::ChangeDegree_(VertexIndex from, bool increase) {
+        if (from >= degrees_.size()) {
+            degrees_.resize(static_cast<size_t>(from) + 1);
+        }
+        if (increase) {
+            vertex_count_ += degrees_[from]++ == 0 ? 1 : 0;
+        } else {
+            vertex_count_ -= --degrees_[from] == 0 ? 1 : 0;
+        }
+    }
+
+    inline void Adjacency::CompactIfNeeded() {
+        if (delta_size_ + dead_ > std::max(MIN_COMPACTION_SIZE, targets_.size() / 4)) {
+            Compact();
+        }
+    }
+
+    inline void Adjacency::Assign(std::vector<std::uint32_t> offsets, std::vector<VertexIndex> targets) {
+        assert(!offsets.empty() && offsets.back() == targets.size());
+        degrees_.resize(offsets.size() - 1);
+        vertex_count_ = 0;
+        for (size_t from = 0; from < degrees_.size(); ++from) {
+            degrees_[from] = offsets[from + 1] - offsets[from];
+            vertex_count_ += degrees_[from] > 0 ? 1 : 0;
+        }
+
+        stamps_.clear();
+        if (vertices_ != nullptr) {
+            stamps_.reserve(targets.size());
+            std::transform(targets.begin(), targets.end(), std::back_inserter(stamps_), [this](VertexIndex to) { return GetStamp_(to); });
+        }
+        offsets_ = std::move(offsets);
+        targets_ = std::move(targets);
+        edge_count_ = targets_.size();
+        delta_.clear();
+        delta_size_ = 0;
+        dead_ = 0;
+    }
+}
+
+namespace graph /* Traverser implementation */ {
+
+    template <typename Visit>
+    bool Traverser::Run(const Adjacency& adjacency, size_t vertex_count, const std::vector<VertexIndex>& starts, Order order, Visit visit) {
+        return Run(adjacency, vertex_count, starts, order, std::move(visit), [](VertexIndex) { return true; });
+    }
+
+    template <typename Visit, typename Enter>
+    bool Traverser::Run(const Adjacency& adjacency, size_t vertex_count, const std::vector<VertexIndex>& starts, Order order, Visit visit, Enter enter) {
+        Reset_(vertex_count);
+        for (const VertexIndex start : starts) {
+            if (start != NO_VERTEX && start < marks_.size() && Mark_(start)) {
+                frontier_.push_back(start);
+            }
+        }
+
+        /// The queue is the same vector consumed from the front
+        size_t head = 0;
+        while (head < frontier_.size()) {
+            VertexIndex from;
+            if (order == Order::depth_first) {
+                from = frontier_.back();
+                frontier_.pop_back();
+            } else {
+                from = frontier_[head++];
+            }
+
+            for (const VertexIndex to : adjacency.GetNeighbors(from)) {
+                if (!enter(to) || !Mark_(to)) {
+                    continue;
+                }
+                if (visit(from, to)) {
+                    frontier_.clear();
+                    return true;
+                }
+                frontier_.push_back(to);
+            }
+        }
+        frontier_.clear();
+        return false;
+    }
+
+    inline bool Traverser::Mark_(VertexIndex vertex) {
+        if (marks_[vertex] == generation_) {
+            return false;
+        }
+        marks_[vertex] = generation_;
+        return true;
+    }
+
+    inline void Traverser::Reset_(size_t vertex_count) {
+        if (marks_.size() < vertex_count) {
+            marks_.resize(vertex_count, generation_);
+        }
+        if (++generation_ == 0) {
+            std::fill(marks_.begin(), marks_.end(), 0);
+            generation_ = 1;
+        }
+    }
+}
+
 namespace graph /* DirectedGraph implementation */ {
 
-    inline DirectedGraph::DirectedGraph(EdgeContainer&& edges, IncidentEdges&& incidence_lists)
-        : edges_(std::move(edges)), incidence_lists_(std::move(incidence_lists)) {}
+    inline DirectedGraph::DirectedGraph() : vertices_(std::make_shared<VertexIds>()) {}
+
+    inline DirectedGraph::DirectedGraph(std::shared_ptr<VertexIds> vertices, bool stamped)
+        : vertices_(std::move(vertices)), adjacency_(stamped ? Adjacency(vertices_.get()) : Adjacency()) {}
 
     inline bool DirectedGraph::AddEdge(Edge edge) {
-        auto emplaced_edge = edges_.emplace(std::move(edge));
-        if (!emplaced_edge.second) {
+        const VertexIndex from = vertices_->Add(edge.from);
+        const VertexIndex to = vertices_->Add(edge.to);
+        if (adjacency_.Has(from, to)) {
             return false;
         }
 
-        incidence_lists_[emplaced_edge.first->from].emplace(&*emplaced_edge.first);
+        adjacency_.Add(from, to);
         return true;
     }
 
@@ -141,113 +791,102 @@ namespace graph /* DirectedGraph implementation */ {
     }
 
     inline bool DirectedGraph::HasEdge(const Edge& edge) const {
-        return edges_.count(edge) != 0;
+        const VertexIndex from = vertices_->Find(edge.from);
+        const VertexIndex to = vertices_->Find(edge.to);
+        return from != NO_VERTEX && to != NO_VERTEX && adjacency_.Has(from, to);
     }
 
     inline bool DirectedGraph::EraseEdge(const Edge& edge) {
-        if (!edges_.erase(edge)) {
-            return false;
-        }
-
-        incidence_lists_.erase(edge.from);
-        return true;
+        const VertexIndex from = vertices_->Find(edge.from);
+        const VertexIndex to = vertices_->Find(edge.to);
+        return from != NO_VERTEX && to != NO_VERTEX && adjacency_.Remove(from, to);
     }
 
     inline size_t DirectedGraph::GetVertexCount() const {
-        return incidence_lists_.size();
+        return adjacency_.GetVertexCount();
     }
 
     inline size_t DirectedGraph::GetEdgeCount() const {
-        return edges_.size();
+        return adjacency_.GetEdgeCount();
     }
 
     inline IncidentEdgesRange DirectedGraph::GetIncidentEdges(VertexId vertex) const {
-        return ranges::AsRange(incidence_lists_.at(vertex));
+        const VertexIndex from = vertices_->Find(vertex);
+        if (from == NO_VERTEX) {
+            return {EdgeIterator(), EdgeIterator()};
+        }
+
+        const auto neighbors = adjacency_.GetNeighbors(from);
+        return {EdgeIterator(vertices_.get(), vertex, neighbors.begin()), EdgeIterator(vertices_.get(), vertex, neighbors.end())};
     }
 
     inline bool DirectedGraph::EraseVertex(const VertexId& vertex_id) {
-        const auto incidence_it = incidence_lists_.find(vertex_id);
-        if (incidence_it == incidence_lists_.end()) {
-            return false;
-        }
-        if (incidence_lists_.size() == 1) {
-            edges_.clear();
-        } else {
-            for (auto ptr = edges_.begin(), last = edges_.end(); ptr != last;) {
-                if (incidence_it->second.count(&*ptr)) {
-                    ptr = edges_.erase(ptr);
-                } else {
-                    ++ptr;
-                }
-            }
-        }
-        incidence_lists_.erase(incidence_it);
-        return true;
+        const VertexIndex from = vertices_->Find(vertex_id);
+        return from != NO_VERTEX && adjacency_.RemoveAll(from, [](VertexIndex) {}) > 0;
     }
 
-    inline void DirectedGraph::Traversal(const VertexId& vertex_id, std::function<bool(const Edge*)> action) const {
-        const auto incidence_edges_it = incidence_lists_.find(vertex_id);
-        if (incidence_edges_it == incidence_lists_.end()) {
-            return;
-        }
-        std::function<void(const VertexId&)> traverse;
-        std::unordered_set<VertexId, Hasher> visited;
-        traverse = [&](const VertexId& from) {
-            const auto incidence_edges_it = incidence_lists_.find(from);
-            if (incidence_edges_it == incidence_lists_.end()) {
-                return;
-            }
-
-            const bool stop_traverse = std::any_of(incidence_edges_it->second.begin(), incidence_edges_it->second.end(), [&](const Edge* edge) {
-                if (visited.count(edge->from) > 0) {
-                    return false;
-                }
-
-                traverse(edge->to);
+    inline size_t DirectedGraph::GetMemoryUsage() const {
+        return adjacency_.GetMemoryUsage();
+    }
 
-                visited.emplace(edge->to);
-                return action(edge);
-            });
+    inline void DirectedGraph::Traversal(const VertexId& vertex_id, std::function<bool(const Edge&)> action) const {
+        Search({vertex_id}, Traverser::Order::depth_first, [&action](const VertexId& from, const VertexId& to) { return action(Edge{from, to}); });
+    }
 
-            if (stop_traverse) {
-                return;
-            }
-        };
+    template <typename Visit>
+    bool DirectedGraph::Search(const std::vector<VertexId>& starts, Traverser::Order order, Visit visit) const {
+        return Search(starts, order, std::move(visit), [](const VertexId&) { return true; });
+    }
 
-        traverse(vertex_id);
+    template <typename Visit, typename Enter>
+    bool DirectedGraph::Search(const std::vector<VertexId>& starts, Traverser::Order order, Visit visit, Enter enter) const {
+        std::vector<VertexIndex> start_indices;
+        start_indices.reserve(starts.size());
+        std::transform(starts.begin(), starts.end(), std::back_inserter(start_indices), [this](const VertexId& start) { return vertices_->Find(start); });
+        return traverser_.Run(
+            adjacency_, vertices_->Size(), start_indices, order, [&](VertexIndex from, VertexIndex to) { return visit(vertices_->Get(from), vertices_->Get(to)); },
+            [&](VertexIndex vertex) { return enter(vertices_->Get(vertex)); });
     }
 
     inline bool DirectedGraph::DetectCircularDependency(const VertexId& from, const std::vector<VertexId>& to_refs) const {
-        return std::any_of(to_refs.begin(), to_refs.end(), [&](const VertexId& ref) {
-            if (from == ref) {
-                return true;
-            }
-
-            const auto incidence_edges_it = incidence_lists_.find(ref);
-            if (incidence_edges_it == incidence_lists_.end()) {
-                return false;
-            }
+        if (std::find(to_refs.begin(), to_refs.end(), from) != to_refs.end()) {
+            return true;
+        }
 
-            bool has_circular_dependency = false;
-            Traversal(ref, [&](const Edge* edge) -> bool {
-                if (from == edge->to) {
-                    has_circular_dependency = true;
-                    return true;
-                }
-                return false;
-            });
-            return has_circular_dependency;
-        });
+        /// A vertex without an id cannot be reached, otherwise one search covers all references
+        const VertexIndex target = vertices_->Find(from);
+        if (target == NO_VERTEX) {
+            return false;
+        }
+        std::vector<VertexIndex> starts;
+        starts.reserve(to_refs.size());
+        std::transform(to_refs.begin(), to_refs.end(), std::back_inserter(starts), [this](const VertexId& ref) { return vertices_->Find(ref); });
+        return traverser_.Run(adjacency_, vertices_->Size(), starts, Traverser::Order::depth_first,
+                              [target](VertexIndex, VertexIndex to) { return to == target; });
     }
 }
 
 namespace graph /* Graph DependencyGraph */ {
 
+    /**
+     * @brief Forward (formula -> referenced cell) and backward (cell -> dependent formula) adjacency
+     * over one set of dense vertex ids, so an edge costs one id in each direction.
+     *
+     * Backward entries are stamped with the generation of the dependent formula. Removing the edges of a
+     * formula advances its generation instead of searching the dependents list of every referenced cell,
+     * which for a cell referenced by millions of formulas would be as slow as a full scan. Edits cost
+     * O(references of the edited formula) regardless of fan-in.
+     *
+     * The graph also maintains a topological order of its vertices (Pearce-Kelly): every cell comes
+     * before the formulas referencing it. A new reference that already agrees with the order cannot
+     * close a cycle, so most cycle checks are one comparison; otherwise only the vertices between the
+     * two positions in the order are searched and reordered.
+     */
     class DependencyGraph final : IGraph {
     public:
-        DependencyGraph() = default;
-        DependencyGraph(DirectedGraph forward_graph, DirectedGraph backward_graph)
-            : forward_graph_(std::move(forward_graph)), backward_graph_(std::move(backward_graph)) {}
+        DependencyGraph();
+        DependencyGraph(DependencyGraph&&) = default;
+        DependencyGraph& operator=(DependencyGraph&&) = default;
         ~DependencyGraph() = default;
 
     public:
@@ -255,6 +894,16 @@ namespace graph /* Graph DependencyGraph */ {
 
     public:
         bool AddEdge(Edge edge) override;
+        /**
+         * @brief Adds many edges at once, e.g. when a model is loaded.
+         *
+         * A batch that is large compared to the graph rebuilds both directions in bulk: edges are
+         * bucketed by vertex with a counting sort, neighbor lists are sorted and deduplicated in
+         * parallel, and the backward arrays and the topological order (Kahn) are derived in linear
+         * passes. Smaller batches are added edge by edge.
+         *
+         * @return number of edges that were not in the graph yet
+         */
         template <typename It, std::enable_if_t<std::is_same_v<typename std::iterator_traits<It>::value_type, Edge>, bool> = true>
         size_t AddEdges(It begin, It end);
         bool EraseEdge(const Edge& edge) override;
@@ -263,13 +912,38 @@ namespace graph /* Graph DependencyGraph */ {
         size_t GetVertexCount() const override;
         size_t GetEdgeCount() const override;
         IncidentEdgesRange GetIncidentEdges(VertexId vertex) const override;
-        void Traversal(const VertexId& vertex_id, std::function<bool(const Edge*)> action) const override;
-        void Traversal(const VertexId& vertex_id, std::function<bool(const Edge*)> action, Direction direction = Direction::forward) const;
+        IncidentEdgesRange GetIncidentEdges(VertexId vertex, Direction direction) const;
+        void Traversal(const VertexId& vertex_id, std::function<bool(const Edge&)> action) const override;
+        void Traversal(const VertexId& vertex_id, std::function<bool(const Edge&)> action, Direction direction = Direction::forward) const;
+        template <typename Visit>
+        bool Search(const std::vector<VertexId>& starts, Traverser::Order order, Visit visit, Direction direction = Direction::forward) const;
+        template <typename Visit, typename Enter>
+        bool Search(const std::vector<VertexId>& starts, Traverser::Order order, Visit visit, Enter enter, Direction direction) const;
         bool DetectCircularDependency(const VertexId& from, const std::vector<VertexId>& to_refs) const override;
 
+        /// Position of the vertex in the topological order, referenced cells come first
+        [[nodiscard]] std::uint32_t GetTopologicalIndex(const VertexId& vertex) const;
+        /// False once an edge closed a cycle, then cycle checks fall back to plain searches
+        [[nodiscard]] bool HasTopologicalOrder() const;
+
+        /// Bytes used by both directions and the vertex ids
+        [[nodiscard]] size_t GetMemoryUsage() const;
+
     private:
+        VertexIndex AddVertex_(const VertexId& vertex);
+        bool AddEdge_(VertexIndex from, VertexIndex to);
+        /// Rebuilds both directions and the order from the current edges and `edges`, returns the number of new edges
+        size_t Build_(std::vector<std::pair<VertexIndex, VertexIndex>> edges);
+        /// Restores the order after adding edge `from` -> `to`, returns false if the edge closed a cycle
+        bool Reorder_(VertexIndex from, VertexIndex to);
+
+    private:
+        std::shared_ptr<VertexIds> vertices_;
         DirectedGraph forward_graph_;
         DirectedGraph backward_graph_;
+        /// Topological index of every vertex id, a permutation of the ids
+        std::vector<std::uint32_t> order_;
+        bool ordered_ = true;
 
     private:
         size_t AddEdgesImpl(EdgeContainer::iterator begin, EdgeContainer::iterator end) override;
@@ -278,30 +952,188 @@ namespace graph /* Graph DependencyGraph */ {
 
 namespace graph /* Graph implementation */ {
 
+    inline DependencyGraph::DependencyGraph()
+        : vertices_(std::make_shared<VertexIds>()), forward_graph_(vertices_), backward_graph_(vertices_, true) {}
+
     inline bool DependencyGraph::AddEdge(Edge edge) {
-        const bool success = forward_graph_.AddEdge(edge);
-        if (success) {
-            backward_graph_.AddEdge(Edge{edge.to, edge.from});
+        /// New vertices go to the end of the order, so a new referenced cell is added first
+        const VertexIndex to = AddVertex_(edge.to);
+        const VertexIndex from = AddVertex_(edge.from);
+        return AddEdge_(from, to);
+    }
+
+    inline bool DependencyGraph::AddEdge_(VertexIndex from, VertexIndex to) {
+        if (forward_graph_.adjacency_.Has(from, to)) {
+            return false;
+        }
+
+        /// Both directions always hold the same edges, so the backward one needs no duplicate check
+        forward_graph_.adjacency_.Add(from, to);
+        backward_graph_.adjacency_.Add(to, from);
+        ordered_ = ordered_ && Reorder_(from, to);
+        return true;
+    }
+
+    inline VertexIndex DependencyGraph::AddVertex_(const VertexId& vertex) {
+        const VertexIndex index = vertices_->Add(vertex);
+        if (index == order_.size()) {
+            order_.push_back(static_cast<std::uint32_t>(index));
         }
-        return success;
+        return index;
+    }
+
+    inline bool DependencyGraph::Reorder_(VertexIndex from, VertexIndex to) {
+        const std::uint32_t lower = order_[from];
+        const std::uint32_t upper = order_[to];
+        if (upper < lower) {
+            return true;
+        }
+        if (from == to) {
+            return false;
+        }
+
+        /// `from` and its dependents placed before `to` must move after `to` and everything it references
+        std::vector<VertexIndex> dependents = {from};
+        const bool cycle = backward_graph_.traverser_.Run(
+            backward_graph_.adjacency_, order_.size(), {from}, Traverser::Order::depth_first,
+            [&](VertexIndex, VertexIndex vertex) {
+                dependents.push_back(vertex);
+                return vertex == to;
+            },
+            [&](VertexIndex vertex) { return order_[vertex] <= upper; });
+        if (cycle) {
+            return false;
+        }
+
+        std::vector<VertexIndex> references = {to};
+        forward_graph_.traverser_.Run(
+            forward_graph_.adjacency_, order_.size(), {to}, Traverser::Order::depth_first,
+            [&](VertexIndex, VertexIndex vertex) {
+                references.push_back(vertex);
+                return false;
+            },
+            [&](VertexIndex vertex) { return order_[vertex] >= lower; });
+
+        /// Both groups keep their relative order and take over the freed positions, references first
+        const auto by_order = [this](VertexIndex lhs, VertexIndex rhs) { return order_[lhs] < order_[rhs]; };
+        std::sort(references.begin(), references.end(), by_order);
+        std::sort(dependents.begin(), dependents.end(), by_order);
+        std::vector<std::uint32_t> positions;
+        positions.reserve(references.size() + dependents.size());
+        std::transform(references.begin(), references.end(), std::back_inserter(positions), [this](VertexIndex vertex) { return order_[vertex]; });
+        std::transform(dependents.begin(), dependents.end(), std::back_inserter(positions), [this](VertexIndex vertex) { return order_[vertex]; });
+        std::sort(positions.begin(), positions.end());
+
+        auto position = positions.begin();
+        for (const auto* group : {&references, &dependents}) {
+            for (const VertexIndex vertex : *group) {
+                order_[vertex] = *position++;
+            }
+        }
+        return true;
     }
 
     template <typename It, std::enable_if_t<std::is_same_v<typename std::iterator_traits<It>::value_type, Edge>, bool>>
     size_t DependencyGraph::AddEdges(It begin, It end) {
-        const size_t count = forward_graph_.AddEdges(begin, end);
-        if (count == 0) {
-            return count;
+        std::vector<std::pair<VertexIndex, VertexIndex>> edges;
+        std::for_each(begin, end, [&](const Edge& edge) {
+            const VertexIndex to = AddVertex_(edge.to);
+            edges.emplace_back(AddVertex_(edge.from), to);
+        });
+
+        /// Rebuilding costs time linear in the whole graph
+        if (edges.size() * 4 >= GetEdgeCount()) {
+            return Build_(std::move(edges));
         }
+        return static_cast<size_t>(std::count_if(edges.begin(), edges.end(), [this](const auto& edge) { return AddEdge_(edge.first, edge.second); }));
+    }
+
+    inline size_t DependencyGraph::Build_(std::vector<std::pair<VertexIndex, VertexIndex>> edges) {
+        static constexpr size_t MIN_PARALLEL_EDGES = 1 << 16;
 
-        std::vector<Edge> tmp(count);
-        std::transform(std::move_iterator(begin), std::move_iterator(end), tmp.rbegin(), [](auto&& edge) {
-            return Edge{edge.to, edge.from};
+        const size_t vertex_count = order_.size();
+        const size_t old_count = GetEdgeCount();
+        const Adjacency& forward = forward_graph_.adjacency_;
+        for (VertexIndex from = 0; from < vertex_count; ++from) {
+            if (forward.GetDegree(from) > 0) {
+                const auto neighbors = forward.GetNeighbors(from);
+                std::for_each(neighbors.begin(), neighbors.end(), [&](VertexIndex to) { edges.emplace_back(from, to); });
+            }
+        }
+
+        /// Counting sort by source vertex
+        std::vector<std::uint32_t> offsets(vertex_count + 1);
+        std::for_each(edges.begin(), edges.end(), [&offsets](const auto& edge) { ++offsets[edge.first + 1]; });
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<VertexIndex> targets(edges.size());
+        {
+            std::vector<std::uint32_t> next(offsets.begin(), offsets.end() - 1);
+            std::for_each(edges.begin(), edges.end(), [&](const auto& edge) { targets[next[edge.first]++] = edge.second; });
+            edges = {};
+        }
+
+        /// Neighbor lists are sorted and deduplicated independently, then packed
+        std::vector<std::uint32_t> degrees(vertex_count);
+        const size_t chunks = targets.size() >= MIN_PARALLEL_EDGES ? std::min(parallel::ResolveThreadCount(0), vertex_count) : 1;
+        parallel::ForEachIndex(chunks, [&](size_t chunk) {
+            for (size_t from = vertex_count * chunk / chunks; from < vertex_count * (chunk + 1) / chunks; ++from) {
+                const auto first = targets.begin() + offsets[from];
+                const auto last = targets.begin() + offsets[from + 1];
+                std::sort(first, last);
+                degrees[from] = static_cast<std::uint32_t>(std::unique(first, last) - first);
+            }
         });
+        std::uint32_t size = 0;
+        for (size_t from = 0; from < vertex_count; ++from) {
+            std::copy_n(targets.begin() + offsets[from], degrees[from], targets.begin() + size);
+            offsets[from] = size;
+            size += degrees[from];
+        }
+        offsets.back() = size;
+        targets.resize(size);
+
+        /// Sources come out sorted, as the forward arrays are scanned in order of source
+        std::vector<std::uint32_t> backward_offsets(vertex_count + 1);
+        std::for_each(targets.begin(), targets.end(), [&backward_offsets](VertexIndex to) { ++backward_offsets[to + 1]; });
+        std::partial_sum(backward_offsets.begin(), backward_offsets.end(), backward_offsets.begin());
+        std::vector<VertexIndex> sources(targets.size());
+        {
+            std::vector<std::uint32_t> next(backward_offsets.begin(), backward_offsets.end() - 1);
+            for (VertexIndex from = 0; from < vertex_count; ++from) {
+                std::for_each(targets.begin() + offsets[from], targets.begin() + offsets[from + 1], [&](VertexIndex to) { sources[next[to]++] = from; });
+            }
+        }
 
-        [[maybe_unused]] const size_t back_count = backward_graph_.AddEdges(std::move_iterator(tmp.begin()), std::move_iterator(tmp.end()));
-        assert(back_count == count);
+        /// Kahn: a vertex is placed once all cells it references are; vertices left over lie on cycles
+        std::vector<VertexIndex> ready;
+        ready.reserve(vertex_count);
+        for (VertexIndex vertex = 0; vertex < vertex_count; ++vertex) {
+            if (degrees[vertex] == 0) {
+                ready.push_back(vertex);
+            }
+        }
+        for (size_t head = 0; head < ready.size(); ++head) {
+            const VertexIndex vertex = ready[head];
+            order_[vertex] = static_cast<std::uint32_t>(head);
+            std::for_each(sources.begin() + backward_offsets[vertex], sources.begin() + backward_offsets[vertex + 1], [&](VertexIndex dependent) {
+                if (--degrees[dependent] == 0) {
+                    ready.push_back(dependent);
+                }
+            });
+        }
+        ordered_ = ready.size() == vertex_count;
+        if (!ordered_) {
+            auto position = static_cast<std::uint32_t>(ready.size());
+            for (VertexIndex vertex = 0; vertex < vertex_count; ++vertex) {
+                if (degrees[vertex] > 0) {
+                    order_[vertex] = position++;
+                }
+            }
+        }
 
-        return count;
+        forward_graph_.adjacency_.Assign(std::move(offsets), std::move(targets));
+        backward_graph_.adjacency_.Assign(std::move(backward_offsets), std::move(sources));
+        return GetEdgeCount() - old_count;
     }
 
     inline size_t DependencyGraph::AddEdgesImpl(EdgeContainer::iterator begin, EdgeContainer::iterator end) {
@@ -309,26 +1141,32 @@ namespace graph /* Graph implementation */ {
     }
 
     inline bool DependencyGraph::EraseEdge(const Edge& edge) {
-        const bool success = forward_graph_.EraseEdge(edge);
-        if (success) {
-            backward_graph_.EraseEdge(Edge{edge.to, edge.from});
+        const VertexIndex from = vertices_->Find(edge.from);
+        const VertexIndex to = vertices_->Find(edge.to);
+        if (from == NO_VERTEX || to == NO_VERTEX || !forward_graph_.adjacency_.Remove(from, to)) {
+            return false;
         }
-        return success;
+
+        /// Invalidates all backward entries of `from` and restamps the ones of the remaining edges
+        auto& backward = backward_graph_.adjacency_;
+        const auto neighbors = forward_graph_.adjacency_.GetNeighbors(from);
+        vertices_->AdvanceGeneration(from);
+        backward.DiscountStale(to);
+        std::for_each(neighbors.begin(), neighbors.end(), [&](VertexIndex other) { backward.DiscountStale(other); });
+        std::for_each(neighbors.begin(), neighbors.end(), [&](VertexIndex other) { backward.Add(other, from); });
+        return true;
     }
 
     inline bool DependencyGraph::EraseVertex(const VertexId& vertex_id) {
-        const auto erased_forward_edges_it = forward_graph_.incidence_lists_.find(vertex_id);
-        if (erased_forward_edges_it == forward_graph_.incidence_lists_.end()) {
+        const VertexIndex from = vertices_->Find(vertex_id);
+        if (from == NO_VERTEX || forward_graph_.adjacency_.GetDegree(from) == 0) {
             return false;
         }
 
-        std::for_each(
-            erased_forward_edges_it->second.begin(), erased_forward_edges_it->second.end(), [&backward_graph = backward_graph_](const Edge* edge) {
-                backward_graph.EraseEdge(Edge{edge->to, edge->from});
-            });
-
-        forward_graph_.EraseVertex(vertex_id);
-
+        auto& backward = backward_graph_.adjacency_;
+        vertices_->AdvanceGeneration(from);
+        forward_graph_.adjacency_.RemoveAll(from, [&backward](VertexIndex to) { backward.DiscountStale(to); });
+        backward.CompactIfNeeded();
         return true;
     }
 
@@ -349,11 +1187,15 @@ namespace graph /* Graph implementation */ {
         return forward_graph_.GetIncidentEdges(std::move(vertex));
     }
 
-    inline void DependencyGraph::Traversal(const VertexId& vertex_id, std::function<bool(const Edge*)> action) const {
+    inline IncidentEdgesRange DependencyGraph::GetIncidentEdges(VertexId vertex, Direction direction) const {
+        return direction == Direction::forward ? forward_graph_.GetIncidentEdges(std::move(vertex)) : backward_graph_.GetIncidentEdges(std::move(vertex));
+    }
+
+    inline void DependencyGraph::Traversal(const VertexId& vertex_id, std::function<bool(const Edge&)> action) const {
         Traversal(vertex_id, action, Direction::forward);
     }
 
-    inline void DependencyGraph::Traversal(const VertexId& vertex_id, std::function<bool(const Edge*)> action, Direction direction) const {
+    inline void DependencyGraph::Traversal(const VertexId& vertex_id, std::function<bool(const Edge&)> action, Direction direction) const {
         if (direction == Direction::forward) {
             forward_graph_.Traversal(vertex_id, action);
         } else {
@@ -361,7 +1203,56 @@ namespace graph /* Graph implementation */ {
         }
     }
 
+    template <typename Visit>
+    bool DependencyGraph::Search(const std::vector<VertexId>& starts, Traverser::Order order, Visit visit, Direction direction) const {
+        return direction == Direction::forward ? forward_graph_.Search(starts, order, std::move(visit)) : backward_graph_.Search(starts, order, std::move(visit));
+    }
+
+    template <typename Visit, typename Enter>
+    bool DependencyGraph::Search(const std::vector<VertexId>& starts, Traverser::Order order, Visit visit, Enter enter, Direction direction) const {
+        return direction == Direction::forward ? forward_graph_.Search(starts, order, std::move(visit), std::move(enter))
+                                               : backward_graph_.Search(starts, order, std::move(visit), std::move(enter));
+    }
+
     inline bool DependencyGraph::DetectCircularDependency(const VertexId& from, const std::vector<VertexId>& to_refs) const {
-        return forward_graph_.DetectCircularDependency(from, to_refs);
+        if (std::find(to_refs.begin(), to_refs.end(), from) != to_refs.end()) {
+            return true;
+        }
+
+        /// Nothing can lead back to a cell no formula depends on
+        const VertexIndex target = vertices_->Find(from);
+        if (target == NO_VERTEX || backward_graph_.adjacency_.GetDegree(target) == 0) {
+            return false;
+        }
+        if (!ordered_) {
+            return forward_graph_.DetectCircularDependency(from, to_refs);
+        }
+
+        /// References only lead to cells earlier in the order, so only references after `from` can reach it
+        const std::uint32_t bound = order_[target];
+        std::vector<VertexIndex> starts;
+        for (const VertexId& ref : to_refs) {
+            if (const VertexIndex index = vertices_->Find(ref); index != NO_VERTEX && order_[index] > bound) {
+                starts.push_back(index);
+            }
+        }
+        return !starts.empty() && forward_graph_.traverser_.Run(
+                                      forward_graph_.adjacency_, order_.size(), starts, Traverser::Order::depth_first,
+                                      [target](VertexIndex, VertexIndex vertex) { return vertex == target; },
+                                      [this, bound](VertexIndex vertex) { return order_[vertex] >= bound; });
+    }
+
+    inline std::uint32_t DependencyGraph::GetTopologicalIndex(const VertexId& vertex) const {
+        const VertexIndex index = vertices_->Find(vertex);
+        return index != NO_VERTEX ? order_[index] : std::numeric_limits<std::uint32_t>::max();
+    }
+
+    inline bool DependencyGraph::HasTopologicalOrder() const {
+        return ordered_;
+    }
+
+    inline size_t DependencyGraph::GetMemoryUsage() const {
+        return forward_graph_.GetMemoryUsage() + backward_graph_.GetMemoryUsage() + vertices_->GetMemoryUsage() +
+               order_.capacity() * sizeof(std::uint32_t);
     }
 }
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace parallel {
+
+    /// Number of workers to use for `threads` requested ones, hardware concurrency if 0
+    inline size_t ResolveThreadCount(size_t threads) {
+        return threads != 0 ? threads : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    /// Runs `action(i)` for every i in [0, count) on its own thread, index 0 on the calling thread
+    template <typename Action>
+    void ForEachIndex(size_t count, Action action) {
+        std::vector<std::thread> workers;
+        workers.reserve(count > 0 ? count - 1 : 0);
+        for (size_t i = 1; i < count; ++i) {
+            workers.emplace_back(action, i);
+        }
+        if (count > 0) {
+            action(0);
+        }
+        std::for_each(workers.begin(), workers.end(), [](std::thread& worker) { worker.join(); });
+    }
+
+    /**
+     * @brief Stable sort of [first, last): chunks are sorted concurrently, then merged pairwise in rounds.
+     *
+     * `comp` is called concurrently and must not modify shared state.
+     */
+    template <typename It, typename Compare>
+    void StableSort(It first, It last, Compare comp, size_t threads = 0) {
+        static constexpr size_t MIN_CHUNK = 8192;
+
+        const auto count = static_cast<size_t>(std::distance(first, last));
+        const size_t chunks = std::clamp<size_t>(count / MIN_CHUNK, 1, ResolveThreadCount(threads));
+        if (chunks == 1) {
+            std::stable_sort(first, last, comp);
+            return;
+        }
+
+        const size_t chunk = (count + chunks - 1) / chunks;
+        const auto bound = [&](size_t index) {
+            return std::next(first, static_cast<std::ptrdiff_t>(std::min(count, index * chunk)));
+        };
+
+        ForEachIndex(chunks, [&](size_t i) { std::stable_sort(bound(i), bound(i + 1), comp); });
+        for (size_t width = 1; width < chunks; width *= 2) {
+            ForEachIndex((chunks + 2 * width - 1) / (2 * width), [&](size_t i) {
+                const size_t begin = i * 2 * width;
+                std::inplace_merge(bound(begin), bound(std::min(chunks, begin + width)), bound(std::min(chunks, begin + 2 * width)), comp);
+            });
+        }
+    }
+
+    /**
+     * @brief Workers running the tasks of DAGs with work stealing, started once and reused by every `RunDag()`.
+     *
+     * The thread calling `RunDag()` is one of the workers, the others wait on a condition variable
+     * between runs. Within a run, a worker without tasks sleeps on an atomic counter bumped when
+     * tasks are released for others or when the run ends, so narrow or deep DAGs do not keep idle
+     * cores spinning.
+     */
+    class WorkStealingPool {
+    public:
+        /// `threads` workers, hardware concurrency if 0
+        explicit WorkStealingPool(size_t threads = 0) : deques_(ResolveThreadCount(threads)) {
+            helpers_.reserve(deques_.size() - 1);
+            for (size_t worker = 1; worker < deques_.size(); ++worker) {
+                helpers_.emplace_back([this, worker] { Help_(worker); });
+            }
+        }
+
+        ~WorkStealingPool() {
+            {
+                const std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            std::for_each(helpers_.begin(), helpers_.end(), [](std::thread& helper) { helper.join(); });
+        }
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        [[nodiscard]] size_t GetThreadCount() const {
+            return deques_.size();
+        }
+
+        /**
+         * @brief Runs the tasks of a DAG and returns once all of them ran.
+         *
+         * `pending[i]` holds the number of predecessors of task `i`; `for_each_successor(i, action)` calls
+         * `action(j)` for every task waiting for `i`. A task runs once all its predecessors finished: the
+         * worker that finishes the last one pushes it to its own deque, idle workers steal from the other
+         * end of the deques of others. The first exception thrown by `run` stops the workers and is rethrown.
+         *
+         * Runs must not overlap.
+         */
+        template <typename Run, typename ForEachSuccessor>
+        void RunDag(std::vector<std::atomic<std::uint32_t>>& pending, Run run, ForEachSuccessor for_each_successor) {
+            const size_t workers = deques_.size();
+            for (size_t task = 0, next = 0; task < pending.size(); ++task) {
+                if (pending[task].load(std::memory_order_relaxed) == 0) {
+                    deques_[next++ % workers].tasks.push_back(task);
+                }
+            }
+
+            std::atomic<size_t> remaining = pending.size();
+            std::atomic<bool> failed = false;
+            std::exception_ptr error;
+            std::mutex error_mutex;
+            const auto finish = [this] {
+                signal_.fetch_add(1, std::memory_order_release);
+                signal_.notify_all();
+            };
+
+            const Job job = [&](size_t worker) {
+                size_t task = 0;
+                while (true) {
+                    /// Read before looking for tasks: a push or the end of the run after the look changes it
+                    const std::uint32_t seen = signal_.load(std::memory_order_acquire);
+                    if (remaining.load(std::memory_order_acquire) == 0 || failed.load(std::memory_order_acquire)) {
+                        return;
+                    }
+                    if (!Take_(worker, task)) {
+                        signal_.wait(seen, std::memory_order_acquire);
+                        continue;
+                    }
+                    try {
+                        run(task);
+                    } catch (...) {
+                        const std::lock_guard lock(error_mutex);
+                        error = error != nullptr ? error : std::current_exception();
+                        failed.store(true, std::memory_order_release);
+                        finish();
+                        return;
+                    }
+                    size_t released = 0;
+                    for_each_successor(task, [&](size_t successor) {
+                        if (pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                            const std::lock_guard lock(deques_[worker].mutex);
+                            deques_[worker].tasks.push_back(successor);
+                            ++released;
+                        }
+                    });
+                    /// The worker takes one released task itself, the others are left for sleeping workers
+                    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 || released > 1) {
+                        finish();
+                    }
+                }
+            };
+
+            if (workers > 1) {
+                {
+                    const std::lock_guard lock(mutex_);
+                    job_ = &job;
+                    ++generation_;
+                }
+                wake_.notify_all();
+            }
+            job(0);
+            if (workers > 1) {
+                /// Helpers that did not join the run yet skip it
+                std::unique_lock lock(mutex_);
+                job_ = nullptr;
+                idle_.wait(lock, [this] { return busy_ == 0; });
+            }
+            /// Tasks left by a failed run
+            std::for_each(deques_.begin(), deques_.end(), [](WorkDeque& deque) { deque.tasks.clear(); });
+
+            if (error != nullptr) {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        using Job = std::function<void(size_t)>;
+
+        struct WorkDeque {
+            std::mutex mutex;
+            std::deque<size_t> tasks;
+        };
+
+        bool Take_(size_t worker, size_t& task) {
+            /// Own tasks from the back (most recently released, their inputs are hot), stolen ones from the front
+            for (size_t i = 0; i < deques_.size(); ++i) {
+                WorkDeque& deque = deques_[(worker + i) % deques_.size()];
+                const std::lock_guard lock(deque.mutex);
+                if (!deque.tasks.empty()) {
+                    if (i == 0) {
+                        task = deque.tasks.back();
+                        deque.tasks.pop_back();
+                    } else {
+                        task = deque.tasks.front();
+                        deque.tasks.pop_front();
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Help_(size_t worker) {
+            std::uint64_t seen = 0;
+            std::unique_lock lock(mutex_);
+            while (true) {
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) {
+                    return;
+                }
+                seen = generation_;
+                if (job_ == nullptr) {
+                    continue;
+                }
+                const Job* job = job_;
+                ++busy_;
+                lock.unlock();
+                (*job)(worker);
+                lock.lock();
+                if (--busy_ == 0) {
+                    idle_.notify_all();
+                }
+            }
+        }
+
+    private:
+        /// One deque per worker, the calling thread of `RunDag()` owns the first one
+        std::vector<WorkDeque> deques_;
+        /// Bumped when a worker releases tasks for others and when a run ends; idle workers of a run wait for it to change
+        std::atomic<std::uint32_t> signal_ = 0;
+
+        std::mutex mutex_;
+        /// Signalled when a run starts and when the pool stops
+        std::condition_variable wake_;
+        /// Signalled when the last helper leaves a run
+        std::condition_variable idle_;
+        /// Run in flight, if helpers may still join it
+        const Job* job_ = nullptr;
+        std::uint64_t generation_ = 0;
+        /// Helpers inside the run
+        size_t busy_ = 0;
+        bool stopping_ = false;
+        /// Started last, after the state they read
+        std::vector<std::thread> helpers_;
+    };
+
+    /**
+     * @brief Runs submitted jobs one at a time, in submission order, on its own worker thread.
+     *
+     * Jobs must not throw. Jobs still queued when the executor is destroyed run before the worker stops.
+     */
+    class SerialExecutor {
+    public:
+        SerialExecutor() : worker_([this] { Run_(); }) {}
+
+        ~SerialExecutor() {
+            {
+                const std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            ready_.notify_one();
+            worker_.join();
+        }
+
+        SerialExecutor(const SerialExecutor&) = delete;
+        SerialExecutor& operator=(const SerialExecutor&) = delete;
+
+        void Submit(std::function<void()> job) {
+            {
+                const std::lock_guard lock(mutex_);
+                jobs_.push_back(std::move(job));
+            }
+            ready_.notify_one();
+        }
+
+    private:
+        void Run_() {
+            std::unique_lock lock(mutex_);
+            while (true) {
+                ready_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                if (jobs_.empty()) {
+                    return;
+                }
+                std::function<void()> job = std::move(jobs_.front());
+                jobs_.pop_front();
+                lock.unlock();
+                job();
+                lock.lock();
+            }
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<std::function<void()>> jobs_;
+        bool stopping_ = false;
+        /// Started last, after the queue it reads
+        std::thread worker_;
+    };
+}
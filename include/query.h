@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "common.h"
+
+namespace spreadsheet {
+    class Sheet;
+}
+
+namespace spreadsheet::query /* Row bitmap */ {
+
+    /**
+     * @brief Set of row indices stored as a dense bitmap, one bit per row.
+     *
+     * Bitmaps produced for the same sheet have the same size and can be combined with `&`, `|` and `~`.
+     */
+    class RowBitmap {
+    public:
+        using Word = std::uint64_t;
+        static constexpr size_t WORD_BITS = 64;
+
+        RowBitmap() = default;
+        explicit RowBitmap(size_t size, bool value = false);
+
+        [[nodiscard]] size_t Size() const;
+        [[nodiscard]] size_t Count() const;
+        [[nodiscard]] bool Test(size_t row) const;
+        void Set(size_t row, bool value = true);
+
+        /// Returns the indices of set rows in ascending order
+        [[nodiscard]] std::vector<int> ToRows() const;
+
+        Word* GetWords();
+        [[nodiscard]] const Word* GetWords() const;
+
+        RowBitmap& operator&=(const RowBitmap& other);
+        RowBitmap& operator|=(const RowBitmap& other);
+        RowBitmap operator~() const;
+        bool operator==(const RowBitmap& other) const;
+
+    private:
+        void ClearTail_();
+
+    private:
+        size_t size_ = 0;
+        std::vector<Word> words_;
+    };
+
+    RowBitmap operator&(RowBitmap lhs, const RowBitmap& rhs);
+    RowBitmap operator|(RowBitmap lhs, const RowBitmap& rhs);
+}
+
+namespace spreadsheet::query /* Column data and predicates */ {
+
+    /**
+     * @brief Typed snapshot of one sheet column prepared for scans.
+     *
+     * `numbers` holds the numeric value of every row (formula results and texts that read as
+     * numbers) or NaN; `texts` holds views of text values (null views for other rows) and is valid
+     * until the sheet is modified. Empty cells and errors have neither.
+     */
+    struct ColumnData {
+        std::vector<double> numbers;
+        std::vector<std::string_view> texts;
+    };
+
+    enum class CompareOp { Equal, NotEqual, Less, LessOrEqual, Greater, GreaterOrEqual };
+
+    /// Compares the values of column `col` with `operand`: a number is compared with numeric values,
+    /// a string is compared lexicographically with text values
+    struct Predicate {
+        int col = 0;
+        CompareOp op = CompareOp::Equal;
+        std::variant<double, std::string> operand;
+    };
+
+    /// Helper to spell predicates as `Column{2} > 1000.` or `Column{5} == "OPEN"`
+    struct Column {
+        int index = 0;
+
+        Predicate operator==(double operand) const;
+        Predicate operator!=(double operand) const;
+        Predicate operator<(double operand) const;
+        Predicate operator<=(double operand) const;
+        Predicate operator>(double operand) const;
+        Predicate operator>=(double operand) const;
+        Predicate operator==(std::string operand) const;
+        Predicate operator!=(std::string operand) const;
+    };
+
+    /// Sets bits of rows whose `values` satisfy `op` against `operand` (NaN never matches)
+    void CompareNumbers(const std::vector<double>& values, CompareOp op, double operand, RowBitmap& result);
+}
+
+namespace spreadsheet::query /* Group-by aggregation */ {
+
+    /// Aggregates over the numeric values of a column; `Count` counts numeric values
+    enum class AggregateKind { Sum, Count, Min, Max, Average };
+
+    struct Aggregate {
+        int col = 0;
+        AggregateKind kind = AggregateKind::Sum;
+    };
+
+    /**
+     * @brief Result of a group-by: one row per group in order of the first appearance of its key.
+     *
+     * `keys` and `values` are row-major `GetGroupCount()` x `key_columns` / `value_columns` tables.
+     * A key part is the text or the number of the grouped cell (empty string for empty cells).
+     * An aggregate without numeric values in its group is NaN, except `Sum` and `Count` that are 0.
+     */
+    struct GroupTable {
+        size_t key_columns = 0;
+        size_t value_columns = 0;
+        std::vector<CellInterface::Value> keys = {};
+        std::vector<double> values = {};
+        /// Number of sheet rows in each group
+        std::vector<size_t> rows = {};
+
+        [[nodiscard]] size_t GetGroupCount() const;
+
+        /// Writes the table into the sheet block starting at `position`: key columns then aggregates
+        void WriteTo(Sheet& sheet, Position position) const;
+    };
+
+    /**
+     * @brief Hash aggregation of `values` grouped by `keys` over rows set in `filter` (all rows if null).
+     *
+     * Rows are split into chunks aggregated by `threads` workers (hardware concurrency if 0) into
+     * thread-local tables, merged at the end. Rows whose key columns are all empty are skipped.
+     */
+    GroupTable GroupBy(const std::vector<const ColumnData*>& keys, const std::vector<std::pair<const ColumnData*, AggregateKind>>& values,
+                       const RowBitmap* filter = nullptr, size_t threads = 0);
+}
+
+namespace spreadsheet::query /* Query */ {
+
+    /**
+     * @brief Predicate scans over the columns of a sheet.
+     *
+     * Each referenced column is extracted once into typed `ColumnData` and scanned with vectorized
+     * comparisons; cell values are never copied. The query caches extracted columns, so it must not
+     * outlive modifications of the sheet.
+     *
+     * Example: `auto rows = (query.Select(Column{2} > 1000.) & query.Select(Column{5} == "OPEN")).ToRows();`
+     */
+    class Query {
+    public:
+        explicit Query(const Sheet& sheet);
+
+        /// Returns the bitmap of rows matching the predicate
+        [[nodiscard]] RowBitmap Select(const Predicate& predicate);
+
+        /// Returns the bitmap of rows matching all predicates
+        [[nodiscard]] RowBitmap SelectAll(const std::vector<Predicate>& predicates);
+
+        /// Returns the bitmap of rows matching any of predicates
+        [[nodiscard]] RowBitmap SelectAny(const std::vector<Predicate>& predicates);
+
+        /// Groups rows by `key_cols` and aggregates them, see `query::GroupBy`
+        [[nodiscard]] GroupTable GroupBy(const std::vector<int>& key_cols, const std::vector<Aggregate>& aggregates,
+                                         const RowBitmap* filter = nullptr, size_t threads = 0);
+
+        [[nodiscard]] const ColumnData& GetColumn(int col);
+
+    private:
+        const Sheet& sheet_;
+        std::unordered_map<int, ColumnData> columns_;
+    };
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "cross_links.h"
+#include "graph.h"
+#include "sheet.h"
+
+namespace spreadsheet /* ShardedSheet */ {
+
+    /**
+     * @brief Sheet partitioned into bands of rows that accept writes concurrently.
+     *
+     * Every band is a `Sheet` over its rows (see `Region`) with its own lock: writers of different
+     * bands run in parallel, readers share the locks. Formulas read cells of other bands through the
+     * band that holds them, and such cross-band references are recorded by both bands.
+     *
+     * An edit that adds or removes cross-band references, or that might close a cycle through them,
+     * is coordinated: it takes the topology lock exclusively and checks cycles across all bands before
+     * any band changes. Other edits take the topology lock shared and only the lock of their band.
+     * After an edit, readers of the changed values in other bands are invalidated band by band; a
+     * writer never holds two band locks at once. A read waits for band locks only before it starts,
+     * taking them in ascending band order; a formula reading a band the read has not locked only tries
+     * its lock, and if that fails the read starts again with the band locked up front. So no reader
+     * waits for a lock while it holds one out of order or computes a value others wait for, and
+     * readers and writers do not deadlock whatever the locks prefer.
+     *
+     * All methods may be called concurrently. Values are computed lazily. Array formulas and sorting
+     * are not supported; a batch of `SetCells` is all-or-nothing within each band.
+     */
+    class ShardedSheet {
+    public:
+        static constexpr int DEFAULT_BAND_ROWS = 1024;
+
+        explicit ShardedSheet(int band_rows = DEFAULT_BAND_ROWS);
+        ~ShardedSheet();
+
+        /// @throws as `Sheet::SetCell`
+        void SetCell(Position pos, std::string text);
+        /// @throws as `Sheet::SetCells`
+        void SetCells(std::vector<std::pair<Position, std::string>> cells);
+        void ClearCell(Position pos);
+
+        [[nodiscard]] CellInterface::Value GetValue(Position pos) const;
+        [[nodiscard]] std::string GetText(Position pos) const;
+        [[nodiscard]] Size GetPrintableSize() const;
+        [[nodiscard]] size_t GetShardCount() const;
+
+    private:
+        struct Shard {
+            explicit Shard(Region region) : sheet(std::move(region)) {}
+
+            Sheet sheet;
+            mutable std::shared_mutex mutex;
+        };
+
+        /// Thrown by the reference check of a band through `Sheet` when an edit has to be coordinated
+        struct NeedsCoordination {};
+        /// Thrown through the evaluation of a read when a formula reads a band whose lock is not free, see `ReadOutside_`
+        struct LockConflict {
+            size_t band;
+        };
+
+        /// Shared lock of a band unless the thread holds it already, e.g. while a formula of the band reads another one
+        class ReadLock {
+        public:
+            explicit ReadLock(const Shard& shard);
+            /// Does not wait for the lock, check the result with `IsHeld()`
+            ReadLock(const Shard& shard, std::try_to_lock_t);
+            ~ReadLock();
+            ReadLock(const ReadLock&) = delete;
+            ReadLock& operator=(const ReadLock&) = delete;
+
+            /// Whether the thread holds the lock of the band, by this object or an outer one
+            [[nodiscard]] bool IsHeld() const;
+
+        private:
+            const Shard* shard_ = nullptr;
+            bool held_ = true;
+        };
+
+        size_t GetShardIndex_(const Position& pos) const;
+        Shard& GetShard_(const Position& pos) const;
+        /// Runs `write` on the band with its lock held, false if the write has to be coordinated instead
+        bool WriteBand_(size_t index, const std::function<void(Shard&)>& write);
+        /// Check of a band write, see `Region::check_references`: throws `NeedsCoordination` unless the band can decide alone
+        void CheckReferences_(size_t index, const Position& pos, const std::vector<Position>& refs) const;
+        /// Reads a value with the band locked; a read started by a formula of another band throws `LockConflict` instead of waiting
+        CellInterface::Value ReadOutside_(const Position& pos) const;
+
+        /// Writes the batch with the topology lock held exclusively
+        void SetCellsCoordinated_(std::vector<std::pair<Position, std::string>> cells);
+        bool DetectCircularDependency_(const std::unordered_map<Position, std::vector<Position>, graph::Hasher>& new_refs) const;
+        /// Records the references of the cell at `pos` to other bands
+        void LinkRemote_(const Position& pos, const std::vector<Position>& refs);
+        bool HasRemoteReferences_(const Position& pos) const;
+
+        /// Invalidates `readers` one band at a time with the band locked, and the readers of values this outdates in turn
+        void InvalidateReaders_(CrossLinks::Readers readers);
+
+    private:
+        int band_rows_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        /// References across bands; the data of a band is guarded by its lock, links change with the topology lock held exclusively
+        CrossLinks links_;
+        /// Shared by uncoordinated edits and reads, exclusive for coordinated edits
+        mutable std::shared_mutex topology_;
+        /// Set while a coordinated edit runs, then bands accept any references
+        bool coordinating_ = false;
+    };
+}
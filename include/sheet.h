@@ -1,30 +1,205 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
+#include <optional>
+#include <string>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "cell.h"
+#include "change_feed.h"
 #include "common.h"
 #include "graph.h"
+#include "parallel.h"
+#include "query.h"
+#include "snapshot.h"
 
 namespace spreadsheet /* Sheet definations */ {
 
+    /// Sort key of `Sheet::SortRange`: an absolute column index inside the sorted block
+    struct SortKey {
+        int col = 0;
+        bool ascending = true;
+    };
+
+    /// When formula values are brought up to date after edits
+    enum class RecalculationMode {
+        lazy,    ///< Affected values are dropped on edit and computed when read
+        eager,   ///< Every edit recalculates all affected values before returning
+        manual,  ///< Affected values keep their old results until `Sheet::Recalculate()`
+    };
+
+    /// Cells processed by `Sheet::Recalculate()`
+    struct RecalculationStats {
+        /// Formulas computed again
+        size_t evaluated = 0;
+        /// Outdated values kept because none of their precedents changed
+        size_t revalidated = 0;
+    };
+
+    /// State of the time-sliced recalculation after `Sheet::RunFor()`
+    struct RecalculationProgress {
+        /// Cells processed by the call
+        RecalculationStats stats;
+        /// Cells of the current pass processed by all calls so far
+        size_t done = 0;
+        /// Outdated cells found and not processed yet, counted once per precedent that found them; the pass finds
+        /// the cells depending on them as it goes
+        size_t remaining = 0;
+
+        [[nodiscard]] bool IsComplete() const {
+            return remaining == 0;
+        }
+    };
+
+    /// Outcome of `Sheet::TrySetCell()` and `Sheet::TryClearCell()`
+    enum class EditStatus : std::uint8_t {
+        ok,
+        invalid_position,
+        syntax_error,
+        circular_dependency,
+        array_conflict,  ///< A position of an array formula block other than its anchor
+    };
+
+    /// Status of an edit and, if it was rejected, a static description and the offset in the cell text it refers to
+    struct EditResult {
+        EditStatus status = EditStatus::ok;
+        std::uint32_t offset = 0;
+        std::string_view message;
+
+        [[nodiscard]] bool IsOk() const {
+            return status == EditStatus::ok;
+        }
+    };
+
+    /// Rows or columns of a larger grid held by one sheet, or a sheet of a workbook, see `Sheet(Region)`
+    struct Region {
+        Rect rect;
+        /// Value of a position outside `rect`, read by formulas
+        std::function<CellInterface::Value(Position)> read_outside;
+        /// Value of a cell of another sheet, read by formulas such as `=Sheet2!A1`
+        std::function<CellInterface::Value(std::string_view, Position)> read_sheet;
+        /// Called with the block of new content (1x1 unless an array formula) and its references to cells
+        /// and to other sheets before the sheet changes, may throw to reject it
+        std::function<void(const Rect&, const std::vector<Position>&, const std::vector<SheetReference>&)> check_references;
+        /// Called with the cells whose values an edit or `InvalidateCells` drops, edited ones included. An array anchor stands
+        /// for its block: it is reported with the old content, and once more with the new one when an array formula is set
+        std::function<void(const std::vector<Position>&)> invalidated;
+    };
+
+    /**
+     * @brief Spreadsheet of cells with formulas, their dependency graph and recalculation.
+     *
+     * Reads may run concurrently: any number of threads may call const methods (`GetValue`, `GetCell`,
+     * printing, `ExtractColumn`) at once without a lock. A value computed by one reader is published
+     * atomically with its cell, and readers needing the same value wait for it instead of computing it
+     * again (see `Cell`). Modifications, `Recalculate()` and mode changes must not overlap with any
+     * other call; synchronizing them with readers (e.g. with a shared mutex) is up to the caller.
+     * Readers that must not wait for writers take a `Snapshot()` instead.
+     */
     class Sheet : public SheetInterface {
     private:
         using ColumnItem = std::unordered_map<int, std::unique_ptr<Cell>>;
 
     public:
         Sheet() = default;
+        /**
+         * @brief Sheet holding only the cells of `region.rect`, e.g. one shard of `ShardedSheet`.
+         *
+         * References outside the region and to other sheets are not part of the dependency graph:
+         * formulas read them through `region.read_outside` and `region.read_sheet`, and the owner of
+         * the grid invalidates their readers with `InvalidateCells`, finding them from the cells reported
+         * to `region.invalidated`. Values of such formulas are always computed again once outdated.
+         */
+        explicit Sheet(Region region);
         ~Sheet() = default;
 
     public:
         void SetCell(Position pos, std::string text) override;
 
+        /**
+         * @brief Sets the text of a cell as `SetCell` does, but reports a rejected edit in the result instead of throwing.
+         *
+         * Formulas are checked with `CheckFormula` before they are parsed, so rejecting a bad formula unwinds
+         * nothing; a rejected edit leaves the sheet untouched. Meant for bulk imports with many bad rows.
+         * Checks of the owner of a region (see `Region::check_references`) may still throw.
+         */
+        EditResult TrySetCell(Position pos, std::string text);
+
+        /**
+         * @brief Sets the texts of many cells at once, e.g. when loading or pasting a block.
+         *
+         * All texts are parsed and the new references are checked for cycles in one pass before the
+         * sheet changes, so a failed batch leaves the sheet untouched. Values depending on the batch
+         * are invalidated in one traversal, and the dependency graph is rebuilt in bulk when most of
+         * it changes. A position written several times gets its last text.
+         *
+         * @throws InvalidPositionException if a position is invalid.
+         * @throws FormulaException if a formula is syntactically incorrect.
+         * @throws ArrayFormulaException if a position belongs to an array formula block.
+         * @throws CircularDependencyException if the new references make a cycle.
+         */
+        void SetCells(std::vector<std::pair<Position, std::string>> cells);
+
+        /**
+         * @brief Sets an array formula whose result spills into the `rect` block.
+         *
+         * The formula is stored once, in the top-left (anchor) cell, and evaluated in one pass
+         * into a buffer that backs every cell of the block. Range references such as `A1:A100`
+         * are resolved element-wise. The block is a single dependency-graph vertex: formulas
+         * referencing spilled cells depend on the anchor.
+         *
+         * @throws InvalidPositionException if the block does not fit into the sheet.
+         * @throws FormulaException if the formula is syntactically incorrect.
+         * @throws ArrayFormulaException if the block overlaps other arrays or non-empty cells.
+         * @throws CircularDependencyException if the formula depends on its own block.
+         */
+        void SetArrayFormula(Rect rect, std::string text);
+
+        /**
+         * @brief Reorders the rows of the `rect` block by the values of `keys` columns.
+         *
+         * The permutation is computed with a stable parallel sort on `threads` workers (hardware
+         * concurrency if 0): numbers go before texts, empty cells and errors always go last. Cell
+         * objects are moved without re-parsing. Single-cell references to moved cells follow them,
+         * so formula values do not change; range references are positional and are recalculated.
+         * The dependency graph is patched once for the affected cells.
+         *
+         * @throws InvalidPositionException if the block is invalid or a key column is outside it.
+         * @throws ArrayFormulaException if the block intersects an array formula.
+         */
+        void SortRange(Rect rect, const std::vector<SortKey>& keys, size_t threads = 0);
+
         const Cell* GetCell(Position pos) const override;
         Cell* GetCell(Position pos) override;
+        CellInterface::Value GetValue(Position pos) const override;
+        /// Texts of positions outside the region (see `Region`) are copied and valid until the next such read on the thread
+        CellInterface::ValueRef GetValueRef(Position pos) const override;
+        CellInterface::Value GetSheetValue(std::string_view sheet, Position pos) const override;
+
+        /**
+         * @brief Returns the values of `viewport` as a row-major buffer, as `GetValue` returns them.
+         *
+         * Only the cells of the viewport and the precedents they read are evaluated; outdated cells
+         * elsewhere are left to `Recalculate()` or `RunFor()`, which skip the values computed here.
+         * Rows and arrays are looked up once per call, not once per position.
+         *
+         * @throws InvalidPositionException if the viewport is not a valid block.
+         */
+        std::vector<CellInterface::Value> GetValues(Rect viewport) const;
+        /// Anchor of the array formula spilled over `pos`, `pos` itself if there is none
+        Position GetArrayAnchor(Position pos) const;
 
         void ClearCell(Position pos) override;
+        /// Clears a cell as `ClearCell` does, reporting a rejected edit in the result instead of throwing
+        EditResult TryClearCell(Position pos);
 
         Size GetPrintableSize() const override;
 
@@ -33,18 +208,169 @@ namespace spreadsheet /* Sheet definations */ {
 
         const graph::DependencyGraph& GetGraph() const;
 
+        /// Drops the values of `cells` and of their dependents, e.g. after values they read outside the region changed
+        void InvalidateCells(const std::vector<Position>& cells);
+
+        /**
+         * @brief Takes an immutable view of the current contents and values in O(1).
+         *
+         * Every edit publishes the texts it changed as a new version of a multi-version store; a
+         * snapshot pins the latest version and reads it without locks. Unlike other methods, this one
+         * and all reads of snapshots may run concurrently with modifications on another thread.
+         */
+        SheetSnapshot Snapshot() const;
+        const VersionedCells& GetVersions() const;
+
+        /**
+         * @brief Brings all values affected by edits since the last call up to date.
+         *
+         * Affected cells are evaluated iteratively in the topological order of the dependency graph,
+         * each exactly once, so the depth of dependency chains is not limited by the call stack.
+         * Reading a value that is not computed yet evaluates it with an explicit stack as well, but
+         * only the precedents the evaluation actually reads (untaken IF branches are skipped).
+         *
+         * Large recalculations run on a work-stealing pool: every cell waits on an atomic counter of
+         * its pending precedents and runs once it drops to zero. Each cell is still computed once
+         * from final values of its precedents, so results do not depend on the thread count.
+         *
+         * Recalculation stops where values do not change: a cell whose precedents all kept their
+         * values (e.g. a saturated MIN/MAX, or rounding) keeps its old value instead of being computed.
+         */
+        RecalculationStats Recalculate();
+
+        /**
+         * @brief Recalculates like `Recalculate()`, but returns once `budget` is spent.
+         *
+         * A call without a pass in flight starts one from the edited cells. The pass takes affected
+         * cells in topological order and finds their dependents as it goes, so no call pays for
+         * planning the whole pass; every call goes on where the previous one stopped and processes
+         * at least one cell. Between calls the sheet is consistent: processed cells hold their new
+         * values, the others are outdated (or keep old values in manual mode) and a read in lazy
+         * mode computes them on demand.
+         *
+         * An edit supersedes the pass in flight: the cells it found and did not process start the
+         * next pass, together with the edited cells. Runs on the calling thread only.
+         */
+        RecalculationProgress RunFor(std::chrono::microseconds budget);
+        /// Workers used by `Recalculate()`, hardware concurrency if 0. They are started here, or by the first recalculation
+        /// large enough to use them, and wait between recalculations.
+        void SetRecalculationThreads(size_t threads);
+        size_t GetRecalculationThreads() const;
+
+        /// Switching to eager or away from manual mode recalculates pending edits
+        void SetRecalculationMode(RecalculationMode mode);
+        RecalculationMode GetRecalculationMode() const;
+
+        /**
+         * @brief Subscribes `callback` to the values of the `range` block.
+         *
+         * The positions whose values the invalidation of an edit drops, and the positions the edit
+         * rewrites, are compared with their old values once a recalculation completes (`Recalculate()`,
+         * every edit in eager mode, the last call of a `RunFor()` pass). Changed ones are queued for the
+         * subscriptions watching them and delivered by `DeliverChanges()`, at most one batch per `window`.
+         * The current values of the range are computed here, changes are reported relative to them.
+         *
+         * @throws InvalidPositionException if the range is not a valid block.
+         */
+        SubscriptionId Subscribe(Rect range, ChangeCallback callback, ChangeFeed::Clock::duration window = {});
+        /// Changes queued and not delivered yet are dropped
+        void Unsubscribe(SubscriptionId id);
+        /**
+         * @brief Calls back the subscriptions with changes queued and their window passed at `now`, see
+         * `ChangeFeed::Deliver()`. Returns the number of batches delivered.
+         *
+         * Unlike other methods, this one may run concurrently with modifications on another thread; one
+         * thread at a time delivers, and callbacks run on it.
+         */
+        size_t DeliverChanges(ChangeFeed::Clock::time_point now = ChangeFeed::Clock::now()) const;
+
+        /**
+         * @brief Extracts the values of column `col` into typed arrays of `GetPrintableSize().rows` rows.
+         *
+         * Formulas are evaluated, text values are referenced, not copied. Used by `query::Query`.
+         *
+         * @throws InvalidPositionException if the column is out of the sheet bounds.
+         */
+        query::ColumnData ExtractColumn(int col) const;
+
     private:
         template <typename TPosition, std::enable_if_t<std::is_same_v<std::decay_t<TPosition>, Position>, bool> = true>
         const Cell* GetConstCell_(TPosition&& pos) const;
         void ValidatePosition_(const Position& pos) const;
         void CalculateSize_(Position&& erased_pos);
-        void Print_(std::ostream& output, std::function<void(const CellInterface*)> print) const;
+        void Print_(std::ostream& output, std::function<void(const Position&)> print) const;
+        EditResult SetCell_(Position pos, std::string text);
+        /// Marks the edited cell dirty and drops the values of its dependents unless recalculation is manual
         void InvalidateCache_(const Position& pos);
+        void InvalidateCache_(const std::vector<Position>& cells);
+        void RecalculateIfEager_();
+        /// Returns the cells the pass of `RunFor()` in flight has found and not processed to the dirty set
+        void SupersedePass_();
+        /// Evaluates the cell with an explicit stack: a read of a missing value suspends the reader
+        void EvaluateLazily_(const Position& pos) const;
+        /// Keeps the outdated value of the cell if no precedent changed since it was verified
+        bool Revalidate_(const Position& pos, const Cell& cell) const;
+        /// Evaluates the cells without values among `cells` in topological order
+        RecalculationStats EvaluateInOrder_(std::vector<Position> cells) const;
+        /// Evaluates the cells without values among `cells` on the workers of `pool` as their precedents get ready
+        RecalculationStats EvaluateInParallel_(const std::vector<Position>& cells, parallel::WorkStealingPool& pool) const;
+
+        using ArrayIterator = std::unordered_map<Position, Rect, graph::Hasher>::const_iterator;
+        ArrayIterator FindArray_(const Position& pos) const;
+        /// Adds the block to `arrays_` (replacing the block of the same anchor) and to `array_rows_`
+        void AddArray_(const Position& anchor, const Rect& rect);
+        void EraseArray_(ArrayIterator array_it);
+        std::vector<Position> ResolveReferences_(std::vector<Position> refs, const Position& ignored_anchor) const;
+        void LinkCell_(const Position& pos, std::vector<Position> refs);
+        void RelinkDependents_(const Position& pos);
+        std::vector<Position> GetCellsInRect_(const Rect& rect) const;
+        /// Whether the graph with `new_refs` instead of the references of their cells has a cycle
+        bool DetectCircularDependency_(const std::unordered_map<Position, std::vector<Position>, graph::Hasher>& new_refs) const;
+        void RebuildGraph_();
+        std::vector<int> SortRows_(int first_row, int row_count, const std::vector<SortKey>& keys, size_t threads) const;
+        /// Writes the current content of the position to the versioned store, visible after `Commit()`, and tracks it
+        void Publish_(const Position& pos);
+        void Publish_(const Rect& rect);
+        /// Remembers the value of the cell (of every watched position of an array) before it changes, see `Subscribe()`
+        void Track_(const Position& pos);
+        /// Queues the tracked positions whose values differ from the remembered ones for their subscriptions
+        void NotifyChanges_();
 
     private:
         std::unordered_map<int, ColumnItem> sheet_;
+        /// Array formula blocks by anchor position
+        std::unordered_map<Position, Rect, graph::Hasher> arrays_;
+        /// Blocks of `arrays_` crossing each row, by first column, pointing to their anchors
+        std::unordered_map<int, std::map<int, Position>> array_rows_;
         Size size_ = {0, 0};
         graph::DependencyGraph graph_;
+        RecalculationMode mode_ = RecalculationMode::lazy;
+        size_t recalculation_threads_ = 0;
+        /// Workers for `recalculation_threads_`, started once they are needed
+        std::unique_ptr<parallel::WorkStealingPool> pool_;
+        /// Cells edited since the last recalculation
+        std::unordered_set<Position, graph::Hasher> dirty_;
+        /// Pass of `RunFor()` in flight: a min-heap of the outdated cells found and not processed yet by topological
+        /// index, the last cell taken from it and the number of cells processed
+        std::vector<std::pair<std::uint32_t, Position>> pass_;
+        Position pass_last_ = Position::NONE;
+        size_t pass_done_ = 0;
+        /// Contents by version for snapshots, shared with the snapshots that may outlive the sheet
+        std::shared_ptr<VersionedCells> versions_ = std::make_shared<VersionedCells>();
+        std::optional<Region> region_;
+        /// Watched blocks by subscription, the values they had before the edits since the last recalculation (none if the
+        /// value was not computed) and the queue to the subscribers
+        std::vector<std::pair<SubscriptionId, Rect>> watches_;
+        std::unordered_map<Position, std::optional<CellInterface::Value>, graph::Hasher> changed_;
+        std::unique_ptr<ChangeFeed> feed_ = std::make_unique<ChangeFeed>();
+        SubscriptionId next_subscription_ = 1;
+
+        /// Thrown through a formula evaluation that reads a formula without value, see `EvaluateLazily_`
+        struct PendingValue {
+            Position pos;
+        };
+        /// Sheet whose cell the current thread evaluates lazily; readers on other threads evaluate independently
+        static thread_local const Sheet* evaluating_;
     };
 }
 
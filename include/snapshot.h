@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "formula.h"
+#include "graph.h"
+
+namespace spreadsheet /* Versioned cell storage */ {
+
+    /// Content of a position from `version` on, until a newer entry supersedes it
+    struct CellVersion {
+        std::uint64_t version = 0;
+        /// Text buffer of the cell, see `Cell::GetSharedText()`; nullptr for spilled and cleared positions
+        std::shared_ptr<const std::string> text;
+        /// Block of the array formula covering the position, empty size if none
+        Rect array;
+        /// Previous content, dropped once no snapshot can see it
+        CellVersion* older = nullptr;
+
+        /// Text as returned by `Cell::GetText()`, empty for spilled and cleared positions
+        [[nodiscard]] std::string_view GetText() const;
+        [[nodiscard]] bool IsFormula() const;
+        [[nodiscard]] bool IsArray() const;
+        /// Formula of a formula cell or an array anchor, parsed on the first request from any thread
+        [[nodiscard]] const FormulaInterface& GetFormula() const;
+
+    private:
+        mutable std::once_flag parsed_;
+        mutable std::unique_ptr<FormulaInterface> formula_;
+    };
+
+    /**
+     * @brief Multi-version cell contents with lock-free reads at any retained version.
+     *
+     * Every position has a chain of versions, newest first, reached through a three-level table of
+     * atomic pointers (rows, 64-column chunks of a row, cells of a chunk) that only grows, so readers
+     * never lock and never see a table being resized. A single writer prepends entries stamped with the
+     * next version and then publishes that version with one release store: all contents written by
+     * one edit become visible at once.
+     *
+     * Superseded entries are reclaimed by the writer once no registered reader version can see them.
+     * Readers register the version they read (an epoch) under a mutex taken only when a snapshot is
+     * created or destroyed; entries superseded at version `s` are freed when every registered version
+     * is at least `s`. A reader at such a version stops at the superseding entry and never follows the
+     * freed link.
+     */
+    class VersionedCells {
+    public:
+        VersionedCells();
+        ~VersionedCells();
+        VersionedCells(const VersionedCells&) = delete;
+        VersionedCells& operator=(const VersionedCells&) = delete;
+
+        /// Writer: stages the content of `pos` for the next version, sharing the text buffer of the cell
+        void Write(Position pos, std::shared_ptr<const std::string> text, Rect array);
+        /// Writer: publishes staged contents as a new version and reclaims entries no reader can see
+        void Commit();
+
+        /// Content of `pos` at `version`, nullptr if the position never had one
+        [[nodiscard]] const CellVersion* Find(Position pos, std::uint64_t version) const;
+        [[nodiscard]] std::uint64_t GetVersion() const;
+
+        /// Registers a reader at the current version and returns it, see the class description
+        std::uint64_t Acquire();
+        void Release(std::uint64_t version);
+
+        /// Superseded entries not reclaimed yet
+        [[nodiscard]] size_t GetRetainedCount() const;
+
+    private:
+        static constexpr int CHUNK_COLS = 64;
+        using Chunk = std::array<std::atomic<CellVersion*>, CHUNK_COLS>;
+        using Row = std::array<std::atomic<Chunk*>, Position::MAX_COLS / CHUNK_COLS>;
+
+        std::atomic<CellVersion*>& GetSlot_(Position pos);
+        void Collect_();
+
+    private:
+        std::unique_ptr<std::atomic<Row*>[]> rows_;
+        std::atomic<std::uint64_t> version_ = 0;
+
+        /// Superseded entries by the version that superseded them, ascending
+        struct Retired {
+            std::uint64_t superseded_at;
+            CellVersion* newer;
+        };
+        std::deque<Retired> retired_;
+
+        mutable std::mutex readers_mutex_;
+        std::multiset<std::uint64_t> readers_;
+    };
+}
+
+namespace spreadsheet /* SheetSnapshot */ {
+
+    /**
+     * @brief Immutable view of the contents and values of a sheet at one point in time.
+     *
+     * Created in O(1) by `Sheet::Snapshot()`. Reading it never waits for the sheet: edits and
+     * recalculations made meanwhile are invisible to it. Values are computed from the contents of the
+     * snapshot on demand, with an explicit stack as in the sheet, and cached in the snapshot. A
+     * snapshot is meant for one reader thread; other threads take their own, which costs the same.
+     * It keeps the versions it reads alive and may outlive the sheet.
+     */
+    class SheetSnapshot {
+    public:
+        explicit SheetSnapshot(std::shared_ptr<VersionedCells> cells);
+        ~SheetSnapshot();
+        SheetSnapshot(SheetSnapshot&& other) noexcept;
+        SheetSnapshot& operator=(SheetSnapshot&& other) noexcept;
+
+        [[nodiscard]] CellInterface::Value GetValue(Position pos) const;
+        /// View of the value without copying its text, valid as long as the snapshot
+        [[nodiscard]] CellInterface::ValueRef GetValueRef(Position pos) const;
+        /// Text of the cell as `Cell::GetText()` returned it, empty for spilled and empty positions
+        [[nodiscard]] std::string GetText(Position pos) const;
+        [[nodiscard]] std::uint64_t GetVersion() const;
+
+    private:
+        /// Formulas read referenced values through the sheet interface, this one reads the snapshot
+        class View : public SheetInterface {
+        public:
+            explicit View(const SheetSnapshot& snapshot);
+            CellInterface::Value GetValue(Position pos) const override;
+            CellInterface::ValueRef GetValueRef(Position pos) const override;
+            const CellInterface* GetCell(Position pos) const override;
+            CellInterface* GetCell(Position pos) override;
+            void SetCell(Position pos, std::string text) override;
+            void ClearCell(Position pos) override;
+            Size GetPrintableSize() const override;
+            void PrintValues(std::ostream& output) const override;
+            void PrintTexts(std::ostream& output) const override;
+
+        private:
+            const SheetSnapshot& snapshot_;
+        };
+
+        struct PendingValue {
+            Position pos;
+        };
+
+        /// Computes the formula or array at `pos` and everything it waits for
+        void Evaluate_(const Position& pos) const;
+        void Compute_(const Position& pos, const CellVersion& content) const;
+        bool IsComputed_(const Position& pos, const CellVersion& content) const;
+
+    private:
+        std::shared_ptr<VersionedCells> cells_;
+        std::uint64_t version_ = 0;
+        std::unique_ptr<View> view_;
+        mutable std::unordered_map<Position, CellInterface::Value, graph::Hasher> values_;
+        mutable std::unordered_map<Position, std::vector<FormulaInterface::Value>, graph::Hasher> arrays_;
+        mutable bool evaluating_ = false;
+    };
+}
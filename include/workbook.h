@@ -0,0 +1,107 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "cross_links.h"
+#include "parallel.h"
+#include "sheet.h"
+
+namespace spreadsheet /* Workbook */ {
+
+    /**
+     * @brief Named sheets whose formulas reference each other, such as `=Sheet2!A1*2` or `{='Q1 data'!A1:A3*2}`.
+     *
+     * Every sheet keeps its own dependency graph (see `Region`). References to other sheets are recorded
+     * by both sheets, keyed by cell: cycles through them are rejected when a formula is set, and readers
+     * of changed values in other sheets are invalidated after every edit. A formula referencing a sheet
+     * the workbook does not have is rejected.
+     *
+     * Sheets reading each other form a directed graph; `Recalculate()` runs its strongly connected
+     * components as tasks of a DAG, so sheets that do not depend on each other are recalculated in
+     * parallel, and sheets of one cycle one after another.
+     *
+     * Values are computed lazily. Like `Sheet`, const methods may run concurrently with each other,
+     * modifications must not overlap with any other call. Snapshots of single sheets read references
+     * to other sheets as reference errors.
+     */
+    class Workbook {
+    public:
+        Workbook();
+        ~Workbook();
+        Workbook(const Workbook&) = delete;
+        Workbook& operator=(const Workbook&) = delete;
+
+        /// @throws std::invalid_argument if the name is empty, contains `'` or `!`, or is taken
+        const Sheet& AddSheet(std::string name);
+        /// @throws UnknownSheetException
+        [[nodiscard]] const Sheet& GetSheet(std::string_view name) const;
+        /// Names in the order the sheets were added
+        [[nodiscard]] std::vector<std::string> GetSheetNames() const;
+        [[nodiscard]] size_t GetSheetCount() const;
+
+        /// @throws UnknownSheetException, as `Sheet::SetCell`, FormulaException if a formula references an unknown sheet
+        void SetCell(std::string_view sheet, Position pos, std::string text);
+        /// @throws as `SetCell` and `Sheet::SetCells`
+        void SetCells(std::string_view sheet, std::vector<std::pair<Position, std::string>> cells);
+        /// @throws as `SetCell` and `Sheet::SetArrayFormula`
+        void SetArrayFormula(std::string_view sheet, Rect rect, std::string text);
+        /// @throws UnknownSheetException
+        void ClearCell(std::string_view sheet, Position pos);
+
+        /// @throws UnknownSheetException
+        [[nodiscard]] CellInterface::Value GetValue(std::string_view sheet, Position pos) const;
+
+        /**
+         * @brief Computes the values outdated by edits in all sheets on `threads` workers (hardware concurrency if 0), which
+         * are kept for the next calls with the same count.
+         *
+         * `threads` bounds all threads of the recalculation: every sheet is recalculated on the worker running its
+         * component, however many cells it has, so only independent sheets are recalculated in parallel.
+         */
+        RecalculationStats Recalculate(size_t threads = 0);
+
+    private:
+        struct Page {
+            Page(std::string name, Region region) : name(std::move(name)), sheet(std::move(region)) {}
+
+            std::string name;
+            Sheet sheet;
+        };
+
+        size_t GetIndex_(std::string_view name) const;
+        /// Cells of `reference`, or FormulaException if its sheet is unknown
+        std::vector<RegionCell> Expand_(const SheetReference& reference) const;
+        CellInterface::Value ReadSheet_(std::string_view name, const Position& pos) const;
+
+        /// Check of a write, see `Region::check_references`: throws if the new references close a cycle across sheets
+        void CheckReferences_(size_t index, const Rect& cells, const std::vector<Position>& refs, const std::vector<SheetReference>& sheet_refs) const;
+        bool Reaches_(std::vector<RegionCell> starts, size_t index, const Rect& cells) const;
+
+        /// Records the references of the cell at `pos` to other sheets, as it is after an edit
+        void Relink_(size_t index, const Position& pos);
+        /// Reports the cells of the sheet whose values were dropped, see `Region::invalidated`
+        void Invalidated_(size_t index, const std::vector<Position>& positions);
+        /// Invalidates `readers` one sheet at a time, and the readers of values this outdates in turn
+        void InvalidateReaders_(CrossLinks::Readers readers);
+        /// Relinks `positions` of the edited sheet and invalidates the readers of what the edit outdated
+        void Propagate_(size_t index, const std::vector<Position>& positions);
+
+        /// Strongly connected components of the sheet graph, every one after the components it reads
+        std::vector<std::vector<size_t>> GetComponents_() const;
+
+    private:
+        std::vector<std::unique_ptr<Page>> pages_;
+        std::map<std::string, size_t, std::less<>> indices_;
+        /// References to other sheets, their counts by sheet are the edges of the sheet graph
+        CrossLinks links_;
+        /// Workers of the last `Recalculate()`
+        std::unique_ptr<parallel::WorkStealingPool> pool_;
+    };
+}
@@ -1,11 +1,19 @@
 #include "FormulaAST.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <cmath>
+#include <cstdlib>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "FormulaBaseListener.h"
 #include "FormulaLexer.h"
@@ -16,6 +24,7 @@ namespace ASTImpl {
 
     // Перечисление для обозначения операций
     enum ExpressionPrecedence {
+        EP_CMP,
         EP_ADD,
         EP_SUB,
         EP_MUL,
@@ -63,24 +72,29 @@ namespace ASTImpl {
      *   - Currently in the table, parentheses are always inserted.
      * - `+(A * B)` - Always okay. The resulting binary operation has the highest grammatical precedence.
      * - `+(A / B)` - Always okay. The resulting binary operation has the highest grammatical precedence.
+     * - `(A < B) < C` - Always okay, comparisons are left-associative. `A < (B < C)` - Never okay.
+     * - `A + (B < C)` and any other arithmetic over a comparison - Never okay. Comparisons have the lowest precedence.
      *
      * @note The `PRECEDENCE_RULES` table is a 2D array where `PRECEDENCE_RULES[parent][child]` gives the rule for
      *       whether to insert parentheses between a parent and a child of specific precedences.
      */
     constexpr std::array<std::array<PrecedenceRule, EP_END>, EP_END> PRECEDENCE_RULES = {
-        {/* EP_ADD */ {PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
-         /* EP_SUB */ {PR_RIGHT, PR_RIGHT, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
-         /* EP_MUL */ {PR_BOTH, PR_BOTH, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
-         /* EP_DIV */ {PR_BOTH, PR_BOTH, PR_RIGHT, PR_RIGHT, PR_NONE, PR_NONE},
-         /* EP_UNARY */ {PR_BOTH, PR_BOTH, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
-         /* EP_ATOM */ {PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE}}};
+        {/* EP_CMP */ {PR_RIGHT, PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
+         /* EP_ADD */ {PR_BOTH, PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
+         /* EP_SUB */ {PR_BOTH, PR_RIGHT, PR_RIGHT, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
+         /* EP_MUL */ {PR_BOTH, PR_BOTH, PR_BOTH, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
+         /* EP_DIV */ {PR_BOTH, PR_BOTH, PR_BOTH, PR_RIGHT, PR_RIGHT, PR_NONE, PR_NONE},
+         /* EP_UNARY */ {PR_BOTH, PR_BOTH, PR_BOTH, PR_NONE, PR_NONE, PR_NONE, PR_NONE},
+         /* EP_ATOM */ {PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE, PR_NONE}}};
 
     class Expr {
     public:
         virtual ~Expr() = default;
         virtual void Print(std::ostream& out) const = 0;
         virtual void DoPrintFormula(std::ostream& out, ExpressionPrecedence precedence) const = 0;
-        [[nodiscard]] virtual double Evaluate(LookupValue lookup_value) const = 0;
+        [[nodiscard]] virtual double Evaluate(const EvaluationContext& context) const = 0;
+        // Appends the cells every evaluation reads, unless it fails before reading them
+        virtual void CollectUnconditionalCells(std::vector<Position>& /* cells */) const {}
 
         // higher is tighter
         [[nodiscard]] virtual ExpressionPrecedence GetPrecedence() const = 0;
@@ -151,24 +165,24 @@ namespace ASTImpl /* Expr derivatives implementation */ {
 
             // Метод Evaluate() для бинарных операций.
             // При делении на 0 выбрасывает ошибку вычисления FormulaError
-            [[nodiscard]] double Evaluate(LookupValue lookup_value) const override {
+            [[nodiscard]] double Evaluate(const EvaluationContext& context) const override {
                 double res;
 
                 switch (type_) {
                 case Type::Add: {
-                    res = lhs_->Evaluate(lookup_value) + rhs_->Evaluate(lookup_value);
+                    res = lhs_->Evaluate(context) + rhs_->Evaluate(context);
                     break;
                 }
                 case Type::Subtract: {
-                    res = lhs_->Evaluate(lookup_value) - rhs_->Evaluate(lookup_value);
+                    res = lhs_->Evaluate(context) - rhs_->Evaluate(context);
                     break;
                 }
                 case Type::Multiply: {
-                    res = lhs_->Evaluate(lookup_value) * rhs_->Evaluate(lookup_value);
+                    res = lhs_->Evaluate(context) * rhs_->Evaluate(context);
                     break;
                 }
                 case Type::Divide: {
-                    res = lhs_->Evaluate(lookup_value) / rhs_->Evaluate(lookup_value);
+                    res = lhs_->Evaluate(context) / rhs_->Evaluate(context);
                     break;
                 }
                 default:
@@ -180,6 +194,11 @@ namespace ASTImpl /* Expr derivatives implementation */ {
                 return res;
             }
 
+            void CollectUnconditionalCells(std::vector<Position>& cells) const override {
+                lhs_->CollectUnconditionalCells(cells);
+                rhs_->CollectUnconditionalCells(cells);
+            }
+
         private:
             Type type_;
             std::unique_ptr<Expr> lhs_;
@@ -187,6 +206,232 @@ namespace ASTImpl /* Expr derivatives implementation */ {
         };
     }
 
+    namespace /* ComparisonExpr implementation */ {
+        class ComparisonExpr final : public Expr {
+        public:
+            enum class Type {
+                Equal,
+                NotEqual,
+                Less,
+                LessOrEqual,
+                Greater,
+                GreaterOrEqual,
+            };
+
+        public:
+            explicit ComparisonExpr(Type type, std::unique_ptr<Expr> lhs, std::unique_ptr<Expr> rhs)
+                : type_(type), lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+            void Print(std::ostream& out) const override {
+                out << '(' << GetSign() << ' ';
+                lhs_->Print(out);
+                out << ' ';
+                rhs_->Print(out);
+                out << ')';
+            }
+
+            void DoPrintFormula(std::ostream& out, ExpressionPrecedence precedence) const override {
+                lhs_->PrintFormula(out, precedence);
+                out << GetSign();
+                rhs_->PrintFormula(out, precedence, /* right_child = */ true);
+            }
+
+            [[nodiscard]] ExpressionPrecedence GetPrecedence() const override {
+                return EP_CMP;
+            }
+
+            // Метод Evaluate() для операций сравнения.
+            // Возвращает 1 если условие выполнено и 0 в противном случае
+            [[nodiscard]] double Evaluate(const EvaluationContext& context) const override {
+                const double lhs = lhs_->Evaluate(context);
+                const double rhs = rhs_->Evaluate(context);
+
+                switch (type_) {
+                case Type::Equal:
+                    return lhs == rhs;
+                case Type::NotEqual:
+                    return lhs != rhs;
+                case Type::Less:
+                    return lhs < rhs;
+                case Type::LessOrEqual:
+                    return lhs <= rhs;
+                case Type::Greater:
+                    return lhs > rhs;
+                case Type::GreaterOrEqual:
+                    return lhs >= rhs;
+                default:
+                    assert(false);
+                    return 0.;
+                }
+            }
+
+        private:
+            [[nodiscard]] std::string_view GetSign() const {
+                switch (type_) {
+                case Type::Equal:
+                    return "=";
+                case Type::NotEqual:
+                    return "<>";
+                case Type::Less:
+                    return "<";
+                case Type::LessOrEqual:
+                    return "<=";
+                case Type::Greater:
+                    return ">";
+                case Type::GreaterOrEqual:
+                    return ">=";
+                default:
+                    assert(false);
+                    return "";
+                }
+            }
+
+            void CollectUnconditionalCells(std::vector<Position>& cells) const override {
+                lhs_->CollectUnconditionalCells(cells);
+                rhs_->CollectUnconditionalCells(cells);
+            }
+
+        private:
+            Type type_;
+            std::unique_ptr<Expr> lhs_;
+            std::unique_ptr<Expr> rhs_;
+        };
+    }
+
+    namespace /* FunctionExpr implementation */ {
+        class FunctionExpr final : public Expr {
+        public:
+            enum class Type {
+                If,
+                And,
+                Or,
+                Not,
+                Min,
+                Max,
+            };
+
+        public:
+            FunctionExpr(Type type, std::vector<std::unique_ptr<Expr>> args) : type_(type), args_(std::move(args)) {}
+
+            /// Returns the function with the given name and a suitable number of arguments, if any
+            static std::optional<Type> Find(std::string_view name, size_t args_count) {
+                if (name == "IF" && (args_count == 2 || args_count == 3)) {
+                    return Type::If;
+                }
+                if (name == "AND" && args_count > 0) {
+                    return Type::And;
+                }
+                if (name == "OR" && args_count > 0) {
+                    return Type::Or;
+                }
+                if (name == "NOT" && args_count == 1) {
+                    return Type::Not;
+                }
+                if (name == "MIN" && args_count > 0) {
+                    return Type::Min;
+                }
+                if (name == "MAX" && args_count > 0) {
+                    return Type::Max;
+                }
+                return std::nullopt;
+            }
+
+            void Print(std::ostream& out) const override {
+                out << '(' << GetName();
+                for (const auto& arg : args_) {
+                    out << ' ';
+                    arg->Print(out);
+                }
+                out << ')';
+            }
+
+            void DoPrintFormula(std::ostream& out, ExpressionPrecedence /* precedence */) const override {
+                out << GetName() << '(';
+                bool first = true;
+                for (const auto& arg : args_) {
+                    if (!first) {
+                        out << ',';
+                    }
+                    first = false;
+                    arg->PrintFormula(out, EP_ATOM);
+                }
+                out << ')';
+            }
+
+            [[nodiscard]] ExpressionPrecedence GetPrecedence() const override {
+                return EP_ATOM;
+            }
+
+            // Conditional functions are evaluated lazily: an untaken IF branch and the AND/OR
+            // arguments after the deciding one are never evaluated, so the cells they reference
+            // are neither computed nor able to raise errors.
+            [[nodiscard]] double Evaluate(const EvaluationContext& context) const override {
+                switch (type_) {
+                case Type::If: {
+                    if (args_[0]->Evaluate(context) != 0.) {
+                        return args_[1]->Evaluate(context);
+                    }
+                    return args_.size() > 2 ? args_[2]->Evaluate(context) : 0.;
+                }
+                case Type::And:
+                    return std::all_of(args_.begin(), args_.end(), [&context](const auto& arg) {
+                        return arg->Evaluate(context) != 0.;
+                    });
+                case Type::Or:
+                    return std::any_of(args_.begin(), args_.end(), [&context](const auto& arg) {
+                        return arg->Evaluate(context) != 0.;
+                    });
+                case Type::Not:
+                    return args_[0]->Evaluate(context) == 0.;
+                case Type::Min:
+                case Type::Max: {
+                    double result = args_[0]->Evaluate(context);
+                    for (auto arg = std::next(args_.begin()); arg != args_.end(); ++arg) {
+                        const double value = (*arg)->Evaluate(context);
+                        result = type_ == Type::Min ? std::min(result, value) : std::max(result, value);
+                    }
+                    return result;
+                }
+                default:
+                    assert(false);
+                    return 0.;
+                }
+            }
+
+            // Only the condition of IF and the first argument of AND/OR are read whatever the values are
+            void CollectUnconditionalCells(std::vector<Position>& cells) const override {
+                const bool conditional = type_ == Type::If || type_ == Type::And || type_ == Type::Or;
+                const auto args_end = conditional ? std::next(args_.begin()) : args_.end();
+                std::for_each(args_.begin(), args_end, [&cells](const auto& arg) { arg->CollectUnconditionalCells(cells); });
+            }
+
+        private:
+            [[nodiscard]] std::string_view GetName() const {
+                switch (type_) {
+                case Type::If:
+                    return "IF";
+                case Type::And:
+                    return "AND";
+                case Type::Or:
+                    return "OR";
+                case Type::Not:
+                    return "NOT";
+                case Type::Min:
+                    return "MIN";
+                case Type::Max:
+                    return "MAX";
+                default:
+                    assert(false);
+                    return "";
+                }
+            }
+
+        private:
+            Type type_;
+            std::vector<std::unique_ptr<Expr>> args_;
+        };
+    }
+
     namespace /* UnaryOpExpr implementation */ {
         class UnaryOpExpr final : public Expr {
         public:
@@ -214,17 +459,21 @@ namespace ASTImpl /* Expr derivatives implementation */ {
             }
 
             // Метод Evaluate() для унарных операций.
-            [[nodiscard]] double Evaluate(LookupValue lookup_value) const override {
+            [[nodiscard]] double Evaluate(const EvaluationContext& context) const override {
                 switch (type_) {
                 case Type::UnaryPlus:
-                    return +operand_->Evaluate(lookup_value);
+                    return +operand_->Evaluate(context);
                 case Type::UnaryMinus:
-                    return -operand_->Evaluate(lookup_value);
+                    return -operand_->Evaluate(context);
                 default:
                     assert(false);
                 }
             }
 
+            void CollectUnconditionalCells(std::vector<Position>& cells) const override {
+                operand_->CollectUnconditionalCells(cells);
+            }
+
         private:
             Type type_;
             std::unique_ptr<Expr> operand_;
@@ -249,7 +498,7 @@ namespace ASTImpl /* Expr derivatives implementation */ {
             }
 
             // For numbers the method returns the number value.
-            [[nodiscard]] double Evaluate(LookupValue /*lookup_value*/) const override {
+            [[nodiscard]] double Evaluate(const EvaluationContext& /*context*/) const override {
                 return value_;
             }
 
@@ -280,9 +529,15 @@ namespace ASTImpl /* Expr derivatives implementation */ {
                 return EP_ATOM;
             }
 
-            double Evaluate(LookupValue lookup_value) const override {
-                assert(lookup_value.has_value());
-                return lookup_value.value()(*cell_);
+            double Evaluate(const EvaluationContext& context) const override {
+                assert(context.lookup_value.has_value());
+                return context.lookup_value.value()(*cell_);
+            }
+
+            void CollectUnconditionalCells(std::vector<Position>& cells) const override {
+                if (cell_->IsValid()) {
+                    cells.push_back(*cell_);
+                }
             }
 
         private:
@@ -291,6 +546,103 @@ namespace ASTImpl /* Expr derivatives implementation */ {
             std::optional<FormulaError> error_;
         };
     }
+
+    namespace /* RangeExpr implementation */ {
+        class RangeExpr final : public Expr {
+        public:
+            explicit RangeExpr(const Rect* range) : range_(range) {}
+
+            void Print(std::ostream& out) const override {
+                const Position last{range_->position.row + range_->size.rows - 1, range_->position.col + range_->size.cols - 1};
+                out << range_->position.ToString() << ':' << last.ToString();
+            }
+
+            void DoPrintFormula(std::ostream& out, ExpressionPrecedence /* precedence */) const override {
+                Print(out);
+            }
+
+            [[nodiscard]] ExpressionPrecedence GetPrecedence() const override {
+                return EP_ATOM;
+            }
+
+            // The range yields the cell that corresponds to the evaluated array element.
+            [[nodiscard]] double Evaluate(const EvaluationContext& context) const override {
+                assert(context.lookup_value.has_value());
+
+                return context.lookup_value.value()(GetElement(*range_, context));
+            }
+
+            void CollectUnconditionalCells(std::vector<Position>& cells) const override {
+                for (int row = 0; row < range_->size.rows; ++row) {
+                    for (int col = 0; col < range_->size.cols; ++col) {
+                        cells.push_back({range_->position.row + row, range_->position.col + col});
+                    }
+                }
+            }
+
+            // A single row or column is broadcast along the other dimension, any other shape mismatch is a value error
+            static Position GetElement(const Rect& range, const EvaluationContext& context) {
+                const Size& size = range.size;
+                if ((size.rows != 1 && size.rows != context.shape.rows) || (size.cols != 1 && size.cols != context.shape.cols)) {
+                    throw FormulaError(FormulaError::Category::Value);
+                }
+
+                const int row = size.rows == 1 ? 0 : context.element.row;
+                const int col = size.cols == 1 ? 0 : context.element.col;
+                return {range.position.row + row, range.position.col + col};
+            }
+
+        private:
+            const Rect* range_;
+        };
+    }
+
+    namespace /* SheetReferenceExpr implementation */ {
+        class SheetReferenceExpr final : public Expr {
+        public:
+            SheetReferenceExpr(const SheetReference* reference, bool is_range) : reference_(reference), is_range_(is_range) {}
+
+            // Names that are not identifiers are quoted, as the grammar requires
+            void Print(std::ostream& out) const override {
+                const std::string& name = reference_->sheet;
+                const bool identifier = (std::isalpha(static_cast<unsigned char>(name.front())) != 0 || name.front() == '_') &&
+                                        std::all_of(name.begin(), name.end(), [](char c) {
+                                            return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '_';
+                                        });
+                if (identifier) {
+                    out << name << '!';
+                } else {
+                    out << '\'' << name << "'!";
+                }
+
+                const Rect& range = reference_->range;
+                out << range.position.ToString();
+                if (is_range_) {
+                    out << ':' << Position{range.position.row + range.size.rows - 1, range.position.col + range.size.cols - 1}.ToString();
+                }
+            }
+
+            void DoPrintFormula(std::ostream& out, ExpressionPrecedence /* precedence */) const override {
+                Print(out);
+            }
+
+            [[nodiscard]] ExpressionPrecedence GetPrecedence() const override {
+                return EP_ATOM;
+            }
+
+            [[nodiscard]] double Evaluate(const EvaluationContext& context) const override {
+                if (!context.lookup_sheet_value) {
+                    throw FormulaError(FormulaError::Category::Ref);
+                }
+                const Position pos = is_range_ ? RangeExpr::GetElement(reference_->range, context) : reference_->range.position;
+                return context.lookup_sheet_value(reference_->sheet, pos);
+            }
+
+        private:
+            const SheetReference* reference_;
+            bool is_range_;
+        };
+    }
 }
 
 namespace ASTImpl /* ASTListener implementation */ {
@@ -311,6 +663,14 @@ namespace ASTImpl /* ASTListener implementation */ {
                 return std::move(cells_);
             }
 
+            std::forward_list<Rect> MoveRanges() {
+                return std::move(ranges_);
+            }
+
+            std::forward_list<SheetReference> MoveSheetReferences() {
+                return std::move(sheet_refs_);
+            }
+
         public:
             void exitUnaryOp(FormulaParser::UnaryOpContext* ctx) override {
                 assert(args_.size() >= 1);
@@ -349,11 +709,84 @@ namespace ASTImpl /* ASTListener implementation */ {
                     throw FormulaException("Invalid position: " + value_str);
                 }
 
+                if (ctx->SHEET() != nullptr) {
+                    sheet_refs_.push_front({GetSheetName(ctx->SHEET()->getSymbol()->getText()), Rect{value, {1, 1}}});
+                    args_.push_back(std::make_unique<SheetReferenceExpr>(&sheet_refs_.front(), false));
+                    return;
+                }
+
                 cells_.push_front(value);
                 auto node = std::make_unique<CellExpr>(&cells_.front());
                 args_.push_back(std::move(node));
             }
 
+            void exitComparison(FormulaParser::ComparisonContext* ctx) override {
+                assert(args_.size() >= 2);
+
+                auto rhs = std::move(args_.back());
+                args_.pop_back();
+
+                auto lhs = std::move(args_.back());
+
+                ComparisonExpr::Type type;
+                if (ctx->EQ()) {
+                    type = ComparisonExpr::Type::Equal;
+                } else if (ctx->NE()) {
+                    type = ComparisonExpr::Type::NotEqual;
+                } else if (ctx->LT()) {
+                    type = ComparisonExpr::Type::Less;
+                } else if (ctx->LE()) {
+                    type = ComparisonExpr::Type::LessOrEqual;
+                } else if (ctx->GT()) {
+                    type = ComparisonExpr::Type::Greater;
+                } else {
+                    assert(ctx->GE() != nullptr);
+                    type = ComparisonExpr::Type::GreaterOrEqual;
+                }
+
+                auto node = std::make_unique<ComparisonExpr>(type, std::move(lhs), std::move(rhs));
+                args_.back() = std::move(node);
+            }
+
+            void exitCall(FormulaParser::CallContext* ctx) override {
+                const size_t args_count = ctx->expr().size();
+                assert(args_.size() >= args_count);
+
+                const auto name = ctx->FUNCTION()->getSymbol()->getText();
+                const auto type = FunctionExpr::Find(name, args_count);
+                if (!type.has_value()) {
+                    throw ParsingError("Unknown function or invalid arguments count: " + name);
+                }
+
+                std::vector<std::unique_ptr<Expr>> args(
+                    std::move_iterator(args_.end() - static_cast<std::ptrdiff_t>(args_count)), std::move_iterator(args_.end()));
+                args_.resize(args_.size() - args_count);
+
+                auto node = std::make_unique<FunctionExpr>(*type, std::move(args));
+                args_.push_back(std::move(node));
+            }
+
+            void exitRange(FormulaParser::RangeContext* ctx) override {
+                const auto first_str = ctx->CELL(0)->getSymbol()->getText();
+                const auto last_str = ctx->CELL(1)->getSymbol()->getText();
+                const auto first = Position::FromString(first_str);
+                const auto last = Position::FromString(last_str);
+                if (!first.IsValid() || !last.IsValid() || last.row < first.row || last.col < first.col) {
+                    throw FormulaException("Invalid range: " + first_str + ':' + last_str);
+                }
+
+                const Rect range{first, {last.row - first.row + 1, last.col - first.col + 1}};
+                if (ctx->SHEET() != nullptr) {
+                    sheet_refs_.push_front({GetSheetName(ctx->SHEET()->getSymbol()->getText()), range});
+                    args_.push_back(std::make_unique<SheetReferenceExpr>(&sheet_refs_.front(), true));
+                    return;
+                }
+
+                ranges_.push_front(range);
+                auto node = std::make_unique<RangeExpr>(&ranges_.front());
+                args_.push_back(std::move(node));
+            }
+
             void exitBinaryOp(FormulaParser::BinaryOpContext* ctx) override {
                 assert(args_.size() >= 2);
 
@@ -382,9 +815,21 @@ namespace ASTImpl /* ASTListener implementation */ {
                 throw ParsingError("Error when parsing: " + node->getSymbol()->getText());
             }
 
+        private:
+            // `Sheet2!` or `'Q1 data'!`
+            static std::string GetSheetName(std::string_view prefix) {
+                prefix.remove_suffix(1);
+                if (prefix.front() == '\'') {
+                    prefix = prefix.substr(1, prefix.size() - 2);
+                }
+                return std::string(prefix);
+            }
+
         private:
             std::vector<std::unique_ptr<Expr>> args_;
             std::forward_list<Position> cells_;
+            std::forward_list<Rect> ranges_;
+            std::forward_list<SheetReference> sheet_refs_;
         };
     }
 
@@ -401,6 +846,246 @@ namespace ASTImpl /* ASTListener implementation */ {
     }
 }
 
+namespace ASTImpl {
+
+    namespace /* SyntaxChecker implementation */ {
+        /**
+         * Recognizer of the language of Formula.g4 that reports the first error instead of throwing. Tokens
+         * are matched by the rules of the grammar lexer: the longest match wins, ties go to the rule defined
+         * first. Operator precedence does not change which expressions are valid, so expressions are read as
+         * unary operands joined by binary operators.
+         */
+        class SyntaxChecker {
+        public:
+            explicit SyntaxChecker(std::string_view expression) : text_(expression) {
+                Next_();
+            }
+
+            std::optional<FormulaSyntaxError> Check() {
+                if (Expr_() && token_.kind != Kind::End) {
+                    Fail_("Unexpected token", token_.offset);
+                }
+                return error_;
+            }
+
+        private:
+            enum class Kind { LeftParen, RightParen, Comma, Colon, Number, Operator, Cell, Sheet, Function, End, Invalid };
+
+            struct Token {
+                Kind kind = Kind::End;
+                size_t offset = 0;
+                std::string_view text;
+            };
+
+            static bool IsUpper(char c) {
+                return c >= 'A' && c <= 'Z';
+            }
+            static bool IsDigit(char c) {
+                return c >= '0' && c <= '9';
+            }
+            static bool IsIdentifier(char c) {
+                return IsUpper(c) || IsDigit(c) || (c >= 'a' && c <= 'z') || c == '_';
+            }
+            /// Whether the listener reads the literal: stream extraction parses it with strtod and fails on overflow to infinity
+            static bool IsFinite(std::string_view literal) {
+                /// Short literals are terminated on the stack instead of copied to the heap
+                static constexpr size_t BUFFER_SIZE = 64;
+                char buffer[BUFFER_SIZE];
+                std::string long_literal;
+                const char* begin = buffer;
+                if (literal.size() < BUFFER_SIZE) {
+                    std::copy(literal.begin(), literal.end(), buffer);
+                    buffer[literal.size()] = '\0';
+                } else {
+                    long_literal = literal;
+                    begin = long_literal.c_str();
+                }
+                return std::isfinite(std::strtod(begin, nullptr));
+            }
+
+            size_t CountWhile_(size_t from, bool (*predicate)(char)) const {
+                size_t end = from;
+                while (end < text_.size() && predicate(text_[end])) {
+                    ++end;
+                }
+                return end - from;
+            }
+
+            size_t MatchNumber_(size_t from) const {
+                size_t end = from + CountWhile_(from, IsDigit);
+                if (end < text_.size() && text_[end] == '.' && end + 1 < text_.size() && IsDigit(text_[end + 1])) {
+                    end += 1 + CountWhile_(end + 1, IsDigit);
+                }
+                if (end == from) {
+                    return 0;
+                }
+                if (end < text_.size() && (text_[end] == 'e' || text_[end] == 'E')) {
+                    const size_t sign = end + 1 < text_.size() && (text_[end + 1] == '+' || text_[end + 1] == '-') ? 1 : 0;
+                    if (const size_t digits = CountWhile_(end + 1 + sign, IsDigit); digits > 0) {
+                        end += 1 + sign + digits;
+                    }
+                }
+                return end - from;
+            }
+
+            size_t MatchCell_(size_t from) const {
+                const size_t letters = CountWhile_(from, IsUpper);
+                const size_t digits = letters > 0 ? CountWhile_(from + letters, IsDigit) : 0;
+                return digits > 0 ? letters + digits : 0;
+            }
+
+            size_t MatchSheet_(size_t from) const {
+                size_t end = from;
+                if (text_[from] == '\'') {
+                    end = text_.find('\'', from + 1);
+                    if (end == std::string_view::npos || end == from + 1) {
+                        return 0;
+                    }
+                    ++end;
+                } else if (IsIdentifier(text_[from]) && !IsDigit(text_[from])) {
+                    end += CountWhile_(from, IsIdentifier);
+                }
+                return end > from && end < text_.size() && text_[end] == '!' ? end + 1 - from : 0;
+            }
+
+            size_t MatchOperator_(size_t from) const {
+                const std::string_view rest = text_.substr(from);
+                if (rest.starts_with("<>") || rest.starts_with("<=") || rest.starts_with(">=")) {
+                    return 2;
+                }
+                return std::string_view("+-*/=<>").find(rest.front()) != std::string_view::npos ? 1 : 0;
+            }
+
+            void Next_() {
+                size_t from = token_.offset + token_.text.size();
+                from += CountWhile_(from, [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; });
+                if (from == text_.size()) {
+                    token_ = {Kind::End, from, {}};
+                    return;
+                }
+
+                static constexpr std::string_view PUNCTUATION = "(),:";
+                if (const size_t index = PUNCTUATION.find(text_[from]); index != std::string_view::npos) {
+                    token_ = {static_cast<Kind>(index), from, text_.substr(from, 1)};
+                    return;
+                }
+                token_ = {Kind::Invalid, from, {}};
+                for (const auto& [kind, length] : {std::pair{Kind::Number, MatchNumber_(from)}, std::pair{Kind::Operator, MatchOperator_(from)},
+                                                   std::pair{Kind::Cell, MatchCell_(from)}, std::pair{Kind::Sheet, MatchSheet_(from)},
+                                                   std::pair{Kind::Function, CountWhile_(from, IsUpper)}}) {
+                    if (length > token_.text.size()) {
+                        token_ = {kind, from, text_.substr(from, length)};
+                    }
+                }
+            }
+
+            bool Fail_(std::string_view message, size_t offset) {
+                error_ = FormulaSyntaxError{message, offset};
+                return false;
+            }
+
+            bool Expect_(Kind kind) {
+                if (token_.kind != kind) {
+                    return Fail_(token_.kind == Kind::Invalid ? "Unexpected character"
+                                 : token_.kind == Kind::End   ? "Unexpected end of formula"
+                                                              : "Unexpected token",
+                                 token_.offset);
+                }
+                Next_();
+                return true;
+            }
+
+            bool Expr_() {
+                if (!Unary_()) {
+                    return false;
+                }
+                while (token_.kind == Kind::Operator) {
+                    Next_();
+                    if (!Unary_()) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            bool Unary_() {
+                while (token_.kind == Kind::Operator && (token_.text == "+" || token_.text == "-")) {
+                    Next_();
+                }
+                return Primary_();
+            }
+
+            bool Primary_() {
+                const Token token = token_;
+                switch (token.kind) {
+                case Kind::LeftParen:
+                    Next_();
+                    return Expr_() && Expect_(Kind::RightParen);
+                case Kind::Function: {
+                    Next_();
+                    if (!Expect_(Kind::LeftParen)) {
+                        return false;
+                    }
+                    size_t args_count = 0;
+                    if (token_.kind != Kind::RightParen) {
+                        do {
+                            if (args_count++ > 0) {
+                                Next_();
+                            }
+                            if (!Expr_()) {
+                                return false;
+                            }
+                        } while (token_.kind == Kind::Comma);
+                    }
+                    if (!Expect_(Kind::RightParen)) {
+                        return false;
+                    }
+                    return FunctionExpr::Find(token.text, args_count).has_value() || Fail_("Unknown function or invalid arguments count", token.offset);
+                }
+                case Kind::Sheet:
+                    Next_();
+                    return token_.kind == Kind::Cell ? Reference_() : Expect_(Kind::Cell);
+                case Kind::Cell:
+                    return Reference_();
+                case Kind::Number:
+                    Next_();
+                    return IsFinite(token.text) || Fail_("Invalid number", token.offset);
+                default:
+                    return Expect_(Kind::Number);
+                }
+            }
+
+            bool Reference_() {
+                const Token first = token_;
+                Next_();
+                const Position first_pos = Position::FromString(first.text);
+                if (token_.kind != Kind::Colon) {
+                    return first_pos.IsValid() || Fail_("Invalid position", first.offset);
+                }
+                Next_();
+                const Token last = token_;
+                if (!Expect_(Kind::Cell)) {
+                    return false;
+                }
+                const Position last_pos = Position::FromString(last.text);
+                if (!first_pos.IsValid() || !last_pos.IsValid() || last_pos.row < first_pos.row || last_pos.col < first_pos.col) {
+                    return Fail_("Invalid range", first.offset);
+                }
+                return true;
+            }
+
+        private:
+            std::string_view text_;
+            Token token_;
+            std::optional<FormulaSyntaxError> error_;
+        };
+    }
+}
+
+std::optional<FormulaSyntaxError> CheckFormulaSyntax(std::string_view expression) {
+    return ASTImpl::SyntaxChecker(expression).Check();
+}
+
 FormulaAST ParseFormulaAST(std::istream& in) {
     using namespace antlr4;
 
@@ -422,7 +1107,7 @@ FormulaAST ParseFormulaAST(std::istream& in) {
     ASTImpl::ParseASTListener listener;
     tree::ParseTreeWalker::DEFAULT.walk(&listener, tree);
 
-    return {listener.MoveRoot(), listener.MoveCells()};
+    return {listener.MoveRoot(), listener.MoveCells(), listener.MoveRanges(), listener.MoveSheetReferences()};
 }
 
 FormulaAST ParseFormulaAST(const std::string& in_str) {
@@ -445,11 +1130,16 @@ void FormulaAST::PrintFormula(std::ostream& out) const {
 }
 
 double FormulaAST::Execute(LookupValue lookup_value) const {
-    return root_expr_->Evaluate(lookup_value);
+    return Execute(EvaluationContext{std::move(lookup_value)});
 }
 
-FormulaAST::FormulaAST(std::unique_ptr<ASTImpl::Expr> root_expr, std::forward_list<Position> cells)
-    : root_expr_(std::move(root_expr)), cells_(std::move(cells)) {
+double FormulaAST::Execute(const EvaluationContext& context) const {
+    return root_expr_->Evaluate(context);
+}
+
+FormulaAST::FormulaAST(std::unique_ptr<ASTImpl::Expr> root_expr, std::forward_list<Position> cells, std::forward_list<Rect> ranges,
+                       std::forward_list<SheetReference> sheet_refs)
+    : root_expr_(std::move(root_expr)), cells_(std::move(cells)), ranges_(std::move(ranges)), sheet_refs_(std::move(sheet_refs)) {
     cells_.sort();  // to avoid sorting in GetReferencedCells
 }
 
@@ -462,3 +1152,17 @@ const std::forward_list<Position>& FormulaAST::GetCells() const {
 std::forward_list<Position>& FormulaAST::GetCells() {
     return cells_;
 }
+
+std::vector<Position> FormulaAST::GetUnconditionalCells() const {
+    std::vector<Position> cells;
+    root_expr_->CollectUnconditionalCells(cells);
+    return cells;
+}
+
+const std::forward_list<Rect>& FormulaAST::GetRanges() const {
+    return ranges_;
+}
+
+const std::forward_list<SheetReference>& FormulaAST::GetSheetReferences() const {
+    return sheet_refs_;
+}
@@ -6,10 +6,13 @@ main
 
 expr
     : '(' expr ')'  # Parens
+    | FUNCTION '(' (expr (',' expr)*)? ')'  # Call
     | (ADD | SUB) expr  # UnaryOp
     | expr (MUL | DIV) expr  # BinaryOp
     | expr (ADD | SUB) expr  # BinaryOp
-    | CELL  # Cell
+    | expr (EQ | NE | LT | LE | GT | GE) expr  # Comparison
+    | SHEET? CELL ':' CELL  # Range
+    | SHEET? CELL  # Cell
     | NUMBER  # Literal
     ;
 
@@ -26,5 +29,17 @@ ADD: '+' ;
 SUB: '-' ;
 MUL: '*' ;
 DIV: '/' ;
+EQ: '=' ;
+NE: '<>' ;
+LT: '<' ;
+LE: '<=' ;
+GT: '>' ;
+GE: '>=' ;
 CELL: [A-Z]+[0-9]+ ;
+// sheet prefix of a reference, quoted if the name is not an identifier: Sheet2!A1, 'Q1 data'!A1
+SHEET
+    : [A-Za-z_][A-Za-z0-9_]* '!'
+    | '\'' ~[']+ '\'' '!'
+    ;
+FUNCTION: [A-Z]+ ;
 WS: [ \t\n\r]+ -> skip ;
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "async.h"
+
+#include <utility>
+
+namespace spreadsheet /* AsyncSheet implementation */ {
+
+    AsyncSheet::AsyncSheet(Resume resume) : resume_(std::move(resume)) {}
+
+    Task<void> AsyncSheet::SetCellAsync(Position pos, std::string text) {
+        return Submit([pos, text = std::move(text)](Sheet& sheet) mutable { sheet.SetCell(pos, std::move(text)); });
+    }
+
+    Task<void> AsyncSheet::SetCellsAsync(std::vector<std::pair<Position, std::string>> cells) {
+        return Submit([cells = std::move(cells)](Sheet& sheet) mutable { sheet.SetCells(std::move(cells)); });
+    }
+
+    Task<void> AsyncSheet::ClearCellAsync(Position pos) {
+        return Submit([pos](Sheet& sheet) { sheet.ClearCell(pos); });
+    }
+
+    Task<RecalculationStats> AsyncSheet::RecalculateAsync() {
+        return Submit([](Sheet& sheet) { return sheet.Recalculate(); });
+    }
+
+    Task<CellInterface::Value> AsyncSheet::GetValueAsync(Position pos) {
+        return Submit([pos](const Sheet& sheet) { return sheet.GetValue(pos); });
+    }
+
+    SheetSnapshot AsyncSheet::Snapshot() const {
+        return sheet_.Snapshot();
+    }
+}
@@ -1,18 +1,29 @@
 #include "cell.h"
 
+#include <atomic>
 #include <cassert>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 
 #include "common.h"
 
+namespace {
+    /// Clock of value versions, shared by all sheets; cells of one sheet may be computed concurrently
+    std::uint64_t NextTick() {
+        static std::atomic<std::uint64_t> clock = 0;
+        return clock.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+}
+
 Cell::Cell(SheetInterface& sheet) : impl_(std::make_unique<EmptyImpl>()), sheet_{sheet} {}
 
 Cell::~Cell() = default;
 
 void Cell::Set(std::string text) {
     ClearCache();
+    cache_ = nullptr;
 
     if (text.empty()) {
         impl_ = std::make_unique<EmptyImpl>();
@@ -24,19 +35,60 @@ void Cell::Set(std::string text) {
     }
 }
 
+void Cell::SetArray(Size size, std::string text) {
+    ClearCache();
+    cache_ = nullptr;
+
+    if (text.length() <= 1 || text[0] != '=') {
+        throw FormulaException("Array formula must start with '='");
+    }
+    impl_ = std::make_unique<ArrayImpl>(std::move(text.erase(0, 1)), size, sheet_);
+}
+
 void Cell::Clear() {
+    state_.store(CacheState::outdated, std::memory_order_relaxed);
     cache_ = nullptr;
     impl_ = nullptr;
 }
 
 Cell::Value Cell::GetValue() const {
+    Compute_();
+    return *cache_;
+}
+
+Cell::ValueRef Cell::GetValueRef() const {
+    Compute_();
+    return ViewValue(*cache_);
+}
+
+void Cell::Compute_() const {
     assert(impl_ != nullptr);
 
-    if (!HasCache()) {
-        cache_ = std::make_unique<Value>(impl_->GetValue());
-    }
+    if (Claim_()) {
+        Value value;
+        try {
+            value = impl_->GetValue();
+        } catch (...) {
+            /// E.g. the sheet suspends the evaluation until a precedent is computed
+            Publish_(CacheState::outdated);
+            throw;
+        }
 
-    return *cache_;
+        /// Only the first element of an array is cached here, so arrays always count as changed
+        const bool changed = cache_ == nullptr || IsArray() || !(*cache_ == value);
+        if (cache_ == nullptr) {
+            cache_ = std::make_unique<Value>(std::move(value));
+        } else {
+            *cache_ = std::move(value);
+        }
+
+        const std::uint64_t tick = NextTick();
+        verified_at_.store(tick, std::memory_order_relaxed);
+        if (changed) {
+            changed_at_.store(tick, std::memory_order_relaxed);
+        }
+        Publish_(CacheState::ready);
+    }
 }
 
 std::string Cell::GetText() const {
@@ -45,15 +97,142 @@ std::string Cell::GetText() const {
     return impl_->GetText();
 }
 
+std::shared_ptr<const std::string> Cell::GetSharedText() const {
+    assert(impl_ != nullptr);
+    return impl_->GetSharedText();
+}
+
+std::optional<std::string_view> Cell::GetTextValue() const {
+    assert(impl_ != nullptr);
+    return impl_->GetTextValue();
+}
+
 std::vector<Position> Cell::GetReferencedCells() const {
     assert(impl_ != nullptr);
     return impl_->GetReferencedCells();
 }
 
+std::vector<Rect> Cell::GetReferencedRanges() const {
+    assert(impl_ != nullptr);
+    return impl_->GetReferencedRanges();
+}
+
+std::vector<Position> Cell::GetUnconditionalCells() const {
+    assert(impl_ != nullptr);
+    return impl_->GetUnconditionalCells();
+}
+
+std::vector<SheetReference> Cell::GetSheetReferences() const {
+    assert(impl_ != nullptr);
+    return impl_->GetSheetReferences();
+}
+
+void Cell::RemapReferences(const std::function<Position(Position)>& remap) {
+    assert(impl_ != nullptr);
+    impl_->RemapReferences(remap);
+}
+
 void Cell::ClearCache() {
-    cache_ = nullptr;
+    state_.store(CacheState::outdated, std::memory_order_relaxed);
+    if (impl_ != nullptr) {
+        impl_->ClearCache();
+    }
 }
 
 bool Cell::HasCache() const {
-    return cache_ != nullptr;
+    return state_.load(std::memory_order_acquire) == CacheState::ready;
+}
+
+std::uint64_t Cell::GetChangedAt() const {
+    return changed_at_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Cell::GetVerifiedAt() const {
+    return verified_at_.load(std::memory_order_relaxed);
+}
+
+bool Cell::Revalidate() const {
+    if (!Claim_()) {
+        return true;
+    }
+    if (cache_ == nullptr || IsArray()) {
+        Publish_(CacheState::outdated);
+        return false;
+    }
+    verified_at_.store(NextTick(), std::memory_order_relaxed);
+    Publish_(CacheState::ready);
+    return true;
+}
+
+bool Cell::Claim_() const {
+    CacheState state = state_.load(std::memory_order_acquire);
+    while (state != CacheState::ready) {
+        if (state == CacheState::computing) {
+            state_.wait(state, std::memory_order_acquire);
+            state = state_.load(std::memory_order_acquire);
+        } else if (state_.compare_exchange_weak(state, CacheState::computing, std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Cell::Publish_(CacheState state) const {
+    state_.store(state, std::memory_order_release);
+    state_.notify_all();
+}
+
+bool Cell::IsEmpty() const {
+    assert(impl_ != nullptr);
+    return impl_->IsEmpty();
+}
+
+bool Cell::IsArray() const {
+    return AsArray() != nullptr;
+}
+
+Size Cell::GetArraySize() const {
+    const ArrayImpl* array = AsArray();
+    return array != nullptr ? array->GetSize() : Size{1, 1};
+}
+
+Cell::Value Cell::GetArrayValue(Position offset) const {
+    return CopyValue(GetArrayValueRef(offset));
+}
+
+Cell::ValueRef Cell::GetArrayValueRef(Position offset) const {
+    const ArrayImpl* array = AsArray();
+    if (array == nullptr) {
+        assert(offset == Position{});
+        return GetValueRef();
+    }
+    /// The anchor fills the buffer of the whole block while it is claimed
+    const ValueRef anchor_value = GetValueRef();
+    if (offset == Position{}) {
+        return anchor_value;
+    }
+    return array->GetValueRef(offset);
+}
+
+const Cell* Cell::GetArrayElement(Position offset) const {
+    const ArrayImpl* array = AsArray();
+    if (array == nullptr || offset == Position{}) {
+        assert(offset == Position{});
+        return this;
+    }
+    return array->GetElement(*this, offset);
+}
+
+const Cell::ArrayImpl* Cell::AsArray() const {
+    return dynamic_cast<const ArrayImpl*>(impl_.get());
+}
+
+const Cell* Cell::ArrayImpl::GetElement(const Cell& anchor, Position offset) const {
+    const std::lock_guard lock(elements_mutex_);
+    auto& element = elements_[offset.row * size_.cols + offset.col];
+    if (element == nullptr) {
+        element = std::make_unique<Cell>(anchor.sheet_);
+        element->impl_ = std::make_unique<ArrayElementImpl>(anchor, offset);
+    }
+    return element.get();
 }
@@ -0,0 +1,79 @@
+#include "change_feed.h"
+
+#include <utility>
+#include <vector>
+
+namespace spreadsheet /* ChangeFeed implementation */ {
+
+    ChangeFeed::~ChangeFeed() {
+        for (Message* message = head_.load(std::memory_order_acquire); message != nullptr;) {
+            delete std::exchange(message, message->next);
+        }
+    }
+
+    void ChangeFeed::PushSubscribe(SubscriptionId id, ChangeCallback callback, Clock::duration window) {
+        Push_(new Message{Message::Kind::subscribe, id, std::move(callback), window, {}});
+    }
+
+    void ChangeFeed::PushUnsubscribe(SubscriptionId id) {
+        Push_(new Message{Message::Kind::unsubscribe, id, {}, {}, {}});
+    }
+
+    void ChangeFeed::PushChanges(std::vector<std::pair<SubscriptionId, CellChange>> changes) {
+        Push_(new Message{Message::Kind::changes, 0, {}, {}, std::move(changes)});
+    }
+
+    void ChangeFeed::Push_(Message* message) {
+        message->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(message->next, message, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    size_t ChangeFeed::Deliver(Clock::time_point now) {
+        /// The list is detached whole, so no other consumer can pop a node meanwhile and there is no ABA
+        Message* fifo = nullptr;
+        for (Message* message = head_.exchange(nullptr, std::memory_order_acquire); message != nullptr;) {
+            Message* next = std::exchange(message->next, fifo);
+            fifo = std::exchange(message, next);
+        }
+        while (fifo != nullptr) {
+            Apply_(*fifo);
+            delete std::exchange(fifo, fifo->next);
+        }
+
+        size_t delivered = 0;
+        std::vector<CellChange> batch;
+        for (auto& [id, subscriber] : subscribers_) {
+            if (subscriber.pending.empty() || (subscriber.delivered_at.has_value() && now - *subscriber.delivered_at < subscriber.window)) {
+                continue;
+            }
+            batch.clear();
+            for (auto& [pos, value] : subscriber.pending) {
+                batch.push_back({pos, std::move(value)});
+            }
+            subscriber.pending.clear();
+            subscriber.delivered_at = now;
+            subscriber.callback(batch);
+            ++delivered;
+        }
+        return delivered;
+    }
+
+    void ChangeFeed::Apply_(Message& message) {
+        switch (message.kind) {
+        case Message::Kind::subscribe:
+            subscribers_.insert_or_assign(message.id, Subscriber{std::move(message.callback), message.window, std::nullopt, {}});
+            break;
+        case Message::Kind::unsubscribe:
+            subscribers_.erase(message.id);
+            break;
+        case Message::Kind::changes:
+            for (auto& [id, change] : message.changes) {
+                if (const auto it = subscribers_.find(id); it != subscribers_.end()) {
+                    it->second.pending.insert_or_assign(change.pos, std::move(change.value));
+                }
+            }
+            break;
+        }
+    }
+}
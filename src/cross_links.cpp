@@ -0,0 +1,94 @@
+#include "cross_links.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace spreadsheet /* CrossLinks implementation */ {
+
+    bool RegionCell::operator==(const RegionCell& rhs) const {
+        return region == rhs.region && pos == rhs.pos;
+    }
+
+    size_t RegionCellHasher::operator()(const RegionCell& cell) const {
+        return graph::Hasher()(cell.pos) * 31 + cell.region;
+    }
+
+    CrossLinks::CrossLinks(size_t region_count) : regions_(region_count) {}
+
+    void CrossLinks::AddRegion() {
+        regions_.emplace_back();
+    }
+
+    void CrossLinks::Link(const RegionCell& cell, std::vector<RegionCell> refs) {
+        Unlink(cell);
+        if (refs.empty()) {
+            return;
+        }
+
+        Links& links = regions_[cell.region];
+        for (const RegionCell& ref : refs) {
+            regions_[ref.region].readers[ref.pos].push_back(cell);
+            ++links.reads[ref.region];
+        }
+        links.refs.emplace(cell.pos, std::move(refs));
+    }
+
+    void CrossLinks::Unlink(const RegionCell& cell) {
+        Links& links = regions_[cell.region];
+        const auto refs_it = links.refs.find(cell.pos);
+        if (refs_it == links.refs.end()) {
+            return;
+        }
+
+        for (const RegionCell& ref : refs_it->second) {
+            auto& readers = regions_[ref.region].readers;
+            const auto readers_it = readers.find(ref.pos);
+            std::erase(readers_it->second, cell);
+            if (readers_it->second.empty()) {
+                readers.erase(readers_it);
+            }
+            if (const auto reads_it = links.reads.find(ref.region); --reads_it->second == 0) {
+                links.reads.erase(reads_it);
+            }
+        }
+        links.refs.erase(refs_it);
+    }
+
+    const std::vector<RegionCell>& CrossLinks::GetReferences(const RegionCell& cell) const {
+        static const std::vector<RegionCell> none;
+        const Links& links = regions_[cell.region];
+        const auto refs_it = links.refs.find(cell.pos);
+        return refs_it != links.refs.end() ? refs_it->second : none;
+    }
+
+    bool CrossLinks::HasReferences(size_t region) const {
+        return !regions_[region].refs.empty();
+    }
+
+    bool CrossLinks::HasReaders(size_t region) const {
+        return !regions_[region].readers.empty();
+    }
+
+    const std::map<size_t, size_t>& CrossLinks::GetReadRegions(size_t region) const {
+        return regions_[region].reads;
+    }
+
+    void CrossLinks::Invalidated(size_t region, const std::vector<Position>& positions) {
+        Links& links = regions_[region];
+        if (links.readers.empty()) {
+            return;
+        }
+        for (const Position& pos : positions) {
+            if (const auto readers_it = links.readers.find(pos); readers_it != links.readers.end()) {
+                for (const RegionCell& reader : readers_it->second) {
+                    links.pending[reader.region].push_back(reader.pos);
+                }
+            }
+        }
+    }
+
+    CrossLinks::Readers CrossLinks::TakeReaders(size_t region) {
+        return std::exchange(regions_[region].pending, {});
+    }
+}
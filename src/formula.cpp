@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cerrno>
 #include <cstdlib>
 #include <sstream>
 #include <string>
@@ -31,44 +32,20 @@ namespace {
         explicit Formula(std::string expression) : ast_(ParseFormulaAST(expression)){};
 
         [[nodiscard]] Value Evaluate(const SheetInterface &sheet) const override {
-            const auto lookup_value = [&sheet](const Position &position) -> double {
-                const CellInterface *cell_ptr = sheet.GetCell(position);
-                if (cell_ptr == nullptr) {
-                    return 0.0;
-                }
-
-                CellInterface::Value cell_value = cell_ptr->GetValue();
-
-                if (const FormulaError *error = std::get_if<FormulaError>(&cell_value); error != nullptr) {
-                    throw *error;
-                }
+            return EvaluateElement(EvaluationContext{MakeLookup(sheet), {1, 1}, {0, 0}, MakeSheetLookup(sheet)});
+        }
 
-                if (const double *result = std::get_if<double>(&cell_value); result != nullptr) {
-                    return *result;
-                }
+        [[nodiscard]] std::vector<Value> EvaluateArray(const SheetInterface &sheet, Size size) const override {
+            std::vector<Value> result;
+            result.reserve(static_cast<size_t>(size.rows) * static_cast<size_t>(size.cols));
 
-                if (const std::string *str = std::get_if<std::string>(&cell_value); str != nullptr) {
-                    size_t idx = 0;
-                    try {
-                        double result = std::stod(*str, &idx);
-                        if (idx < str->size()) {
-                            throw FormulaError(FormulaError::Category::Value);
-                        }
-                        return result;
-                    } catch (...) {
-                    }
+            EvaluationContext context{MakeLookup(sheet), size, {0, 0}, MakeSheetLookup(sheet)};
+            for (context.element.row = 0; context.element.row < size.rows; ++context.element.row) {
+                for (context.element.col = 0; context.element.col < size.cols; ++context.element.col) {
+                    result.push_back(EvaluateElement(context));
                 }
-
-                throw FormulaError(FormulaError::Category::Value);
-            };
-
-            Value res;
-            try {
-                res = ast_.Execute(lookup_value);
-            } catch (const FormulaError &err) {
-                res = err;
             }
-            return res;
+            return result;
         }
 
         [[nodiscard]] std::string GetExpression() const override {
@@ -80,10 +57,79 @@ namespace {
         [[nodiscard]] std::vector<Position> GetReferencedCells() const override {
             const auto &cell_refs = ast_.GetCells();
             auto result = std::vector<Position>(cell_refs.begin(), cell_refs.end());
+            for (const Rect &range : ast_.GetRanges()) {
+                for (int row = 0; row < range.size.rows; ++row) {
+                    for (int col = 0; col < range.size.cols; ++col) {
+                        result.push_back({range.position.row + row, range.position.col + col});
+                    }
+                }
+            }
             formula::helpers::MakeUnique(result);
             return result;
         }
 
+        [[nodiscard]] std::vector<Position> GetUnconditionalCells() const override {
+            auto result = ast_.GetUnconditionalCells();
+            formula::helpers::MakeUnique(result);
+            return result;
+        }
+
+        [[nodiscard]] std::vector<Rect> GetReferencedRanges() const override {
+            const auto &ranges = ast_.GetRanges();
+            return {ranges.begin(), ranges.end()};
+        }
+
+        [[nodiscard]] std::vector<SheetReference> GetSheetReferences() const override {
+            const auto &sheet_refs = ast_.GetSheetReferences();
+            return {sheet_refs.begin(), sheet_refs.end()};
+        }
+
+        void RemapReferences(const std::function<Position(Position)> &remap) override {
+            /// Cell nodes of the AST point into this list, so positions are replaced in place
+            auto &cells = ast_.GetCells();
+            std::transform(cells.begin(), cells.end(), cells.begin(), remap);
+            cells.sort();
+        }
+
+    private:
+        static LookupValue MakeLookup(const SheetInterface &sheet) {
+            return [&sheet](const Position &position) -> double {
+                return ToNumber(sheet.GetValueRef(position));
+            };
+        }
+
+        static LookupSheetValue MakeSheetLookup(const SheetInterface &sheet) {
+            return [&sheet](std::string_view name, const Position &position) -> double {
+                return ToNumber(CellInterface::ViewValue(sheet.GetSheetValue(name, position)));
+            };
+        }
+
+        static double ToNumber(const CellInterface::ValueRef &cell_value) {
+            if (const FormulaError *error = std::get_if<FormulaError>(&cell_value); error != nullptr) {
+                throw *error;
+            }
+
+            if (const double *result = std::get_if<double>(&cell_value); result != nullptr) {
+                return *result;
+            }
+
+            const std::optional<double> result = TextToNumber(std::get<std::string_view>(cell_value));
+            if (!result.has_value()) {
+                throw FormulaError(FormulaError::Category::Value);
+            }
+            return *result;
+        }
+
+        [[nodiscard]] Value EvaluateElement(const EvaluationContext &context) const {
+            Value res;
+            try {
+                res = ast_.Execute(context);
+            } catch (const FormulaError &err) {
+                res = err;
+            }
+            return res;
+        }
+
     private:
         FormulaAST ast_;
     };
@@ -97,6 +143,33 @@ std::unique_ptr<FormulaInterface> ParseFormula(std::string expression) {
     }
 }
 
+std::optional<FormulaSyntaxError> CheckFormula(std::string_view expression) {
+    return CheckFormulaSyntax(expression);
+}
+
+std::optional<double> TextToNumber(std::string_view text) {
+    /// Read as `std::stod` reads the whole text; short texts are terminated on the stack instead of copied to the heap
+    static constexpr size_t BUFFER_SIZE = 64;
+    char buffer[BUFFER_SIZE];
+    std::string long_text;
+    const char *begin = buffer;
+    if (text.size() < BUFFER_SIZE) {
+        std::copy(text.begin(), text.end(), buffer);
+        buffer[text.size()] = '\0';
+    } else {
+        long_text = text;
+        begin = long_text.c_str();
+    }
+
+    char *end = nullptr;
+    errno = 0;
+    const double result = std::strtod(begin, &end);
+    if (text.empty() || end != begin + text.size() || errno == ERANGE) {
+        return std::nullopt;
+    }
+    return result;
+}
+
 FormulaError::FormulaError(Category category) : category_(category) {}
 
 FormulaError::Category FormulaError::GetCategory() const {
@@ -0,0 +1,582 @@
+#include "query.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "parallel.h"
+#include "sheet.h"
+
+namespace spreadsheet::query /* RowBitmap implementation */ {
+
+    RowBitmap::RowBitmap(size_t size, bool value) : size_(size), words_((size + WORD_BITS - 1) / WORD_BITS, value ? ~Word{0} : Word{0}) {
+        ClearTail_();
+    }
+
+    size_t RowBitmap::Size() const {
+        return size_;
+    }
+
+    size_t RowBitmap::Count() const {
+        return std::accumulate(words_.begin(), words_.end(), size_t{0}, [](size_t count, Word word) {
+            return count + static_cast<size_t>(std::popcount(word));
+        });
+    }
+
+    bool RowBitmap::Test(size_t row) const {
+        assert(row < size_);
+        return (words_[row / WORD_BITS] >> (row % WORD_BITS)) & 1;
+    }
+
+    void RowBitmap::Set(size_t row, bool value) {
+        assert(row < size_);
+        const Word mask = Word{1} << (row % WORD_BITS);
+        words_[row / WORD_BITS] = value ? words_[row / WORD_BITS] | mask : words_[row / WORD_BITS] & ~mask;
+    }
+
+    std::vector<int> RowBitmap::ToRows() const {
+        std::vector<int> rows;
+        rows.reserve(Count());
+        for (size_t i = 0; i < words_.size(); ++i) {
+            for (Word word = words_[i]; word != 0; word &= word - 1) {
+                rows.push_back(static_cast<int>(i * WORD_BITS + static_cast<size_t>(std::countr_zero(word))));
+            }
+        }
+        return rows;
+    }
+
+    RowBitmap::Word* RowBitmap::GetWords() {
+        return words_.data();
+    }
+
+    const RowBitmap::Word* RowBitmap::GetWords() const {
+        return words_.data();
+    }
+
+    RowBitmap& RowBitmap::operator&=(const RowBitmap& other) {
+        assert(size_ == other.size_);
+        std::transform(words_.begin(), words_.end(), other.words_.begin(), words_.begin(), std::bit_and<>());
+        return *this;
+    }
+
+    RowBitmap& RowBitmap::operator|=(const RowBitmap& other) {
+        assert(size_ == other.size_);
+        std::transform(words_.begin(), words_.end(), other.words_.begin(), words_.begin(), std::bit_or<>());
+        return *this;
+    }
+
+    RowBitmap RowBitmap::operator~() const {
+        RowBitmap result(*this);
+        std::transform(result.words_.begin(), result.words_.end(), result.words_.begin(), std::bit_not<>());
+        result.ClearTail_();
+        return result;
+    }
+
+    bool RowBitmap::operator==(const RowBitmap& other) const {
+        return size_ == other.size_ && words_ == other.words_;
+    }
+
+    void RowBitmap::ClearTail_() {
+        if (const size_t tail = size_ % WORD_BITS; tail != 0) {
+            words_.back() &= (Word{1} << tail) - 1;
+        }
+    }
+
+    RowBitmap operator&(RowBitmap lhs, const RowBitmap& rhs) {
+        return lhs &= rhs;
+    }
+
+    RowBitmap operator|(RowBitmap lhs, const RowBitmap& rhs) {
+        return lhs |= rhs;
+    }
+}
+
+namespace spreadsheet::query /* Predicates implementation */ {
+
+    Predicate Column::operator==(double operand) const {
+        return {index, CompareOp::Equal, operand};
+    }
+
+    Predicate Column::operator!=(double operand) const {
+        return {index, CompareOp::NotEqual, operand};
+    }
+
+    Predicate Column::operator<(double operand) const {
+        return {index, CompareOp::Less, operand};
+    }
+
+    Predicate Column::operator<=(double operand) const {
+        return {index, CompareOp::LessOrEqual, operand};
+    }
+
+    Predicate Column::operator>(double operand) const {
+        return {index, CompareOp::Greater, operand};
+    }
+
+    Predicate Column::operator>=(double operand) const {
+        return {index, CompareOp::GreaterOrEqual, operand};
+    }
+
+    Predicate Column::operator==(std::string operand) const {
+        return {index, CompareOp::Equal, std::move(operand)};
+    }
+
+    Predicate Column::operator!=(std::string operand) const {
+        return {index, CompareOp::NotEqual, std::move(operand)};
+    }
+
+    namespace {
+        template <CompareOp Op>
+        bool CompareScalar(double value, double operand) {
+            if constexpr (Op == CompareOp::Equal) {
+                return value == operand;
+            } else if constexpr (Op == CompareOp::NotEqual) {
+                return value == value && value != operand;  // NaN never matches
+            } else if constexpr (Op == CompareOp::Less) {
+                return value < operand;
+            } else if constexpr (Op == CompareOp::LessOrEqual) {
+                return value <= operand;
+            } else if constexpr (Op == CompareOp::Greater) {
+                return value > operand;
+            } else {
+                return value >= operand;
+            }
+        }
+
+#if defined(__AVX__)
+        constexpr size_t LANES = 4;
+
+        template <CompareOp Op>
+        unsigned CompareLanes(const double* values, __m256d operand) {
+            constexpr int predicate = Op == CompareOp::Equal          ? _CMP_EQ_OQ
+                                      : Op == CompareOp::NotEqual     ? _CMP_NEQ_OQ
+                                      : Op == CompareOp::Less         ? _CMP_LT_OQ
+                                      : Op == CompareOp::LessOrEqual  ? _CMP_LE_OQ
+                                      : Op == CompareOp::Greater      ? _CMP_GT_OQ
+                                                                      : _CMP_GE_OQ;
+            return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values), operand, predicate)));
+        }
+
+        inline __m256d Broadcast(double operand) {
+            return _mm256_set1_pd(operand);
+        }
+#elif defined(__SSE2__)
+        constexpr size_t LANES = 2;
+
+        template <CompareOp Op>
+        unsigned CompareLanes(const double* values, __m128d operand) {
+            const __m128d lanes = _mm_loadu_pd(values);
+            __m128d mask;
+            if constexpr (Op == CompareOp::Equal) {
+                mask = _mm_cmpeq_pd(lanes, operand);
+            } else if constexpr (Op == CompareOp::NotEqual) {
+                mask = _mm_and_pd(_mm_cmpneq_pd(lanes, operand), _mm_cmpord_pd(lanes, lanes));
+            } else if constexpr (Op == CompareOp::Less) {
+                mask = _mm_cmplt_pd(lanes, operand);
+            } else if constexpr (Op == CompareOp::LessOrEqual) {
+                mask = _mm_cmple_pd(lanes, operand);
+            } else if constexpr (Op == CompareOp::Greater) {
+                mask = _mm_cmpgt_pd(lanes, operand);
+            } else {
+                mask = _mm_cmpge_pd(lanes, operand);
+            }
+            return static_cast<unsigned>(_mm_movemask_pd(mask));
+        }
+
+        inline __m128d Broadcast(double operand) {
+            return _mm_set1_pd(operand);
+        }
+#endif
+
+        /// Fills the bitmap one 64-row word at a time: full words are compared in SIMD lanes,
+        /// the tail falls back to scalar comparisons
+        template <CompareOp Op>
+        void CompareNumbersImpl(const std::vector<double>& values, double operand, RowBitmap& result) {
+            const size_t count = values.size();
+            const size_t full_words = count / RowBitmap::WORD_BITS;
+            RowBitmap::Word* words = result.GetWords();
+
+#if defined(__AVX__) || defined(__SSE2__)
+            const auto lanes_operand = Broadcast(operand);
+            for (size_t word_idx = 0; word_idx < full_words; ++word_idx) {
+                const double* block = values.data() + word_idx * RowBitmap::WORD_BITS;
+                RowBitmap::Word word = 0;
+                for (size_t lane = 0; lane < RowBitmap::WORD_BITS; lane += LANES) {
+                    word |= static_cast<RowBitmap::Word>(CompareLanes<Op>(block + lane, lanes_operand)) << lane;
+                }
+                words[word_idx] = word;
+            }
+#else
+            for (size_t word_idx = 0; word_idx < full_words; ++word_idx) {
+                const double* block = values.data() + word_idx * RowBitmap::WORD_BITS;
+                RowBitmap::Word word = 0;
+                for (size_t bit = 0; bit < RowBitmap::WORD_BITS; ++bit) {
+                    word |= static_cast<RowBitmap::Word>(CompareScalar<Op>(block[bit], operand)) << bit;
+                }
+                words[word_idx] = word;
+            }
+#endif
+            for (size_t row = full_words * RowBitmap::WORD_BITS; row < count; ++row) {
+                result.Set(row, CompareScalar<Op>(values[row], operand));
+            }
+        }
+    }
+
+    void CompareNumbers(const std::vector<double>& values, CompareOp op, double operand, RowBitmap& result) {
+        assert(result.Size() == values.size());
+
+        switch (op) {
+        case CompareOp::Equal:
+            return CompareNumbersImpl<CompareOp::Equal>(values, operand, result);
+        case CompareOp::NotEqual:
+            return CompareNumbersImpl<CompareOp::NotEqual>(values, operand, result);
+        case CompareOp::Less:
+            return CompareNumbersImpl<CompareOp::Less>(values, operand, result);
+        case CompareOp::LessOrEqual:
+            return CompareNumbersImpl<CompareOp::LessOrEqual>(values, operand, result);
+        case CompareOp::Greater:
+            return CompareNumbersImpl<CompareOp::Greater>(values, operand, result);
+        case CompareOp::GreaterOrEqual:
+            return CompareNumbersImpl<CompareOp::GreaterOrEqual>(values, operand, result);
+        default:
+            assert(false);
+        }
+    }
+}
+
+namespace spreadsheet::query /* Group-by implementation */ {
+
+    namespace {
+        constexpr size_t MIN_ROWS_PER_THREAD = 4096;
+
+        /// Hashes and compares rows by their key columns, so hash tables are keyed by a row index
+        /// and no key is materialized while aggregating
+        class KeyColumns {
+        public:
+            explicit KeyColumns(const std::vector<const ColumnData*>& columns) : columns_(columns) {}
+
+            [[nodiscard]] bool IsEmpty(size_t row) const {
+                return std::all_of(columns_.begin(), columns_.end(), [row](const ColumnData* column) {
+                    return std::isnan(column->numbers[row]) && column->texts[row].data() == nullptr;
+                });
+            }
+
+            [[nodiscard]] size_t Hash(size_t row) const {
+                size_t hash = 0;
+                for (const ColumnData* column : columns_) {
+                    const double number = column->numbers[row];
+                    const size_t part = !std::isnan(number) ? std::hash<double>()(number + 0.0)  // -0.0 and 0.0 are one key
+                                                            : std::hash<std::string_view>()(column->texts[row]);
+                    hash = hash * 37 + part;
+                }
+                return hash;
+            }
+
+            [[nodiscard]] bool Equal(size_t lhs, size_t rhs) const {
+                return std::all_of(columns_.begin(), columns_.end(), [lhs, rhs](const ColumnData* column) {
+                    const double lhs_number = column->numbers[lhs];
+                    const double rhs_number = column->numbers[rhs];
+                    if (!std::isnan(lhs_number) || !std::isnan(rhs_number)) {
+                        return lhs_number == rhs_number;
+                    }
+                    return column->texts[lhs] == column->texts[rhs] && (column->texts[lhs].data() == nullptr) == (column->texts[rhs].data() == nullptr);
+                });
+            }
+
+        private:
+            const std::vector<const ColumnData*>& columns_;
+        };
+
+        struct Accumulator {
+            double sum = 0;
+            size_t count = 0;
+            double min = std::numeric_limits<double>::infinity();
+            double max = -std::numeric_limits<double>::infinity();
+
+            void Add(double value) {
+                if (!std::isnan(value)) {
+                    sum += value;
+                    ++count;
+                    min = std::min(min, value);
+                    max = std::max(max, value);
+                }
+            }
+
+            void Merge(const Accumulator& other) {
+                sum += other.sum;
+                count += other.count;
+                min = std::min(min, other.min);
+                max = std::max(max, other.max);
+            }
+
+            [[nodiscard]] double Get(AggregateKind kind) const {
+                const double none = std::nan("");
+                switch (kind) {
+                case AggregateKind::Sum:
+                    return sum;
+                case AggregateKind::Count:
+                    return static_cast<double>(count);
+                case AggregateKind::Min:
+                    return count > 0 ? min : none;
+                case AggregateKind::Max:
+                    return count > 0 ? max : none;
+                case AggregateKind::Average:
+                    return count > 0 ? sum / static_cast<double>(count) : none;
+                default:
+                    assert(false);
+                    return none;
+                }
+            }
+        };
+
+        /// Groups by their first row; accumulators are a row-major groups x values table
+        class HashTable {
+        private:
+            struct RowHash {
+                const KeyColumns* keys;
+                size_t operator()(size_t row) const {
+                    return keys->Hash(row);
+                }
+            };
+            struct RowEqual {
+                const KeyColumns* keys;
+                bool operator()(size_t lhs, size_t rhs) const {
+                    return keys->Equal(lhs, rhs);
+                }
+            };
+
+        public:
+            HashTable(const KeyColumns& keys, size_t value_columns) : index_(0, RowHash{&keys}, RowEqual{&keys}), value_columns_(value_columns) {}
+
+            /// Returns the group of the row, creating it if needed
+            size_t FindOrInsert(size_t row) {
+                const auto [group_it, inserted] = index_.emplace(row, first_rows.size());
+                if (inserted) {
+                    first_rows.push_back(row);
+                    rows.push_back(0);
+                    accumulators.resize(accumulators.size() + value_columns_);
+                }
+                return group_it->second;
+            }
+
+            Accumulator* GetAccumulators(size_t group) {
+                return accumulators.data() + group * value_columns_;
+            }
+
+            void Merge(HashTable& other) {
+                for (size_t other_group = 0; other_group < other.first_rows.size(); ++other_group) {
+                    const size_t group = FindOrInsert(other.first_rows[other_group]);
+                    first_rows[group] = std::min(first_rows[group], other.first_rows[other_group]);
+                    rows[group] += other.rows[other_group];
+
+                    Accumulator* accumulators = GetAccumulators(group);
+                    const Accumulator* other_accumulators = other.GetAccumulators(other_group);
+                    for (size_t i = 0; i < value_columns_; ++i) {
+                        accumulators[i].Merge(other_accumulators[i]);
+                    }
+                }
+            }
+
+        public:
+            std::vector<size_t> first_rows;
+            std::vector<size_t> rows;
+            std::vector<Accumulator> accumulators;
+
+        private:
+            std::unordered_map<size_t, size_t, RowHash, RowEqual> index_;
+            size_t value_columns_;
+        };
+
+        void AggregateRows(const KeyColumns& keys, const std::vector<std::pair<const ColumnData*, AggregateKind>>& values, const RowBitmap* filter,
+                           size_t begin, size_t end, HashTable& table) {
+            for (size_t row = begin; row < end; ++row) {
+                if ((filter != nullptr && !filter->Test(row)) || keys.IsEmpty(row)) {
+                    continue;
+                }
+
+                const size_t group = table.FindOrInsert(row);
+                ++table.rows[group];
+                Accumulator* accumulators = table.GetAccumulators(group);
+                for (size_t i = 0; i < values.size(); ++i) {
+                    accumulators[i].Add(values[i].first->numbers[row]);
+                }
+            }
+        }
+
+        CellInterface::Value GetKeyValue(const ColumnData& column, size_t row) {
+            if (const std::string_view text = column.texts[row]; text.data() != nullptr) {
+                return std::string(text);
+            }
+            if (const double number = column.numbers[row]; !std::isnan(number)) {
+                return number;
+            }
+            return std::string();
+        }
+    }
+
+    size_t GroupTable::GetGroupCount() const {
+        return rows.size();
+    }
+
+    void GroupTable::WriteTo(Sheet& sheet, Position position) const {
+        const auto to_text = [](const CellInterface::Value& value) -> std::string {
+            if (const double* number = std::get_if<double>(&value); number != nullptr) {
+                if (std::isnan(*number)) {
+                    return {};
+                }
+                /// The shortest text that reads back as the same number
+                std::array<char, 32> buffer;
+                const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), *number);
+                return std::string(buffer.data(), result.ptr);
+            }
+            const std::string& text = std::get<std::string>(value);
+            return !text.empty() && (text[0] == FORMULA_SIGN || text[0] == ESCAPE_SIGN) ? ESCAPE_SIGN + text : text;
+        };
+
+        for (size_t group = 0; group < GetGroupCount(); ++group) {
+            Position pos{position.row + static_cast<int>(group), position.col};
+            for (size_t i = 0; i < key_columns; ++i, ++pos.col) {
+                sheet.SetCell(pos, to_text(keys[group * key_columns + i]));
+            }
+            for (size_t i = 0; i < value_columns; ++i, ++pos.col) {
+                sheet.SetCell(pos, to_text(values[group * value_columns + i]));
+            }
+        }
+    }
+
+    GroupTable GroupBy(const std::vector<const ColumnData*>& keys, const std::vector<std::pair<const ColumnData*, AggregateKind>>& values,
+                       const RowBitmap* filter, size_t threads) {
+        assert(!keys.empty());
+        const size_t row_count = keys.front()->numbers.size();
+
+        const KeyColumns key_columns(keys);
+        threads = std::clamp<size_t>(row_count / MIN_ROWS_PER_THREAD, 1, parallel::ResolveThreadCount(threads));
+
+        /// Aggregate chunks into thread-local tables
+        std::vector<HashTable> tables(threads, HashTable(key_columns, values.size()));
+        const size_t chunk = (row_count + threads - 1) / threads;
+        parallel::ForEachIndex(threads, [&](size_t i) {
+            AggregateRows(key_columns, values, filter, std::min(row_count, i * chunk), std::min(row_count, (i + 1) * chunk), tables[i]);
+        });
+
+        HashTable& table = tables.front();
+        std::for_each(std::next(tables.begin()), tables.end(), [&table](HashTable& other) { table.Merge(other); });
+
+        /// Order groups by the first appearance of their keys
+        std::vector<size_t> order(table.first_rows.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&table](size_t lhs, size_t rhs) { return table.first_rows[lhs] < table.first_rows[rhs]; });
+
+        GroupTable result{keys.size(), values.size()};
+        result.keys.reserve(order.size() * keys.size());
+        result.values.reserve(order.size() * values.size());
+        result.rows.reserve(order.size());
+        for (const size_t group : order) {
+            const size_t row = table.first_rows[group];
+            for (const ColumnData* key : keys) {
+                result.keys.push_back(GetKeyValue(*key, row));
+            }
+            const Accumulator* accumulators = table.GetAccumulators(group);
+            for (size_t i = 0; i < values.size(); ++i) {
+                result.values.push_back(accumulators[i].Get(values[i].second));
+            }
+            result.rows.push_back(table.rows[group]);
+        }
+        return result;
+    }
+}
+
+namespace spreadsheet::query /* Query implementation */ {
+
+    namespace {
+        bool CompareTexts(CompareOp op, std::string_view value, std::string_view operand) {
+            switch (op) {
+            case CompareOp::Equal:
+                return value == operand;
+            case CompareOp::NotEqual:
+                return value != operand;
+            case CompareOp::Less:
+                return value < operand;
+            case CompareOp::LessOrEqual:
+                return value <= operand;
+            case CompareOp::Greater:
+                return value > operand;
+            case CompareOp::GreaterOrEqual:
+                return value >= operand;
+            default:
+                assert(false);
+                return false;
+            }
+        }
+    }
+
+    Query::Query(const Sheet& sheet) : sheet_(sheet) {}
+
+    RowBitmap Query::Select(const Predicate& predicate) {
+        const ColumnData& column = GetColumn(predicate.col);
+        RowBitmap result(column.numbers.size());
+
+        if (const double* number = std::get_if<double>(&predicate.operand); number != nullptr) {
+            CompareNumbers(column.numbers, predicate.op, *number, result);
+            return result;
+        }
+
+        const std::string_view text = std::get<std::string>(predicate.operand);
+        for (size_t row = 0; row < column.texts.size(); ++row) {
+            if (const std::string_view value = column.texts[row]; value.data() != nullptr && CompareTexts(predicate.op, value, text)) {
+                result.Set(row);
+            }
+        }
+        return result;
+    }
+
+    RowBitmap Query::SelectAll(const std::vector<Predicate>& predicates) {
+        RowBitmap result(static_cast<size_t>(sheet_.GetPrintableSize().rows), true);
+        for (const Predicate& predicate : predicates) {
+            result &= Select(predicate);
+        }
+        return result;
+    }
+
+    RowBitmap Query::SelectAny(const std::vector<Predicate>& predicates) {
+        RowBitmap result(static_cast<size_t>(sheet_.GetPrintableSize().rows));
+        for (const Predicate& predicate : predicates) {
+            result |= Select(predicate);
+        }
+        return result;
+    }
+
+    GroupTable Query::GroupBy(const std::vector<int>& key_cols, const std::vector<Aggregate>& aggregates, const RowBitmap* filter, size_t threads) {
+        /// Columns are extracted sequentially, aggregation only reads them
+        std::vector<const ColumnData*> keys;
+        std::transform(key_cols.begin(), key_cols.end(), std::back_inserter(keys), [this](int col) { return &GetColumn(col); });
+
+        std::vector<std::pair<const ColumnData*, AggregateKind>> values;
+        std::transform(aggregates.begin(), aggregates.end(), std::back_inserter(values), [this](const Aggregate& aggregate) {
+            return std::pair{&GetColumn(aggregate.col), aggregate.kind};
+        });
+        return query::GroupBy(keys, values, filter, threads);
+    }
+
+    const ColumnData& Query::GetColumn(int col) {
+        auto column_it = columns_.find(col);
+        if (column_it == columns_.end()) {
+            column_it = columns_.emplace(col, sheet_.ExtractColumn(col)).first;
+        }
+        return column_it->second;
+    }
+}
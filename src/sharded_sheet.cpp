@@ -0,0 +1,329 @@
+#include "sharded_sheet.h"
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "formula.h"
+
+namespace spreadsheet /* ShardedSheet implementation public methods */ {
+
+    namespace {
+        /// Bands the current thread holds shared locks of, see `ShardedSheet::ReadLock`
+        thread_local std::vector<const void*> held_shards;
+
+        void ValidatePosition(const Position& pos) {
+            if (!pos.IsValid()) {
+                throw InvalidPositionException("Invalid cell position");
+            }
+        }
+    }
+
+    ShardedSheet::ShardedSheet(int band_rows)
+        : band_rows_(std::clamp(band_rows, 1, int{Position::MAX_ROWS})), links_((Position::MAX_ROWS + band_rows_ - 1) / band_rows_) {
+        for (int first_row = 0; first_row < Position::MAX_ROWS; first_row += band_rows_) {
+            const size_t index = shards_.size();
+            Region region;
+            region.rect = {{first_row, 0}, {std::min(band_rows_, Position::MAX_ROWS - first_row), Position::MAX_COLS}};
+            region.read_outside = [this](Position pos) { return ReadOutside_(pos); };
+            region.check_references = [this, index](const Rect& cells, const std::vector<Position>& refs, const std::vector<SheetReference>&) {
+                CheckReferences_(index, cells.position, refs);
+            };
+            region.invalidated = [this, index](const std::vector<Position>& positions) { links_.Invalidated(index, positions); };
+            shards_.push_back(std::make_unique<Shard>(std::move(region)));
+        }
+    }
+
+    ShardedSheet::~ShardedSheet() = default;
+
+    void ShardedSheet::SetCell(Position pos, std::string text) {
+        ValidatePosition(pos);
+        if (!WriteBand_(GetShardIndex_(pos), [&](Shard& shard) { shard.sheet.SetCell(pos, text); })) {
+            SetCellsCoordinated_({{pos, std::move(text)}});
+        }
+    }
+
+    void ShardedSheet::SetCells(std::vector<std::pair<Position, std::string>> cells) {
+        std::map<size_t, std::vector<std::pair<Position, std::string>>> bands;
+        for (auto& item : cells) {
+            ValidatePosition(item.first);
+            bands[GetShardIndex_(item.first)].push_back(std::move(item));
+        }
+
+        std::vector<std::pair<Position, std::string>> coordinated;
+        for (auto& [index, band_cells] : bands) {
+            if (!WriteBand_(index, [&band_cells = band_cells](Shard& shard) { shard.sheet.SetCells(band_cells); })) {
+                std::move(band_cells.begin(), band_cells.end(), std::back_inserter(coordinated));
+            }
+        }
+        if (!coordinated.empty()) {
+            SetCellsCoordinated_(std::move(coordinated));
+        }
+    }
+
+    void ShardedSheet::ClearCell(Position pos) {
+        ValidatePosition(pos);
+        const size_t index = GetShardIndex_(pos);
+        const bool written = WriteBand_(index, [&](Shard& shard) {
+            if (HasRemoteReferences_(pos)) {
+                throw NeedsCoordination{};
+            }
+            shard.sheet.ClearCell(pos);
+        });
+        if (written) {
+            return;
+        }
+
+        const std::lock_guard topology(topology_);
+        shards_[index]->sheet.ClearCell(pos);
+        links_.Unlink({index, pos});
+        InvalidateReaders_(links_.TakeReaders(index));
+    }
+
+    CellInterface::Value ShardedSheet::GetValue(Position pos) const {
+        ValidatePosition(pos);
+        const std::shared_lock topology(topology_);
+        return ReadOutside_(pos);
+    }
+
+    std::string ShardedSheet::GetText(Position pos) const {
+        ValidatePosition(pos);
+        const std::shared_lock topology(topology_);
+        const Shard& shard = GetShard_(pos);
+        const ReadLock lock(shard);
+        const Cell* cell = shard.sheet.GetCell(pos);
+        return cell != nullptr ? cell->GetText() : std::string();
+    }
+
+    Size ShardedSheet::GetPrintableSize() const {
+        const std::shared_lock topology(topology_);
+        Size size;
+        for (const auto& shard : shards_) {
+            const ReadLock lock(*shard);
+            const Size band_size = shard->sheet.GetPrintableSize();
+            size.rows = std::max(size.rows, band_size.rows);
+            size.cols = std::max(size.cols, band_size.cols);
+        }
+        return size;
+    }
+
+    size_t ShardedSheet::GetShardCount() const {
+        return shards_.size();
+    }
+}
+
+namespace spreadsheet /* ShardedSheet implementation private methods */ {
+
+    ShardedSheet::ReadLock::ReadLock(const Shard& shard) {
+        if (std::find(held_shards.begin(), held_shards.end(), &shard) == held_shards.end()) {
+            shard.mutex.lock_shared();
+            held_shards.push_back(&shard);
+            shard_ = &shard;
+        }
+    }
+
+    ShardedSheet::ReadLock::ReadLock(const Shard& shard, std::try_to_lock_t) {
+        if (std::find(held_shards.begin(), held_shards.end(), &shard) == held_shards.end()) {
+            held_ = shard.mutex.try_lock_shared();
+            if (held_) {
+                held_shards.push_back(&shard);
+                shard_ = &shard;
+            }
+        }
+    }
+
+    ShardedSheet::ReadLock::~ReadLock() {
+        if (shard_ != nullptr) {
+            held_shards.erase(std::find(held_shards.begin(), held_shards.end(), shard_));
+            shard_->mutex.unlock_shared();
+        }
+    }
+
+    bool ShardedSheet::ReadLock::IsHeld() const {
+        return held_;
+    }
+
+    size_t ShardedSheet::GetShardIndex_(const Position& pos) const {
+        return static_cast<size_t>(pos.row / band_rows_);
+    }
+
+    ShardedSheet::Shard& ShardedSheet::GetShard_(const Position& pos) const {
+        return *shards_[GetShardIndex_(pos)];
+    }
+
+    bool ShardedSheet::WriteBand_(size_t index, const std::function<void(Shard&)>& write) {
+        const std::shared_lock topology(topology_);
+        Shard& shard = *shards_[index];
+        CrossLinks::Readers readers;
+        {
+            const std::lock_guard lock(shard.mutex);
+            try {
+                write(shard);
+            } catch (const NeedsCoordination&) {
+                return false;
+            }
+            readers = links_.TakeReaders(index);
+        }
+        InvalidateReaders_(std::move(readers));
+        return true;
+    }
+
+    void ShardedSheet::CheckReferences_(size_t index, const Position& pos, const std::vector<Position>& refs) const {
+        if (coordinating_) {
+            return;
+        }
+
+        /// A band referencing other bands and referenced by them may close a cycle through them with local references only
+        const bool remote = std::any_of(refs.begin(), refs.end(), [&](const Position& ref) { return GetShardIndex_(ref) != index; });
+        const bool may_close_cycle = !refs.empty() && links_.HasReferences(index) && links_.HasReaders(index);
+        if (remote || may_close_cycle || HasRemoteReferences_(pos)) {
+            throw NeedsCoordination{};
+        }
+    }
+
+    CellInterface::Value ShardedSheet::ReadOutside_(const Position& pos) const {
+        const size_t index = GetShardIndex_(pos);
+        const Shard& shard = *shards_[index];
+        if (!held_shards.empty()) {
+            /// Waiting here could deadlock: the thread holds other bands and may compute values other readers wait for
+            const ReadLock lock(shard, std::try_to_lock);
+            if (!lock.IsHeld()) {
+                throw LockConflict{index};
+            }
+            return shard.sheet.GetValue(pos);
+        }
+
+        /// Values computed before a conflict stay computed, the next attempt reads them
+        std::set<size_t> bands = {index};
+        while (true) {
+            std::deque<ReadLock> locks;
+            std::for_each(bands.begin(), bands.end(), [&](size_t band) { locks.emplace_back(*shards_[band]); });
+            try {
+                return shard.sheet.GetValue(pos);
+            } catch (const LockConflict& conflict) {
+                bands.insert(conflict.band);
+            }
+        }
+    }
+
+    void ShardedSheet::SetCellsCoordinated_(std::vector<std::pair<Position, std::string>> cells) {
+        const std::lock_guard topology(topology_);
+
+        /// References of the new contents, the last write to a position wins
+        std::unordered_map<Position, std::vector<Position>, graph::Hasher> new_refs;
+        for (const auto& [pos, text] : cells) {
+            std::vector<Position> refs;
+            if (text.length() > 1 && text[0] == FORMULA_SIGN) {
+                refs = ParseFormula(text.substr(1))->GetReferencedCells();
+                std::erase_if(refs, [](const Position& ref) { return !ref.IsValid(); });
+            }
+            new_refs.insert_or_assign(pos, std::move(refs));
+        }
+        if (DetectCircularDependency_(new_refs)) {
+            throw CircularDependencyException("Has circular dependency");
+        }
+
+        /// Nothing below throws for a cycle or a bad formula, so bands change only after all checks passed
+        std::map<size_t, std::vector<std::pair<Position, std::string>>> bands;
+        for (auto& item : cells) {
+            bands[GetShardIndex_(item.first)].push_back(std::move(item));
+        }
+        coordinating_ = true;
+        try {
+            for (auto& [index, band_cells] : bands) {
+                shards_[index]->sheet.SetCells(std::move(band_cells));
+            }
+        } catch (...) {
+            coordinating_ = false;
+            throw;
+        }
+        coordinating_ = false;
+
+        for (const auto& [pos, refs] : new_refs) {
+            LinkRemote_(pos, refs);
+        }
+        CrossLinks::Readers readers;
+        for (const auto& [index, band_cells] : bands) {
+            for (auto& [reader_band, positions] : links_.TakeReaders(index)) {
+                auto& band_readers = readers[reader_band];
+                band_readers.insert(band_readers.end(), positions.begin(), positions.end());
+            }
+        }
+        InvalidateReaders_(std::move(readers));
+    }
+
+    bool ShardedSheet::DetectCircularDependency_(const std::unordered_map<Position, std::vector<Position>, graph::Hasher>& new_refs) const {
+        /// Iterative depth-first search over references within bands, references across them and the new ones
+        enum class Mark { open, closed };
+        std::unordered_map<Position, Mark, graph::Hasher> marks;
+        std::vector<std::pair<Position, std::vector<Position>>> stack;
+
+        const auto get_refs = [&](const Position& pos) {
+            if (const auto it = new_refs.find(pos); it != new_refs.end()) {
+                return it->second;
+            }
+            const Shard& shard = GetShard_(pos);
+            std::vector<Position> refs;
+            for (const graph::Edge& edge : shard.sheet.GetGraph().GetIncidentEdges(pos, graph::DependencyGraph::Direction::forward)) {
+                refs.push_back(edge.to);
+            }
+            const auto& remote = links_.GetReferences({GetShardIndex_(pos), pos});
+            std::transform(remote.begin(), remote.end(), std::back_inserter(refs), [](const RegionCell& ref) { return ref.pos; });
+            return refs;
+        };
+
+        for (const auto& [start, start_refs] : new_refs) {
+            if (marks.count(start) > 0) {
+                continue;
+            }
+            marks.emplace(start, Mark::open);
+            stack.emplace_back(start, get_refs(start));
+            while (!stack.empty()) {
+                auto& [pos, refs] = stack.back();
+                if (refs.empty()) {
+                    marks[pos] = Mark::closed;
+                    stack.pop_back();
+                    continue;
+                }
+                const Position next = refs.back();
+                refs.pop_back();
+                if (const auto mark = marks.find(next); mark != marks.end()) {
+                    if (mark->second == Mark::open) {
+                        return true;
+                    }
+                    continue;
+                }
+                marks.emplace(next, Mark::open);
+                stack.emplace_back(next, get_refs(next));
+            }
+        }
+        return false;
+    }
+
+    void ShardedSheet::LinkRemote_(const Position& pos, const std::vector<Position>& refs) {
+        const size_t index = GetShardIndex_(pos);
+        std::vector<RegionCell> remote;
+        for (const Position& ref : refs) {
+            if (const size_t ref_index = GetShardIndex_(ref); ref_index != index) {
+                remote.push_back({ref_index, ref});
+            }
+        }
+        links_.Link({index, pos}, std::move(remote));
+    }
+
+    bool ShardedSheet::HasRemoteReferences_(const Position& pos) const {
+        return !links_.GetReferences({GetShardIndex_(pos), pos}).empty();
+    }
+
+    void ShardedSheet::InvalidateReaders_(CrossLinks::Readers readers) {
+        CrossLinks::InvalidateReaders(std::move(readers), [this](size_t index, const std::vector<Position>& positions) {
+            Shard& shard = *shards_[index];
+            const std::lock_guard lock(shard.mutex);
+            shard.sheet.InvalidateCells(positions);
+            return links_.TakeReaders(index);
+        });
+    }
+}
@@ -1,93 +1,561 @@
 #include "sheet.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <memory>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include "cell.h"
 #include "common.h"
+#include "formula.h"
 #include "graph.h"
+#include "parallel.h"
+
+namespace {
+
+    /// Throws the exception the throwing counterpart of a `Try*` method reports the rejected edit with
+    void ThrowIfRejected(const spreadsheet::EditResult& result) {
+        using spreadsheet::EditStatus;
+        switch (result.status) {
+        case EditStatus::ok:
+            return;
+        case EditStatus::invalid_position:
+            throw InvalidPositionException(std::string(result.message));
+        case EditStatus::syntax_error:
+            throw FormulaException(std::string(result.message));
+        case EditStatus::circular_dependency:
+            throw CircularDependencyException(std::string(result.message));
+        case EditStatus::array_conflict:
+            throw ArrayFormulaException(std::string(result.message));
+        }
+    }
+}
 
 namespace spreadsheet /* Sheet implementation public methods */ {
 
     using namespace std::literals;
 
+    Sheet::Sheet(Region region) : region_(std::move(region)) {}
+
     void Sheet::SetCell(Position pos, std::string text) {
-        const auto prepare_graph = [&](std::vector<Position>&& refs) {
-            InvalidateCache_(pos);
-            graph_.EraseVertex(pos);
+        ThrowIfRejected(TrySetCell(pos, std::move(text)));
+    }
 
-            std::for_each(std::move_iterator(refs.begin()), std::move_iterator(refs.end()), [&](const Position& ref) {
-                if (!GetCell(ref)) {
-                    SetCell(ref, "");
-                }
-                graph_.AddEdge({pos, ref});
-            });
-        };
+    EditResult Sheet::TrySetCell(Position pos, std::string text) {
+        EditResult result;
+        try {
+            result = SetCell_(pos, std::move(text));
+        } catch (const FormulaException&) {
+            /// Not expected: `CheckFormula` rejects everything the parser does
+            return {EditStatus::syntax_error, 0, "Invalid formula"};
+        }
+        if (result.IsOk()) {
+            versions_->Commit();
+            RecalculateIfEager_();
+        }
+        return result;
+    }
 
-        ValidatePosition_(pos);
+    EditResult Sheet::SetCell_(Position pos, std::string text) {
+        if (!pos.IsValid()) {
+            return {EditStatus::invalid_position, 0, "Invalid cell position"};
+        }
 
-        /// Resize sheet
-        size_.rows = pos.row - size_.rows >= 0 ? pos.row + 1 : size_.rows;
-        size_.cols = pos.col - size_.cols >= 0 ? pos.col + 1 : size_.cols;
+        /// Only the anchor of an array may be overwritten, it replaces the whole array
+        const auto array_it = FindArray_(pos);
+        const bool replaces_array = array_it != arrays_.end();
+        if (replaces_array && !(array_it->first == pos)) {
+            return {EditStatus::array_conflict, 0, "Cannot change part of an array"};
+        }
+
+        /// Resize sheet, once the edit is accepted
+        const Size size{std::max(size_.rows, pos.row + 1), std::max(size_.cols, pos.col + 1)};
 
         /// Check cell with this position and value already exists
-        auto rows_it = sheet_.find(pos.row);
-        const auto cells_it = rows_it != sheet_.end() ? rows_it->second.find(pos.col) : rows_it->second.end();
-        if (cells_it != rows_it->second.end() && cells_it->second->GetText() == text) {
-            return;
+        if (const Cell* cell = GetConstCell_(pos); cell != nullptr && cell->GetText() == text) {
+            size_ = size;
+            return {};
+        }
+
+        /// Bad formulas are rejected before the parser sees them: unwinding it costs more than the check
+        if (text.length() > 1 && text[0] == FORMULA_SIGN) {
+            if (const auto error = CheckFormula(std::string_view(text).substr(1)); error.has_value()) {
+                return {EditStatus::syntax_error, static_cast<std::uint32_t>(error->offset + 1), error->message};
+            }
         }
 
         /// Create temp cell object
         auto tmp_cell = std::make_unique<Cell>(*this);
         tmp_cell->Set(std::move(text));
-        auto cell_refs = tmp_cell->GetReferencedCells();
+        auto refs = tmp_cell->GetReferencedCells();
+        if (region_ != std::nullopt && region_->check_references) {
+            region_->check_references({pos, {1, 1}}, refs, tmp_cell->GetSheetReferences());
+        }
+        auto cell_refs = ResolveReferences_(std::move(refs), replaces_array ? pos : Position::NONE);
 
         if (graph_.DetectCircularDependency(pos, cell_refs)) {
-            throw CircularDependencyException("Has circular dependency");
+            return {EditStatus::circular_dependency, 0, "Has circular dependency"};
+        }
+
+        const Rect replaced = replaces_array ? array_it->second : Rect{};
+        if (replaces_array) {
+            EraseArray_(array_it);
         }
+        size_ = size;
 
         /// Build graph (and empty cells if needed)
-        prepare_graph(std::move(cell_refs));
+        InvalidateCache_(pos);
+        LinkCell_(pos, std::move(cell_refs));
 
         /// Append created cell to sheet
-        rows_it = rows_it != sheet_.end() ? rows_it : sheet_.emplace(pos.row, ColumnItem()).first;
-        if (cells_it != rows_it->second.end()) {
-            cells_it->second = std::move(tmp_cell);
+        sheet_[pos.row][pos.col] = std::move(tmp_cell);
+
+        /// Formulas that referenced spilled cells of the replaced array depend on them directly again
+        if (replaces_array) {
+            RelinkDependents_(pos);
+            Publish_(replaced);
         } else {
-            rows_it->second.emplace(pos.col, std::move(tmp_cell));
+            Publish_(pos);
+        }
+        return {};
+    }
+
+    void Sheet::SetCells(std::vector<std::pair<Position, std::string>> cells) {
+        /// The last write to a position wins
+        std::unordered_map<Position, size_t, graph::Hasher> last_writes;
+        last_writes.reserve(cells.size());
+        for (size_t i = 0; i < cells.size(); ++i) {
+            const Position& pos = cells[i].first;
+            ValidatePosition_(pos);
+            if (FindArray_(pos) != arrays_.end()) {
+                throw ArrayFormulaException("Cannot change part of an array");
+            }
+            last_writes.insert_or_assign(pos, i);
+        }
+
+        /// Everything is parsed and checked before the first change, so a failed batch changes nothing
+        std::vector<std::pair<Position, std::unique_ptr<Cell>>> new_cells;
+        std::unordered_map<Position, std::vector<Position>, graph::Hasher> new_refs;
+        new_cells.reserve(last_writes.size());
+        new_refs.reserve(last_writes.size());
+        for (size_t i = 0; i < cells.size(); ++i) {
+            auto& [pos, text] = cells[i];
+            if (last_writes.at(pos) != i) {
+                continue;
+            }
+            if (const Cell* cell = GetConstCell_(pos); cell != nullptr && cell->GetText() == text) {
+                continue;
+            }
+            auto tmp_cell = std::make_unique<Cell>(*this);
+            tmp_cell->Set(std::move(text));
+            auto refs = tmp_cell->GetReferencedCells();
+            if (region_ != std::nullopt && region_->check_references) {
+                region_->check_references({pos, {1, 1}}, refs, tmp_cell->GetSheetReferences());
+            }
+            new_refs.emplace(pos, ResolveReferences_(std::move(refs), Position::NONE));
+            new_cells.emplace_back(pos, std::move(tmp_cell));
+        }
+        if (DetectCircularDependency_(new_refs)) {
+            throw CircularDependencyException("Has circular dependency");
+        }
+
+        std::vector<Position> positions;
+        positions.reserve(new_cells.size());
+        std::transform(new_cells.begin(), new_cells.end(), std::back_inserter(positions), [](const auto& item) { return item.first; });
+        InvalidateCache_(positions);
+
+        /// Cells are replaced first and linked afterwards: the graph never holds old and new references of the batch at once
+        const auto place = [this](const Position& pos, std::unique_ptr<Cell> cell) {
+            size_.rows = std::max(size_.rows, pos.row + 1);
+            size_.cols = std::max(size_.cols, pos.col + 1);
+            sheet_[pos.row][pos.col] = std::move(cell);
+            Publish_(pos);
+        };
+        std::for_each(std::move_iterator(new_cells.begin()), std::move_iterator(new_cells.end()), [&](auto&& item) {
+            place(item.first, std::move(item.second));
+        });
+        for (const auto& [pos, refs] : new_refs) {
+            for (const Position& ref : refs) {
+                if (GetConstCell_(ref) == nullptr) {
+                    auto empty_cell = std::make_unique<Cell>(*this);
+                    empty_cell->Set("");
+                    place(ref, std::move(empty_cell));
+                }
+            }
+        }
+
+        /// A batch covering most of the graph is added in bulk, see `DependencyGraph::AddEdges`
+        graph::EdgeContainer edges;
+        for (const auto& [pos, refs] : new_refs) {
+            std::transform(refs.begin(), refs.end(), std::back_inserter(edges), [&pos = pos](const Position& ref) { return graph::Edge{pos, ref}; });
+        }
+        std::for_each(positions.begin(), positions.end(), [this](const Position& pos) { graph_.EraseVertex(pos); });
+        graph_.AddEdges(edges.begin(), edges.end());
+        versions_->Commit();
+        RecalculateIfEager_();
+    }
+
+    void Sheet::SetArrayFormula(Rect rect, std::string text) {
+        if (!rect.IsValid()) {
+            throw InvalidPositionException("Invalid array formula block");
+        }
+        const Position& anchor = rect.position;
+
+        /// Create temp anchor cell object
+        auto tmp_cell = std::make_unique<Cell>(*this);
+        tmp_cell->SetArray(rect.size, std::move(text));
+
+        /// The block may overwrite only empty cells and the array previously anchored at the same position
+        const bool overlaps_array = std::any_of(arrays_.begin(), arrays_.end(), [&rect](const auto& item) {
+            return !(item.second.position == rect.position) && item.second.Intersects(rect);
+        });
+        const auto block_cells = GetCellsInRect_(rect);
+        const bool overlaps_cells = std::any_of(block_cells.begin(), block_cells.end(), [&](const Position& pos) {
+            return !(pos == anchor) && !GetConstCell_(pos)->GetText().empty();
+        });
+        if (overlaps_array || overlaps_cells) {
+            throw ArrayFormulaException("Array formula spills into non-empty cells");
+        }
+
+        /// The block must not depend on itself, neither directly nor through formulas referencing its cells
+        const auto refs = tmp_cell->GetReferencedCells();
+        if (region_ != std::nullopt && region_->check_references) {
+            region_->check_references(rect, refs, tmp_cell->GetSheetReferences());
+        }
+        auto cell_refs = ResolveReferences_(refs, anchor);
+        const bool reaches_block = graph_.Search(
+            cell_refs, graph::Traverser::Order::depth_first, [&rect](const Position&, const Position& to) { return rect.Contains(to); },
+            graph::DependencyGraph::Direction::forward);
+        if (reaches_block || std::any_of(refs.begin(), refs.end(), [&rect](const Position& ref) { return rect.Contains(ref); })) {
+            throw CircularDependencyException("Has circular dependency");
+        }
+
+        /// Collect formulas referencing the block, they will depend on the anchor
+        std::vector<Position> dependents;
+        std::for_each(block_cells.begin(), block_cells.end(), [&](const Position& pos) {
+            InvalidateCache_(pos);
+            for (const graph::Edge& edge : graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::backward)) {
+                if (!rect.Contains(edge.to)) {
+                    dependents.push_back(edge.to);
+                }
+            }
+        });
+
+        /// Spilled positions have no cell objects
+        std::for_each(block_cells.begin(), block_cells.end(), [&](const Position& pos) {
+            const auto row_ptr = sheet_.find(pos.row);
+            if (row_ptr->second.size() == 1) {
+                sheet_.erase(row_ptr);
+            } else {
+                row_ptr->second.erase(pos.col);
+            }
+        });
+
+        const auto replaced = arrays_.find(anchor);
+        const Rect replaced_rect = replaced != arrays_.end() ? replaced->second : Rect{};
+        AddArray_(anchor, rect);
+        LinkCell_(anchor, std::move(cell_refs));
+        sheet_[anchor.row][anchor.col] = std::move(tmp_cell);
+        if (region_ != std::nullopt && region_->invalidated) {
+            /// Positions of the block that had no cells have readers elsewhere too
+            region_->invalidated({anchor});
+        }
+        Publish_(replaced_rect);
+        Publish_(rect);
+
+        std::for_each(dependents.begin(), dependents.end(), [&](const Position& pos) {
+            if (const Cell* cell = GetConstCell_(pos); cell != nullptr) {
+                LinkCell_(pos, ResolveReferences_(cell->GetReferencedCells(), Position::NONE));
+            }
+        });
+
+        /// Resize sheet
+        size_.rows = std::max(size_.rows, anchor.row + rect.size.rows);
+        size_.cols = std::max(size_.cols, anchor.col + rect.size.cols);
+        versions_->Commit();
+        RecalculateIfEager_();
+    }
+
+    void Sheet::SortRange(Rect rect, const std::vector<SortKey>& keys, size_t threads) {
+        if (!rect.IsValid()) {
+            throw InvalidPositionException("Invalid sort range");
+        }
+        if (keys.empty() || std::any_of(keys.begin(), keys.end(), [&rect](const SortKey& key) {
+                return !rect.Contains({rect.position.row, key.col});
+            })) {
+            throw InvalidPositionException("Sort key is outside of the range");
+        }
+        if (std::any_of(arrays_.begin(), arrays_.end(), [&rect](const auto& array) { return array.second.Intersects(rect); })) {
+            throw ArrayFormulaException("Cannot change part of an array");
+        }
+
+        /// Rows below the printable area are empty and stay in place
+        const int first_row = rect.position.row;
+        const int row_count = std::min(rect.position.row + rect.size.rows, size_.rows) - first_row;
+        if (row_count <= 1) {
+            return;
+        }
+
+        const std::vector<int> order = SortRows_(first_row, row_count, keys, threads);
+        std::vector<int> new_offsets(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            new_offsets[order[i]] = static_cast<int>(i);
+        }
+        if (std::is_sorted(order.begin(), order.end())) {
+            return;
+        }
+
+        const Rect sorted{rect.position, {row_count, rect.size.cols}};
+        const auto remap = [&](Position pos) -> Position {
+            return sorted.Contains(pos) ? Position{first_row + new_offsets[pos.row - first_row], pos.col} : pos;
+        };
+
+        /// Moved cells, formulas among them and formulas referencing them have to be relinked
+        std::vector<Position> moved;
+        std::unordered_set<Position, graph::Hasher> affected;
+        for (int row = first_row; row < first_row + row_count; ++row) {
+            const auto row_ptr = sheet_.find(row);
+            if (row_ptr == sheet_.end()) {
+                continue;
+            }
+            for (const auto& [col, cell] : row_ptr->second) {
+                if (const Position pos{row, col}; sorted.Contains(pos)) {
+                    moved.push_back(pos);
+                    if (const auto refs = graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::forward); refs.begin() != refs.end()) {
+                        affected.insert(pos);
+                    }
+                    for (const graph::Edge& edge : graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::backward)) {
+                        affected.insert(edge.to);
+                    }
+                }
+            }
         }
+        /// Relinking most of the formulas one by one costs more than building the graph again
+        const bool rebuild_graph = affected.size() * 4 > graph_.GetVertexCount();
+        if (!rebuild_graph) {
+            std::for_each(affected.begin(), affected.end(), [&](const Position& pos) { graph_.EraseVertex(pos); });
+        }
+
+        /// Move cell objects to their new rows
+        std::vector<std::pair<Position, std::unique_ptr<Cell>>> moved_cells;
+        moved_cells.reserve(moved.size());
+        std::for_each(moved.begin(), moved.end(), [&](const Position& pos) {
+            const auto row_ptr = sheet_.find(pos.row);
+            moved_cells.emplace_back(remap(pos), std::move(row_ptr->second.at(pos.col)));
+            row_ptr->second.erase(pos.col);
+        });
+        std::for_each(std::move_iterator(moved_cells.begin()), std::move_iterator(moved_cells.end()), [&](auto&& item) {
+            sheet_[item.first.row][item.first.col] = std::move(item.second);
+        });
+        std::erase_if(sheet_, [](const auto& row) { return row.second.empty(); });
+
+        /// Rewrite references and patch the graph; formulas over ranges of the block see other values
+        std::vector<Position> recalculated;
+        std::for_each(affected.begin(), affected.end(), [&](const Position& old_pos) {
+            const Position pos = remap(old_pos);
+            Cell* cell = sheet_.at(pos.row).at(pos.col).get();
+            cell->RemapReferences(remap);
+
+            if (!rebuild_graph) {
+                const auto cell_refs = ResolveReferences_(cell->GetReferencedCells(), arrays_.count(pos) > 0 ? pos : Position::NONE);
+                std::for_each(cell_refs.begin(), cell_refs.end(), [&](const Position& ref) { graph_.AddEdge({pos, ref}); });
+            }
+
+            const auto ranges = cell->GetReferencedRanges();
+            if (std::any_of(ranges.begin(), ranges.end(), [&sorted](const Rect& range) { return range.Intersects(sorted); })) {
+                recalculated.push_back(pos);
+            }
+        });
+        if (rebuild_graph) {
+            RebuildGraph_();
+        }
+        std::for_each(recalculated.begin(), recalculated.end(), [&](const Position& pos) {
+            InvalidateCache_(pos);
+            sheet_.at(pos.row).at(pos.col)->ClearCache();
+        });
+
+        /// Vacated and filled positions, and formulas whose references were rewritten
+        std::for_each(moved.begin(), moved.end(), [&](const Position& pos) {
+            Publish_(pos);
+            Publish_(remap(pos));
+        });
+        std::for_each(affected.begin(), affected.end(), [&](const Position& old_pos) { Publish_(remap(old_pos)); });
+        versions_->Commit();
+
+        CalculateSize_({size_.rows - 1, size_.cols - 1});
+        RecalculateIfEager_();
     }
 
     const Cell* Sheet::GetCell(Position pos) const {
         ValidatePosition_(pos);
-        return GetConstCell_(std::move(pos));
+        if (const Cell* cell = GetConstCell_(pos); cell != nullptr) {
+            return cell;
+        }
+
+        if (const auto array_it = FindArray_(pos); array_it != arrays_.end()) {
+            const Position& anchor = array_it->first;
+            return GetConstCell_(anchor)->GetArrayElement({pos.row - anchor.row, pos.col - anchor.col});
+        }
+        return nullptr;
+    }
+
+    Position Sheet::GetArrayAnchor(Position pos) const {
+        const auto array_it = FindArray_(pos);
+        return array_it != arrays_.end() ? array_it->first : pos;
     }
 
     Cell* Sheet::GetCell(Position pos) {
+        return const_cast<Cell*>(std::as_const(*this).GetCell(std::move(pos)));
+    }
+
+    CellInterface::Value Sheet::GetValue(Position pos) const {
         ValidatePosition_(pos);
-        return const_cast<Cell*>(GetConstCell_(std::move(pos)));
+        if (region_ != std::nullopt && !region_->rect.Contains(pos)) {
+            return region_->read_outside(pos);
+        }
+        return CellInterface::CopyValue(GetValueRef(pos));
     }
 
-    void Sheet::ClearCell(Position pos) {
+    CellInterface::ValueRef Sheet::GetValueRef(Position pos) const {
         ValidatePosition_(pos);
+        if (region_ != std::nullopt && !region_->rect.Contains(pos)) {
+            /// Owned by another sheet that may change independently: the value is copied and viewed until the next such read
+            thread_local CellInterface::Value outside;
+            outside = region_->read_outside(pos);
+            return CellInterface::ViewValue(outside);
+        }
+        if (const Cell* cell = GetConstCell_(pos); cell != nullptr) {
+            if (!cell->HasCache()) {
+                EvaluateLazily_(pos);
+            }
+            return cell->GetValueRef();
+        }
 
-        if (const auto row_ptr = sheet_.find(pos.row); row_ptr != sheet_.end()) {
-            if (row_ptr->second.size() == 1) {
-                sheet_.erase(row_ptr);
-            } else {
-                row_ptr->second.erase(pos.col);
+        if (const auto array_it = FindArray_(pos); array_it != arrays_.end()) {
+            const Position& anchor = array_it->first;
+            const Cell* cell = GetConstCell_(anchor);
+            if (!cell->HasCache()) {
+                EvaluateLazily_(anchor);
             }
-        } else {
-            return;
+            return cell->GetArrayValueRef({pos.row - anchor.row, pos.col - anchor.col});
+        }
+        return 0.0;
+    }
+
+    std::vector<CellInterface::Value> Sheet::GetValues(Rect viewport) const {
+        if (!viewport.IsValid()) {
+            throw InvalidPositionException("Invalid viewport");
+        }
+
+        std::vector<std::pair<Position, Rect>> arrays;
+        std::copy_if(arrays_.begin(), arrays_.end(), std::back_inserter(arrays), [&viewport](const auto& array) {
+            return array.second.Intersects(viewport);
+        });
+
+        std::vector<CellInterface::Value> values;
+        values.reserve(static_cast<size_t>(viewport.size.rows) * static_cast<size_t>(viewport.size.cols));
+        for (int row = viewport.position.row; row < viewport.position.row + viewport.size.rows; ++row) {
+            const auto row_it = sheet_.find(row);
+            for (int col = viewport.position.col; col < viewport.position.col + viewport.size.cols; ++col) {
+                const Position pos{row, col};
+                if (region_ != std::nullopt && !region_->rect.Contains(pos)) {
+                    values.push_back(region_->read_outside(pos));
+                    continue;
+                }
+
+                const Cell* cell = nullptr;
+                if (row_it != sheet_.end()) {
+                    if (const auto cell_it = row_it->second.find(col); cell_it != row_it->second.end()) {
+                        cell = cell_it->second.get();
+                    }
+                }
+                Position offset{0, 0};
+                if (cell == nullptr) {
+                    const auto array_it = std::find_if(arrays.begin(), arrays.end(), [&pos](const auto& array) { return array.second.Contains(pos); });
+                    if (array_it == arrays.end()) {
+                        values.emplace_back(0.0);
+                        continue;
+                    }
+                    cell = GetConstCell_(array_it->first);
+                    offset = {row - array_it->first.row, col - array_it->first.col};
+                }
+
+                if (!cell->HasCache()) {
+                    EvaluateLazily_({row - offset.row, col - offset.col});
+                }
+                values.push_back(cell->GetArrayValue(offset));
+            }
+        }
+        return values;
+    }
+
+    CellInterface::Value Sheet::GetSheetValue(std::string_view sheet, Position pos) const {
+        if (region_ == std::nullopt || !region_->read_sheet) {
+            return SheetInterface::GetSheetValue(sheet, pos);
+        }
+        return region_->read_sheet(sheet, pos);
+    }
+
+    void Sheet::ClearCell(Position pos) {
+        ThrowIfRejected(TryClearCell(pos));
+    }
+
+    EditResult Sheet::TryClearCell(Position pos) {
+        if (!pos.IsValid()) {
+            return {EditStatus::invalid_position, 0, "Invalid cell position"};
         }
 
+        const auto array_it = FindArray_(pos);
+        if (array_it != arrays_.end() && !(array_it->first == pos)) {
+            return {EditStatus::array_conflict, 0, "Cannot change part of an array"};
+        }
+
+        const auto row_ptr = sheet_.find(pos.row);
+        if (row_ptr == sheet_.end()) {
+            return {};
+        }
+        const auto cell_ptr = row_ptr->second.find(pos.col);
+        if (cell_ptr == row_ptr->second.end()) {
+            return {};
+        }
+
+        /// Invalidated while the cell still tells whether its dependents hold values
         InvalidateCache_(pos);
+        row_ptr->second.erase(cell_ptr);
+        if (row_ptr->second.empty()) {
+            sheet_.erase(row_ptr);
+        }
         graph_.EraseVertex(pos);
-        CalculateSize_(std::move(pos));
+
+        if (array_it != arrays_.end()) {
+            const Rect rect = array_it->second;
+            EraseArray_(array_it);
+            RelinkDependents_(pos);
+            Publish_(rect);
+            CalculateSize_({rect.position.row + rect.size.rows - 1, rect.position.col + rect.size.cols - 1});
+        } else {
+            Publish_(pos);
+            CalculateSize_(std::move(pos));
+        }
+        versions_->Commit();
+        RecalculateIfEager_();
+        return {};
     }
 
     Size Sheet::GetPrintableSize() const {
@@ -95,45 +563,436 @@ namespace spreadsheet /* Sheet implementation public methods */ {
     }
 
     void Sheet::PrintValues(std::ostream& output) const {
-        Print_(output, [&output](const CellInterface* cell) {
-            const auto value = cell->GetValue();
+        Print_(output, [&](const Position& pos) {
+            const auto value = GetValueRef(pos);
             if (auto error_ptr = std::get_if<FormulaError>(&value); error_ptr != nullptr) {
                 output << *error_ptr;
             } else if (auto num_ptr = std::get_if<double>(&value); num_ptr != nullptr) {
                 output << *num_ptr;
             } else {
-                output << *std::get_if<std::string>(&value);
+                output << *std::get_if<std::string_view>(&value);
             }
         });
     }
 
     void Sheet::PrintTexts(std::ostream& output) const {
-        Print_(output, [&output](const CellInterface* cell) {
-            output << cell->GetText();
+        Print_(output, [&](const Position& pos) {
+            /// Spilled cells of an array have no text, the formula is printed at the anchor
+            if (const Cell* cell = GetConstCell_(pos); cell != nullptr) {
+                output << cell->GetText();
+            }
         });
     }
 
+    query::ColumnData Sheet::ExtractColumn(int col) const {
+        ValidatePosition_({0, col});
+
+        const auto rows = static_cast<size_t>(size_.rows);
+        query::ColumnData column{std::vector<double>(rows, std::nan("")), std::vector<std::string_view>(rows)};
+        const auto store_number = [&column](int row, const CellInterface::ValueRef& value) {
+            if (const double* number = std::get_if<double>(&value); number != nullptr) {
+                column.numbers[row] = *number;
+            }
+        };
+
+        for (const auto& [row, columns] : sheet_) {
+            const auto cell_ptr = columns.find(col);
+            if (cell_ptr == columns.end() || cell_ptr->second->IsEmpty()) {
+                continue;
+            }
+
+            const Cell& cell = *cell_ptr->second;
+            if (const auto text = cell.GetTextValue(); text.has_value()) {
+                /// Texts that read as numbers take part in numeric comparisons, as in formulas
+                column.texts[row] = *text;
+                if (const std::optional<double> number = TextToNumber(*text); number.has_value()) {
+                    column.numbers[row] = *number;
+                }
+            } else {
+                store_number(row, cell.GetValueRef());
+            }
+        }
+
+        for (const auto& [anchor, rect] : arrays_) {
+            if (col < rect.position.col || col >= rect.position.col + rect.size.cols) {
+                continue;
+            }
+            const Cell* cell = GetConstCell_(anchor);
+            for (int row = 0; row < rect.size.rows; ++row) {
+                store_number(anchor.row + row, cell->GetArrayValueRef({row, col - anchor.col}));
+            }
+        }
+        return column;
+    }
+
+    RecalculationStats Sheet::Recalculate() {
+        SupersedePass_();
+        if (dirty_.empty()) {
+            NotifyChanges_();
+            return {};
+        }
+
+        /// Edited cells and everything depending on them, found in one search
+        std::vector<Position> cells(dirty_.begin(), dirty_.end());
+        dirty_.clear();
+        graph_.Search(
+            std::vector<Position>(cells), graph::Traverser::Order::breadth_first,
+            [&cells](const Position&, const Position& dependent) {
+                cells.push_back(dependent);
+                return false;
+            },
+            graph::DependencyGraph::Direction::backward);
+
+        if (mode_ == RecalculationMode::manual) {
+            std::for_each(cells.begin(), cells.end(), [this](const Position& pos) {
+                if (Cell* cell = const_cast<Cell*>(GetConstCell_(pos)); cell != nullptr) {
+                    Track_(pos);
+                    cell->ClearCache();
+                }
+            });
+        }
+        /// Scheduling the pool costs more than evaluating a few cells
+        static constexpr size_t MIN_PARALLEL_CELLS = 4096;
+        const size_t threads = parallel::ResolveThreadCount(recalculation_threads_);
+        const bool in_parallel = threads > 1 && cells.size() >= MIN_PARALLEL_CELLS;
+        if (in_parallel && pool_ == nullptr) {
+            pool_ = std::make_unique<parallel::WorkStealingPool>(threads);
+        }
+        const RecalculationStats stats = in_parallel ? EvaluateInParallel_(cells, *pool_) : EvaluateInOrder_(std::move(cells));
+        NotifyChanges_();
+        return stats;
+    }
+
+    RecalculationProgress Sheet::RunFor(std::chrono::microseconds budget) {
+        const auto deadline = std::chrono::steady_clock::now() + budget;
+        const auto enqueue = [this](const Position& pos) {
+            pass_.emplace_back(graph_.GetTopologicalIndex(pos), pos);
+            std::push_heap(pass_.begin(), pass_.end(), std::greater<>());
+        };
+        if (pass_.empty()) {
+            pass_done_ = 0;
+            pass_last_ = Position::NONE;
+            std::for_each(dirty_.begin(), dirty_.end(), enqueue);
+            dirty_.clear();
+        }
+
+        /// The affected cells are found as the pass goes, never planned at once: a cell is taken once every cell before it in
+        /// the topological order was, and the frontier holds an ancestor of every affected cell not found yet, so precedents
+        /// always come first. A cell is pushed by each of its affected precedents, all before it is taken: copies come out in
+        /// a row and only the first one is processed.
+        RecalculationProgress progress;
+        while (!pass_.empty()) {
+            std::pop_heap(pass_.begin(), pass_.end(), std::greater<>());
+            const Position pos = pass_.back().second;
+            pass_.pop_back();
+            if (pos == std::exchange(pass_last_, pos)) {
+                continue;
+            }
+            ++pass_done_;
+
+            if (Cell* cell = const_cast<Cell*>(GetConstCell_(pos)); cell != nullptr) {
+                if (mode_ == RecalculationMode::manual) {
+                    Track_(pos);
+                    cell->ClearCache();
+                }
+                /// Values computed on demand since the pass started are up to date
+                if (!cell->HasCache() && Revalidate_(pos, *cell)) {
+                    ++progress.stats.revalidated;
+                } else if (!cell->HasCache()) {
+                    static_cast<void>(cell->GetValueRef());
+                    ++progress.stats.evaluated;
+                }
+            }
+            for (const graph::Edge& edge : graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::backward)) {
+                enqueue(edge.to);
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+        }
+
+        progress.done = pass_done_;
+        progress.remaining = pass_.size();
+        if (progress.IsComplete()) {
+            NotifyChanges_();
+        }
+        return progress;
+    }
+
+    SubscriptionId Sheet::Subscribe(Rect range, ChangeCallback callback, ChangeFeed::Clock::duration window) {
+        if (!range.IsValid()) {
+            throw InvalidPositionException("Invalid subscription range");
+        }
+        /// Values left outdated would not be found by the invalidation of later edits
+        static_cast<void>(GetValues(range));
+        const SubscriptionId id = next_subscription_++;
+        watches_.emplace_back(id, range);
+        feed_->PushSubscribe(id, std::move(callback), window);
+        return id;
+    }
+
+    void Sheet::Unsubscribe(SubscriptionId id) {
+        std::erase_if(watches_, [id](const auto& watch) { return watch.first == id; });
+        feed_->PushUnsubscribe(id);
+    }
+
+    size_t Sheet::DeliverChanges(ChangeFeed::Clock::time_point now) const {
+        return feed_->Deliver(now);
+    }
+
+    void Sheet::SetRecalculationThreads(size_t threads) {
+        recalculation_threads_ = threads;
+        if (const size_t count = parallel::ResolveThreadCount(threads); count == 1) {
+            pool_.reset();
+        } else if (pool_ == nullptr || pool_->GetThreadCount() != count) {
+            pool_ = std::make_unique<parallel::WorkStealingPool>(count);
+        }
+    }
+
+    size_t Sheet::GetRecalculationThreads() const {
+        return recalculation_threads_;
+    }
+
+    void Sheet::SetRecalculationMode(RecalculationMode mode) {
+        const RecalculationMode previous = std::exchange(mode_, mode);
+        if (previous == RecalculationMode::manual && mode != RecalculationMode::manual) {
+            /// Recalculate() clears the values kept by the manual mode only while it is active
+            mode_ = RecalculationMode::manual;
+            Recalculate();
+            mode_ = mode;
+        } else if (mode == RecalculationMode::eager) {
+            Recalculate();
+        }
+    }
+
+    RecalculationMode Sheet::GetRecalculationMode() const {
+        return mode_;
+    }
+
     void Sheet::InvalidateCache_(const Position& pos) {
-        graph_.Traversal(
-            pos,
-            [&](const graph::Edge* edge) -> bool {
-                Cell* cell = GetCell(edge->to);
+        InvalidateCache_(std::vector<Position>{pos});
+    }
+
+    void Sheet::InvalidateCache_(const std::vector<Position>& cells) {
+        SupersedePass_();
+        dirty_.insert(cells.begin(), cells.end());
+        std::for_each(cells.begin(), cells.end(), [this](const Position& pos) { Track_(pos); });
+        const bool reports = region_ != std::nullopt && region_->invalidated;
+        if (mode_ == RecalculationMode::manual) {
+            if (reports) {
+                region_->invalidated(cells);
+            }
+            return;
+        }
+
+        /// Dependents of a cell without value have no values either: a formula computed from it made
+        /// it compute its value, and clearing it cleared them. So a burst of edits of one cell with no
+        /// reads in between walks the dependents once, and the walk stops at dependents already dirty.
+        std::vector<Position> starts;
+        std::copy_if(cells.begin(), cells.end(), std::back_inserter(starts), [this](const Position& pos) {
+            const Cell* cell = GetConstCell_(pos);
+            return cell == nullptr || cell->HasCache();
+        });
+        std::vector<Position> dropped;
+        if (reports) {
+            dropped = cells;
+        }
+        if (starts.empty()) {
+            if (reports) {
+                region_->invalidated(dropped);
+            }
+            return;
+        }
+        graph_.Search(
+            starts, graph::Traverser::Order::breadth_first,
+            [&](const Position&, const Position& dependent) {
+                Cell* cell = GetCell(dependent);
                 assert(cell != nullptr);
 
+                Track_(dependent);
                 cell->ClearCache();
+                if (reports) {
+                    dropped.push_back(dependent);
+                }
                 return false;  /// Continue traversal
             },
+            [this](const Position& dependent) {
+                const Cell* cell = GetConstCell_(dependent);
+                return cell != nullptr && cell->HasCache();
+            },
             graph::DependencyGraph::Direction::backward);
+        if (reports) {
+            region_->invalidated(dropped);
+        }
+    }
+
+    void Sheet::InvalidateCells(const std::vector<Position>& cells) {
+        std::vector<Position> cached;
+        std::copy_if(cells.begin(), cells.end(), std::back_inserter(cached), [this](const Position& pos) {
+            const Cell* cell = GetConstCell_(pos);
+            return cell != nullptr && cell->HasCache();
+        });
+        if (cached.empty()) {
+            return;
+        }
+        InvalidateCache_(cached);
+        std::for_each(cached.begin(), cached.end(), [this](const Position& pos) { GetCell(pos)->ClearCache(); });
+    }
+
+    void Sheet::SupersedePass_() {
+        std::for_each(pass_.begin(), pass_.end(), [this](const auto& item) { dirty_.insert(item.second); });
+        pass_.clear();
+    }
+
+    void Sheet::RecalculateIfEager_() {
+        if (mode_ == RecalculationMode::eager) {
+            Recalculate();
+        }
+    }
+
+    thread_local const Sheet* Sheet::evaluating_ = nullptr;
+
+    void Sheet::EvaluateLazily_(const Position& pos) const {
+        if (evaluating_ == this) {
+            /// Cells without references cannot recurse and are evaluated in place
+            if (const auto refs = graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::forward); refs.begin() != refs.end()) {
+                throw PendingValue{pos};
+            }
+            return;
+        }
+
+        /// Precedents every evaluation reads go first, so a formula is rarely suspended: only on a read
+        /// of an IF branch or a later AND/OR argument without value. The suspended reader is evaluated
+        /// again once the value it waits for is computed. A formula of another sheet may be suspended
+        /// below on this thread (see `Region`), its evaluation goes on afterwards.
+        const Sheet* const outer = std::exchange(evaluating_, this);
+        std::vector<Position> stack = {pos};
+        while (!stack.empty()) {
+            const Position top = stack.back();
+            const Cell* const cell = GetConstCell_(top);
+            if (cell->HasCache() || Revalidate_(top, *cell)) {
+                stack.pop_back();
+                continue;
+            }
+
+            const size_t waiting = stack.size();
+            try {
+                for (const Position& ref : ResolveReferences_(cell->GetUnconditionalCells(), arrays_.count(top) > 0 ? top : Position::NONE)) {
+                    if (const Cell* precedent = GetConstCell_(ref); precedent != nullptr && !precedent->HasCache() && !Revalidate_(ref, *precedent)) {
+                        stack.push_back(ref);
+                    }
+                }
+                if (stack.size() > waiting) {
+                    continue;
+                }
+                static_cast<void>(cell->GetValueRef());
+                stack.pop_back();
+            } catch (const PendingValue& pending) {
+                stack.push_back(pending.pos);
+            } catch (...) {
+                evaluating_ = outer;
+                throw;
+            }
+        }
+        evaluating_ = outer;
+    }
+
+    bool Sheet::Revalidate_(const Position& pos, const Cell& cell) const {
+        const std::uint64_t verified_at = cell.GetVerifiedAt();
+        if (verified_at == 0) {
+            return false;
+        }
+        /// Values read outside the region or on other sheets have no versions here
+        if (region_ != std::nullopt) {
+            const auto refs = cell.GetReferencedCells();
+            if (std::any_of(refs.begin(), refs.end(), [this](const Position& ref) { return !region_->rect.Contains(ref); }) ||
+                !cell.GetSheetReferences().empty()) {
+                return false;
+            }
+        }
+        for (const graph::Edge& edge : graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::forward)) {
+            const Cell* precedent = GetConstCell_(edge.to);
+            if (precedent == nullptr || !precedent->HasCache() || precedent->GetChangedAt() > verified_at) {
+                return false;
+            }
+        }
+        return cell.Revalidate();
+    }
+
+    RecalculationStats Sheet::EvaluateInOrder_(std::vector<Position> cells) const {
+        std::vector<std::tuple<std::uint32_t, Position, const Cell*>> schedule;
+        schedule.reserve(cells.size());
+        for (const Position& pos : cells) {
+            if (const Cell* cell = GetConstCell_(pos); cell != nullptr && !cell->HasCache()) {
+                schedule.emplace_back(graph_.GetTopologicalIndex(pos), pos, cell);
+            }
+        }
+
+        /// Precedents come first, so every cell finds the values it reads computed and knows whether they changed
+        std::sort(schedule.begin(), schedule.end());
+        schedule.erase(std::unique(schedule.begin(), schedule.end()), schedule.end());
+
+        RecalculationStats stats;
+        for (const auto& [index, pos, cell] : schedule) {
+            if (Revalidate_(pos, *cell)) {
+                ++stats.revalidated;
+            } else {
+                static_cast<void>(cell->GetValueRef());
+                ++stats.evaluated;
+            }
+        }
+        return stats;
+    }
+
+    RecalculationStats Sheet::EvaluateInParallel_(const std::vector<Position>& cells, parallel::WorkStealingPool& pool) const {
+        std::unordered_map<Position, std::uint32_t, graph::Hasher> ids;
+        std::vector<Position> positions;
+        std::vector<const Cell*> tasks;
+        ids.reserve(cells.size());
+        for (const Position& pos : cells) {
+            if (const Cell* cell = GetConstCell_(pos); cell != nullptr && !cell->HasCache() && ids.emplace(pos, tasks.size()).second) {
+                positions.push_back(pos);
+                tasks.push_back(cell);
+            }
+        }
+
+        /// Only precedents and dependents that are recalculated too take part in the schedule
+        std::vector<std::atomic<std::uint32_t>> pending(tasks.size());
+        std::vector<std::uint32_t> offsets = {0};
+        std::vector<std::uint32_t> successors;
+        offsets.reserve(tasks.size() + 1);
+        for (const Position& pos : positions) {
+            for (const graph::Edge& edge : graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::backward)) {
+                if (const auto id_it = ids.find(edge.to); id_it != ids.end()) {
+                    successors.push_back(id_it->second);
+                    pending[id_it->second].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            offsets.push_back(static_cast<std::uint32_t>(successors.size()));
+        }
+
+        std::atomic<size_t> revalidated = 0;
+        pool.RunDag(
+            pending,
+            [&](size_t task) {
+                if (Revalidate_(positions[task], *tasks[task])) {
+                    revalidated.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    static_cast<void>(tasks[task]->GetValueRef());
+                }
+            },
+            [&](size_t task, const auto& action) { std::for_each(successors.begin() + offsets[task], successors.begin() + offsets[task + 1], action); });
+        return {tasks.size() - revalidated.load(), revalidated.load()};
     }
 }
 
 namespace spreadsheet /* Sheet implementation private methods */ {
 
-    void Sheet::Print_(std::ostream& output, std::function<void(const CellInterface*)> print_cb) const {
+    void Sheet::Print_(std::ostream& output, std::function<void(const Position&)> print_cb) const {
         for (int i = 0; i < size_.rows; ++i) {
             for (int j = 0; j < size_.cols; ++j) {
-                if (auto cell = GetCell({i, j}); cell != nullptr) {
-                    print_cb(cell);
+                if (const Position pos{i, j}; GetConstCell_(pos) != nullptr || FindArray_(pos) != arrays_.end()) {
+                    print_cb(pos);
                 }
                 if (j + 1 != size_.cols) {
                     output << '\t';
@@ -151,17 +1010,21 @@ namespace spreadsheet /* Sheet implementation private methods */ {
         }
 
         Size new_size{-1, -1};
-        std::for_each(sheet_.begin(), sheet_.end(), [&new_size, grater_col_idx](const auto& row) {
+        std::for_each(sheet_.begin(), sheet_.end(), [&new_size](const auto& row) {
             new_size.rows = std::max(new_size.rows, row.first);
-            new_size.cols = !grater_col_idx ? new_size.cols
-                                            : std::max(
-                                                  std::max_element(
-                                                      row.second.begin(), row.second.end(),
-                                                      [](const auto& lhs, const auto& rhs) {
-                                                          return lhs.first < rhs.first;
-                                                      })
-                                                      ->first,
-                                                  new_size.cols);
+            new_size.cols = std::max(
+                std::max_element(
+                    row.second.begin(), row.second.end(),
+                    [](const auto& lhs, const auto& rhs) {
+                        return lhs.first < rhs.first;
+                    })
+                    ->first,
+                new_size.cols);
+        });
+        std::for_each(arrays_.begin(), arrays_.end(), [&new_size](const auto& array) {
+            const Rect& rect = array.second;
+            new_size.rows = std::max(new_size.rows, rect.position.row + rect.size.rows - 1);
+            new_size.cols = std::max(new_size.cols, rect.position.col + rect.size.cols - 1);
         });
 
         size_ = {new_size.rows + 1, new_size.cols + 1};
@@ -176,6 +1039,285 @@ namespace spreadsheet /* Sheet implementation private methods */ {
     const graph::DependencyGraph& Sheet::GetGraph() const {
         return graph_;
     }
+
+    SheetSnapshot Sheet::Snapshot() const {
+        return SheetSnapshot(versions_);
+    }
+
+    const VersionedCells& Sheet::GetVersions() const {
+        return *versions_;
+    }
+
+    void Sheet::Publish_(const Position& pos) {
+        /// The old content is gone, e.g. moved by a sort: the value counts as changed unless it was remembered before
+        if (std::any_of(watches_.begin(), watches_.end(), [&pos](const auto& watch) { return watch.second.Contains(pos); })) {
+            changed_.try_emplace(pos, std::nullopt);
+        }
+        if (const Cell* cell = GetConstCell_(pos); cell != nullptr) {
+            const auto array_it = arrays_.find(pos);
+            versions_->Write(pos, cell->GetSharedText(), array_it != arrays_.end() ? array_it->second : Rect{});
+        } else if (const auto array_it = FindArray_(pos); array_it != arrays_.end()) {
+            versions_->Write(pos, nullptr, array_it->second);
+        } else {
+            versions_->Write(pos, nullptr, {});
+        }
+    }
+
+    void Sheet::Publish_(const Rect& rect) {
+        for (int row = rect.position.row; row < rect.position.row + rect.size.rows; ++row) {
+            for (int col = rect.position.col; col < rect.position.col + rect.size.cols; ++col) {
+                Publish_(Position{row, col});
+            }
+        }
+    }
+
+    void Sheet::Track_(const Position& pos) {
+        if (watches_.empty()) {
+            return;
+        }
+        const Cell* cell = GetConstCell_(pos);
+        const auto remember = [&](const Position& watched) {
+            const Position offset{watched.row - pos.row, watched.col - pos.col};
+            changed_.try_emplace(watched, cell != nullptr && cell->HasCache() ? std::optional(cell->GetArrayValue(offset)) : std::nullopt);
+        };
+
+        const auto array_it = arrays_.find(pos);
+        const Rect block = array_it != arrays_.end() && cell != nullptr && cell->IsArray() ? array_it->second : Rect{pos, {1, 1}};
+        for (const auto& [id, rect] : watches_) {
+            const int first_row = std::max(block.position.row, rect.position.row);
+            const int last_row = std::min(block.position.row + block.size.rows, rect.position.row + rect.size.rows);
+            const int first_col = std::max(block.position.col, rect.position.col);
+            const int last_col = std::min(block.position.col + block.size.cols, rect.position.col + rect.size.cols);
+            for (int row = first_row; row < last_row; ++row) {
+                for (int col = first_col; col < last_col; ++col) {
+                    remember({row, col});
+                }
+            }
+        }
+    }
+
+    void Sheet::NotifyChanges_() {
+        if (changed_.empty()) {
+            return;
+        }
+        std::vector<std::pair<SubscriptionId, CellChange>> changes;
+        for (auto& [pos, old_value] : changed_) {
+            CellInterface::Value value = GetValue(pos);
+            if (old_value.has_value() && *old_value == value) {
+                continue;
+            }
+            for (const auto& [id, rect] : watches_) {
+                if (rect.Contains(pos)) {
+                    changes.push_back({id, {pos, value}});
+                }
+            }
+        }
+        changed_.clear();
+        if (!changes.empty()) {
+            feed_->PushChanges(std::move(changes));
+        }
+    }
+
+    Sheet::ArrayIterator Sheet::FindArray_(const Position& pos) const {
+        const auto row_it = array_rows_.find(pos.row);
+        if (row_it == array_rows_.end()) {
+            return arrays_.end();
+        }
+        /// Blocks do not overlap: only the last block starting at or before the column may contain it
+        const auto block_it = row_it->second.upper_bound(pos.col);
+        if (block_it == row_it->second.begin()) {
+            return arrays_.end();
+        }
+        const auto array_it = arrays_.find(std::prev(block_it)->second);
+        return array_it->second.Contains(pos) ? array_it : arrays_.end();
+    }
+
+    void Sheet::AddArray_(const Position& anchor, const Rect& rect) {
+        if (const auto array_it = arrays_.find(anchor); array_it != arrays_.end()) {
+            EraseArray_(array_it);
+        }
+        for (int row = rect.position.row; row < rect.position.row + rect.size.rows; ++row) {
+            array_rows_[row].emplace(rect.position.col, anchor);
+        }
+        arrays_.emplace(anchor, rect);
+    }
+
+    void Sheet::EraseArray_(ArrayIterator array_it) {
+        const Rect& rect = array_it->second;
+        for (int row = rect.position.row; row < rect.position.row + rect.size.rows; ++row) {
+            const auto row_it = array_rows_.find(row);
+            row_it->second.erase(rect.position.col);
+            if (row_it->second.empty()) {
+                array_rows_.erase(row_it);
+            }
+        }
+        arrays_.erase(array_it);
+    }
+
+    std::vector<Position> Sheet::ResolveReferences_(std::vector<Position> refs, const Position& ignored_anchor) const {
+        if (region_ != std::nullopt) {
+            std::erase_if(refs, [this](const Position& ref) { return !region_->rect.Contains(ref); });
+        }
+        if (arrays_.empty()) {
+            return refs;
+        }
+
+        /// References to spilled cells are references to the anchor of their array
+        bool resolved = false;
+        std::for_each(refs.begin(), refs.end(), [&](Position& ref) {
+            if (const auto array_it = FindArray_(ref); array_it != arrays_.end() && !(array_it->first == ignored_anchor)) {
+                resolved = resolved || !(ref == array_it->first);
+                ref = array_it->first;
+            }
+        });
+        if (resolved) {
+            std::sort(refs.begin(), refs.end());
+            refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+        }
+        return refs;
+    }
+
+    void Sheet::LinkCell_(const Position& pos, std::vector<Position> refs) {
+        graph_.EraseVertex(pos);
+
+        std::for_each(std::move_iterator(refs.begin()), std::move_iterator(refs.end()), [&](const Position& ref) {
+            if (!GetCell(ref)) {
+                SetCell_(ref, "");
+            }
+            graph_.AddEdge({pos, ref});
+        });
+    }
+
+    void Sheet::RelinkDependents_(const Position& pos) {
+        std::vector<Position> dependents;
+        for (const graph::Edge& edge : graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::backward)) {
+            dependents.push_back(edge.to);
+        }
+
+        std::for_each(dependents.begin(), dependents.end(), [&](const Position& dependent) {
+            if (const Cell* cell = GetConstCell_(dependent); cell != nullptr) {
+                LinkCell_(dependent, ResolveReferences_(cell->GetReferencedCells(), Position::NONE));
+            }
+        });
+    }
+
+    bool Sheet::DetectCircularDependency_(const std::unordered_map<Position, std::vector<Position>, graph::Hasher>& new_refs) const {
+        /// A cycle passes through a changed cell. Unchanged references only lead to cells earlier in the
+        /// topological order, so unchanged cells before every changed one cannot lead back to the batch.
+        std::uint32_t bound = graph_.HasTopologicalOrder() ? std::numeric_limits<std::uint32_t>::max() : 0;
+        for (const auto& [pos, refs] : new_refs) {
+            bound = std::min(bound, graph_.GetTopologicalIndex(pos));
+        }
+
+        /// Depth-first search over new references of changed cells and current references of the others
+        enum class State { open, closed };
+        std::unordered_map<Position, State, graph::Hasher> states;
+        std::vector<std::pair<std::vector<Position>, size_t>> stack;
+        std::vector<Position> path;
+        const auto enter = [&](const Position& pos) {
+            if (const auto refs_it = new_refs.find(pos); refs_it != new_refs.end()) {
+                stack.emplace_back(refs_it->second, 0);
+            } else if (graph_.GetTopologicalIndex(pos) >= bound) {
+                std::vector<Position> refs;
+                for (const graph::Edge& edge : graph_.GetIncidentEdges(pos, graph::DependencyGraph::Direction::forward)) {
+                    refs.push_back(edge.to);
+                }
+                stack.emplace_back(std::move(refs), 0);
+            } else {
+                stack.emplace_back(std::vector<Position>{}, 0);
+            }
+            states.emplace(pos, State::open);
+            path.push_back(pos);
+        };
+
+        for (const auto& [start, start_refs] : new_refs) {
+            if (states.count(start) > 0) {
+                continue;
+            }
+            enter(start);
+            while (!stack.empty()) {
+                auto& [refs, next] = stack.back();
+                if (next == refs.size()) {
+                    states[path.back()] = State::closed;
+                    path.pop_back();
+                    stack.pop_back();
+                    continue;
+                }
+                const Position ref = refs[next++];
+                if (const auto state_it = states.find(ref); state_it == states.end()) {
+                    enter(ref);
+                } else if (state_it->second == State::open) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void Sheet::RebuildGraph_() {
+        graph::EdgeContainer edges;
+        for (const auto& [row, columns] : sheet_) {
+            for (const auto& [col, cell] : columns) {
+                const Position pos{row, col};
+                const auto cell_refs = ResolveReferences_(cell->GetReferencedCells(), arrays_.count(pos) > 0 ? pos : Position::NONE);
+                std::transform(cell_refs.begin(), cell_refs.end(), std::back_inserter(edges), [&pos](const Position& ref) { return graph::Edge{pos, ref}; });
+            }
+        }
+        graph_ = graph::DependencyGraph();
+        graph_.AddEdges(edges.begin(), edges.end());
+    }
+
+    std::vector<int> Sheet::SortRows_(int first_row, int row_count, const std::vector<SortKey>& keys, size_t threads) const {
+        /// Key columns are extracted (and formulas evaluated) up front, the sort only reads them
+        std::vector<query::ColumnData> columns;
+        columns.reserve(keys.size());
+        std::transform(keys.begin(), keys.end(), std::back_inserter(columns), [this](const SortKey& key) { return ExtractColumn(key.col); });
+
+        /// Numbers, then texts, then empty cells and errors
+        const auto rank = [](const query::ColumnData& column, int row) {
+            return !std::isnan(column.numbers[row]) ? 0 : column.texts[row].data() != nullptr ? 1 : 2;
+        };
+        const auto compare = [&](int lhs, int rhs) {
+            lhs += first_row;
+            rhs += first_row;
+            for (size_t i = 0; i < keys.size(); ++i) {
+                const query::ColumnData& column = columns[i];
+                const int lhs_rank = rank(column, lhs);
+                const int rhs_rank = rank(column, rhs);
+                if (lhs_rank != rhs_rank) {
+                    return lhs_rank == 2 || rhs_rank == 2 ? lhs_rank < rhs_rank : (lhs_rank < rhs_rank) == keys[i].ascending;
+                }
+                if (lhs_rank == 0 && column.numbers[lhs] != column.numbers[rhs]) {
+                    return (column.numbers[lhs] < column.numbers[rhs]) == keys[i].ascending;
+                }
+                if (lhs_rank == 1 && column.texts[lhs] != column.texts[rhs]) {
+                    return (column.texts[lhs] < column.texts[rhs]) == keys[i].ascending;
+                }
+            }
+            return false;
+        };
+
+        std::vector<int> order(row_count);
+        std::iota(order.begin(), order.end(), 0);
+        parallel::StableSort(order.begin(), order.end(), compare, threads);
+        return order;
+    }
+
+    std::vector<Position> Sheet::GetCellsInRect_(const Rect& rect) const {
+        std::vector<Position> result;
+        for (int row = rect.position.row; row < rect.position.row + rect.size.rows; ++row) {
+            const auto row_ptr = sheet_.find(row);
+            if (row_ptr == sheet_.end()) {
+                continue;
+            }
+            for (const auto& [col, cell] : row_ptr->second) {
+                if (rect.Contains({row, col})) {
+                    result.push_back({row, col});
+                }
+            }
+        }
+        return result;
+    }
 }
 
 std::unique_ptr<SheetInterface> CreateSheet() {
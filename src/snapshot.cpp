@@ -0,0 +1,334 @@
+#include "snapshot.h"
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "common.h"
+#include "formula.h"
+
+namespace spreadsheet /* CellVersion implementation */ {
+
+    std::string_view CellVersion::GetText() const {
+        return text != nullptr ? std::string_view(*text) : std::string_view();
+    }
+
+    bool CellVersion::IsFormula() const {
+        return !IsArray() && GetText().length() > 1 && GetText()[0] == FORMULA_SIGN;
+    }
+
+    bool CellVersion::IsArray() const {
+        return array.size.rows > 0;
+    }
+
+    const FormulaInterface& CellVersion::GetFormula() const {
+        assert(IsFormula() || (IsArray() && !GetText().empty()));
+        std::call_once(parsed_, [this] {
+            /// Array anchors are printed as `{=expression}`
+            const std::string_view text = GetText();
+            formula_ = ParseFormula(std::string(IsArray() ? text.substr(2, text.length() - 3) : text.substr(1)));
+        });
+        return *formula_;
+    }
+}
+
+namespace spreadsheet /* VersionedCells implementation */ {
+
+    VersionedCells::VersionedCells() : rows_(std::make_unique<std::atomic<Row*>[]>(Position::MAX_ROWS)) {}
+
+    VersionedCells::~VersionedCells() {
+        for (int row = 0; row < Position::MAX_ROWS; ++row) {
+            Row* cells = rows_[row].load(std::memory_order_relaxed);
+            if (cells == nullptr) {
+                continue;
+            }
+            for (auto& chunk_ptr : *cells) {
+                Chunk* chunk = chunk_ptr.load(std::memory_order_relaxed);
+                if (chunk == nullptr) {
+                    continue;
+                }
+                for (auto& slot : *chunk) {
+                    for (CellVersion* entry = slot.load(std::memory_order_relaxed); entry != nullptr;) {
+                        delete std::exchange(entry, entry->older);
+                    }
+                }
+                delete chunk;
+            }
+            delete cells;
+        }
+    }
+
+    void VersionedCells::Write(Position pos, std::shared_ptr<const std::string> text, Rect array) {
+        std::atomic<CellVersion*>& slot = GetSlot_(pos);
+        const std::uint64_t version = version_.load(std::memory_order_relaxed) + 1;
+
+        auto* entry = new CellVersion();
+        entry->version = version;
+        entry->text = std::move(text);
+        entry->array = array;
+        entry->older = slot.load(std::memory_order_relaxed);
+        slot.store(entry, std::memory_order_release);
+        if (entry->older != nullptr) {
+            retired_.push_back({version, entry});
+        }
+    }
+
+    void VersionedCells::Commit() {
+        version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        Collect_();
+    }
+
+    const CellVersion* VersionedCells::Find(Position pos, std::uint64_t version) const {
+        const Row* cells = rows_[pos.row].load(std::memory_order_acquire);
+        if (cells == nullptr) {
+            return nullptr;
+        }
+        const Chunk* chunk = (*cells)[pos.col / CHUNK_COLS].load(std::memory_order_acquire);
+        if (chunk == nullptr) {
+            return nullptr;
+        }
+        const CellVersion* entry = (*chunk)[pos.col % CHUNK_COLS].load(std::memory_order_acquire);
+        while (entry != nullptr && entry->version > version) {
+            entry = entry->older;
+        }
+        return entry;
+    }
+
+    std::uint64_t VersionedCells::GetVersion() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    std::uint64_t VersionedCells::Acquire() {
+        /// Read under the lock: either the writer collecting garbage sees this reader, or the reader sees the newer version
+        const std::lock_guard lock(readers_mutex_);
+        const std::uint64_t version = version_.load(std::memory_order_acquire);
+        readers_.insert(version);
+        return version;
+    }
+
+    void VersionedCells::Release(std::uint64_t version) {
+        const std::lock_guard lock(readers_mutex_);
+        readers_.erase(readers_.find(version));
+    }
+
+    size_t VersionedCells::GetRetainedCount() const {
+        return retired_.size();
+    }
+
+    std::atomic<CellVersion*>& VersionedCells::GetSlot_(Position pos) {
+        std::atomic<Row*>& row_ptr = rows_[pos.row];
+        Row* cells = row_ptr.load(std::memory_order_relaxed);
+        if (cells == nullptr) {
+            cells = new Row();
+            row_ptr.store(cells, std::memory_order_release);
+        }
+
+        std::atomic<Chunk*>& chunk_ptr = (*cells)[pos.col / CHUNK_COLS];
+        Chunk* chunk = chunk_ptr.load(std::memory_order_relaxed);
+        if (chunk == nullptr) {
+            chunk = new Chunk();
+            chunk_ptr.store(chunk, std::memory_order_release);
+        }
+        return (*chunk)[pos.col % CHUNK_COLS];
+    }
+
+    void VersionedCells::Collect_() {
+        std::uint64_t oldest = 0;
+        {
+            const std::lock_guard lock(readers_mutex_);
+            oldest = readers_.empty() ? version_.load(std::memory_order_relaxed) : *readers_.begin();
+        }
+
+        /// Readers at `oldest` or later stop at the superseding entry, nothing reads past it
+        while (!retired_.empty() && retired_.front().superseded_at <= oldest) {
+            for (CellVersion* entry = std::exchange(retired_.front().newer->older, nullptr); entry != nullptr;) {
+                delete std::exchange(entry, entry->older);
+            }
+            retired_.pop_front();
+        }
+    }
+}
+
+namespace spreadsheet /* SheetSnapshot implementation */ {
+
+    namespace {
+        CellInterface::ValueRef ToCellValue(const FormulaInterface::Value& value) {
+            if (const double* number = std::get_if<double>(&value); number != nullptr) {
+                return *number;
+            }
+            return std::get<FormulaError>(value);
+        }
+    }
+
+    SheetSnapshot::SheetSnapshot(std::shared_ptr<VersionedCells> cells)
+        : cells_(std::move(cells)), version_(cells_->Acquire()), view_(std::make_unique<View>(*this)) {}
+
+    SheetSnapshot::~SheetSnapshot() {
+        if (cells_ != nullptr) {
+            cells_->Release(version_);
+        }
+    }
+
+    SheetSnapshot::SheetSnapshot(SheetSnapshot&& other) noexcept
+        : cells_(std::move(other.cells_)),
+          version_(other.version_),
+          view_(std::make_unique<View>(*this)),
+          values_(std::move(other.values_)),
+          arrays_(std::move(other.arrays_)) {}
+
+    SheetSnapshot& SheetSnapshot::operator=(SheetSnapshot&& other) noexcept {
+        if (this != &other) {
+            if (cells_ != nullptr) {
+                cells_->Release(version_);
+            }
+            cells_ = std::move(other.cells_);
+            version_ = other.version_;
+            values_ = std::move(other.values_);
+            arrays_ = std::move(other.arrays_);
+        }
+        return *this;
+    }
+
+    CellInterface::Value SheetSnapshot::GetValue(Position pos) const {
+        return CellInterface::CopyValue(GetValueRef(pos));
+    }
+
+    CellInterface::ValueRef SheetSnapshot::GetValueRef(Position pos) const {
+        if (!pos.IsValid()) {
+            throw InvalidPositionException("Invalid cell position");
+        }
+
+        const CellVersion* content = cells_->Find(pos, version_);
+        if (content == nullptr) {
+            return 0.0;
+        }
+        if (content->IsArray()) {
+            const Position& anchor = content->array.position;
+            if (arrays_.count(anchor) == 0) {
+                Evaluate_(anchor);
+            }
+            return ToCellValue(arrays_.at(anchor)[static_cast<size_t>(pos.row - anchor.row) * content->array.size.cols + (pos.col - anchor.col)]);
+        }
+        if (content->IsFormula()) {
+            if (values_.count(pos) == 0) {
+                Evaluate_(pos);
+            }
+            return CellInterface::ViewValue(values_.at(pos));
+        }
+        const std::string_view text = content->GetText();
+        if (text.empty()) {
+            return 0.0;
+        }
+        return text.substr(text[0] == ESCAPE_SIGN ? 1 : 0);
+    }
+
+    std::string SheetSnapshot::GetText(Position pos) const {
+        if (!pos.IsValid()) {
+            throw InvalidPositionException("Invalid cell position");
+        }
+        const CellVersion* content = cells_->Find(pos, version_);
+        return content != nullptr ? std::string(content->GetText()) : std::string();
+    }
+
+    std::uint64_t SheetSnapshot::GetVersion() const {
+        return version_;
+    }
+
+    void SheetSnapshot::Evaluate_(const Position& pos) const {
+        if (evaluating_) {
+            throw PendingValue{pos};
+        }
+
+        /// Same scheme as `Sheet::EvaluateLazily_`: precedents every evaluation reads go first, and a
+        /// formula is suspended only on a read of a value not computed yet in an IF or AND/OR branch
+        evaluating_ = true;
+        std::vector<Position> stack = {pos};
+        while (!stack.empty()) {
+            const Position top = stack.back();
+            const CellVersion* content = cells_->Find(top, version_);
+            assert(content != nullptr);
+            if (IsComputed_(top, *content)) {
+                stack.pop_back();
+                continue;
+            }
+
+            const size_t waiting = stack.size();
+            for (const Position& ref : content->GetFormula().GetUnconditionalCells()) {
+                const CellVersion* precedent = cells_->Find(ref, version_);
+                if (precedent == nullptr || !(precedent->IsArray() || precedent->IsFormula())) {
+                    continue;
+                }
+                const Position& target = precedent->IsArray() ? precedent->array.position : ref;
+                const CellVersion* target_content = precedent->IsArray() ? cells_->Find(target, version_) : precedent;
+                if (!IsComputed_(target, *target_content)) {
+                    stack.push_back(target);
+                }
+            }
+            if (stack.size() > waiting) {
+                continue;
+            }
+
+            try {
+                Compute_(top, *content);
+                stack.pop_back();
+            } catch (const PendingValue& pending) {
+                stack.push_back(pending.pos);
+            } catch (...) {
+                evaluating_ = false;
+                throw;
+            }
+        }
+        evaluating_ = false;
+    }
+
+    bool SheetSnapshot::IsComputed_(const Position& pos, const CellVersion& content) const {
+        return content.IsArray() ? arrays_.count(pos) > 0 : values_.count(pos) > 0;
+    }
+
+    void SheetSnapshot::Compute_(const Position& pos, const CellVersion& content) const {
+        if (content.IsArray()) {
+            arrays_.emplace(pos, content.GetFormula().EvaluateArray(*view_, content.array.size));
+        } else {
+            values_.emplace(pos, CellInterface::CopyValue(ToCellValue(content.GetFormula().Evaluate(*view_))));
+        }
+    }
+
+    SheetSnapshot::View::View(const SheetSnapshot& snapshot) : snapshot_(snapshot) {}
+
+    CellInterface::Value SheetSnapshot::View::GetValue(Position pos) const {
+        return snapshot_.GetValue(pos);
+    }
+
+    CellInterface::ValueRef SheetSnapshot::View::GetValueRef(Position pos) const {
+        return snapshot_.GetValueRef(pos);
+    }
+
+    /// Formulas only read values; cell objects and modifications do not exist in a snapshot
+
+    const CellInterface* SheetSnapshot::View::GetCell(Position) const {
+        return nullptr;
+    }
+
+    CellInterface* SheetSnapshot::View::GetCell(Position) {
+        return nullptr;
+    }
+
+    void SheetSnapshot::View::SetCell(Position, std::string) {
+        throw std::logic_error("Snapshots are read-only");
+    }
+
+    void SheetSnapshot::View::ClearCell(Position) {
+        throw std::logic_error("Snapshots are read-only");
+    }
+
+    Size SheetSnapshot::View::GetPrintableSize() const {
+        return {};
+    }
+
+    void SheetSnapshot::View::PrintValues(std::ostream&) const {}
+
+    void SheetSnapshot::View::PrintTexts(std::ostream&) const {}
+}
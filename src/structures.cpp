@@ -1,6 +1,10 @@
 #include <algorithm>
 #include <cctype>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
 
 #include "common.h"
 
@@ -75,4 +79,45 @@ Position Position::FromString(std::string_view str) {
 
 bool Size::operator==(Size rhs) const {
     return cols == rhs.cols && rows == rhs.rows;
-}
\ No newline at end of file
+}
+bool Rect::operator==(Rect rhs) const {
+    return position == rhs.position && size == rhs.size;
+}
+
+bool Rect::IsValid() const {
+    return position.IsValid() && size.rows > 0 && size.cols > 0 && position.row + size.rows <= Position::MAX_ROWS &&
+           position.col + size.cols <= Position::MAX_COLS;
+}
+
+bool Rect::Contains(Position pos) const {
+    return pos.row >= position.row && pos.col >= position.col && pos.row < position.row + size.rows && pos.col < position.col + size.cols;
+}
+
+bool Rect::Intersects(Rect rhs) const {
+    return position.row < rhs.position.row + rhs.size.rows && rhs.position.row < position.row + size.rows &&
+           position.col < rhs.position.col + rhs.size.cols && rhs.position.col < position.col + size.cols;
+}
+
+bool SheetReference::operator==(const SheetReference& rhs) const {
+    return sheet == rhs.sheet && range == rhs.range;
+}
+
+CellInterface::ValueRef CellInterface::ViewValue(const Value& value) {
+    return std::visit([](const auto& alternative) -> ValueRef { return alternative; }, value);
+}
+
+CellInterface::Value CellInterface::CopyValue(ValueRef value) {
+    return std::visit(
+        [](const auto& alternative) -> Value {
+            if constexpr (std::is_same_v<std::decay_t<decltype(alternative)>, std::string_view>) {
+                return std::string(alternative);
+            } else {
+                return alternative;
+            }
+        },
+        value);
+}
+
+CellInterface::Value SheetInterface::GetSheetValue(std::string_view /* sheet */, Position /* pos */) const {
+    return FormulaError(FormulaError::Category::Ref);
+}
@@ -0,0 +1,311 @@
+#include "workbook.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "parallel.h"
+
+namespace spreadsheet /* Workbook implementation public methods */ {
+
+    Workbook::Workbook() = default;
+
+    Workbook::~Workbook() = default;
+
+    const Sheet& Workbook::AddSheet(std::string name) {
+        if (name.empty() || name.find_first_of("'!") != std::string::npos) {
+            throw std::invalid_argument("Invalid sheet name: " + name);
+        }
+        if (indices_.count(name) > 0) {
+            throw std::invalid_argument("Sheet already exists: " + name);
+        }
+
+        const size_t index = pages_.size();
+        Region region;
+        region.rect = {{0, 0}, {Position::MAX_ROWS, Position::MAX_COLS}};
+        region.read_sheet = [this](std::string_view sheet, Position pos) { return ReadSheet_(sheet, pos); };
+        region.check_references = [this, index](const Rect& cells, const std::vector<Position>& refs, const std::vector<SheetReference>& sheet_refs) {
+            CheckReferences_(index, cells, refs, sheet_refs);
+        };
+        region.invalidated = [this, index](const std::vector<Position>& positions) { Invalidated_(index, positions); };
+        pages_.push_back(std::make_unique<Page>(name, std::move(region)));
+        /// Sheets are recalculated as tasks on the workers of `Recalculate()`, not on pools of their own
+        pages_.back()->sheet.SetRecalculationThreads(1);
+        links_.AddRegion();
+        indices_.emplace(std::move(name), index);
+        return pages_.back()->sheet;
+    }
+
+    const Sheet& Workbook::GetSheet(std::string_view name) const {
+        return pages_[GetIndex_(name)]->sheet;
+    }
+
+    std::vector<std::string> Workbook::GetSheetNames() const {
+        std::vector<std::string> names;
+        names.reserve(pages_.size());
+        std::transform(pages_.begin(), pages_.end(), std::back_inserter(names), [](const auto& page) { return page->name; });
+        return names;
+    }
+
+    size_t Workbook::GetSheetCount() const {
+        return pages_.size();
+    }
+
+    void Workbook::SetCell(std::string_view sheet, Position pos, std::string text) {
+        const size_t index = GetIndex_(sheet);
+        pages_[index]->sheet.SetCell(pos, std::move(text));
+        Propagate_(index, {pos});
+    }
+
+    void Workbook::SetCells(std::string_view sheet, std::vector<std::pair<Position, std::string>> cells) {
+        const size_t index = GetIndex_(sheet);
+        std::vector<Position> positions;
+        positions.reserve(cells.size());
+        std::transform(cells.begin(), cells.end(), std::back_inserter(positions), [](const auto& item) { return item.first; });
+        pages_[index]->sheet.SetCells(std::move(cells));
+        Propagate_(index, positions);
+    }
+
+    void Workbook::SetArrayFormula(std::string_view sheet, Rect rect, std::string text) {
+        const size_t index = GetIndex_(sheet);
+        pages_[index]->sheet.SetArrayFormula(rect, std::move(text));
+        Propagate_(index, {rect.position});
+    }
+
+    void Workbook::ClearCell(std::string_view sheet, Position pos) {
+        const size_t index = GetIndex_(sheet);
+        pages_[index]->sheet.ClearCell(pos);
+        Propagate_(index, {pos});
+    }
+
+    CellInterface::Value Workbook::GetValue(std::string_view sheet, Position pos) const {
+        return pages_[GetIndex_(sheet)]->sheet.GetValue(pos);
+    }
+
+    RecalculationStats Workbook::Recalculate(size_t threads) {
+        /// A component runs once the components it reads are done; sheets of one component share the task
+        const auto components = GetComponents_();
+        std::vector<size_t> component_of(pages_.size());
+        for (size_t component = 0; component < components.size(); ++component) {
+            std::for_each(components[component].begin(), components[component].end(), [&](size_t sheet) { component_of[sheet] = component; });
+        }
+
+        std::vector<std::set<size_t>> successors(components.size());
+        std::vector<std::atomic<std::uint32_t>> pending(components.size());
+        for (size_t component = 0; component < components.size(); ++component) {
+            for (const size_t sheet : components[component]) {
+                for (const auto& [read, count] : links_.GetReadRegions(sheet)) {
+                    if (const size_t predecessor = component_of[read]; predecessor != component && successors[predecessor].insert(component).second) {
+                        pending[component].fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+
+        if (const size_t count = parallel::ResolveThreadCount(threads); pool_ == nullptr || pool_->GetThreadCount() != count) {
+            pool_ = std::make_unique<parallel::WorkStealingPool>(count);
+        }
+        std::vector<RecalculationStats> stats(components.size());
+        pool_->RunDag(
+            pending,
+            [&](size_t component) {
+                for (const size_t sheet : components[component]) {
+                    const RecalculationStats sheet_stats = pages_[sheet]->sheet.Recalculate();
+                    stats[component].evaluated += sheet_stats.evaluated;
+                    stats[component].revalidated += sheet_stats.revalidated;
+                }
+            },
+            [&](size_t component, const auto& action) { std::for_each(successors[component].begin(), successors[component].end(), action); });
+
+        RecalculationStats total;
+        for (const RecalculationStats& component_stats : stats) {
+            total.evaluated += component_stats.evaluated;
+            total.revalidated += component_stats.revalidated;
+        }
+        return total;
+    }
+}
+
+namespace spreadsheet /* Workbook implementation private methods */ {
+
+    size_t Workbook::GetIndex_(std::string_view name) const {
+        const auto it = indices_.find(name);
+        if (it == indices_.end()) {
+            throw UnknownSheetException("Unknown sheet: " + std::string(name));
+        }
+        return it->second;
+    }
+
+    std::vector<RegionCell> Workbook::Expand_(const SheetReference& reference) const {
+        const auto it = indices_.find(reference.sheet);
+        if (it == indices_.end()) {
+            throw FormulaException("Unknown sheet: " + reference.sheet);
+        }
+
+        const Rect& range = reference.range;
+        std::vector<RegionCell> keys;
+        keys.reserve(static_cast<size_t>(range.size.rows) * static_cast<size_t>(range.size.cols));
+        for (int row = 0; row < range.size.rows; ++row) {
+            for (int col = 0; col < range.size.cols; ++col) {
+                keys.push_back({it->second, {range.position.row + row, range.position.col + col}});
+            }
+        }
+        return keys;
+    }
+
+    CellInterface::Value Workbook::ReadSheet_(std::string_view name, const Position& pos) const {
+        const auto it = indices_.find(name);
+        if (it == indices_.end()) {
+            return FormulaError(FormulaError::Category::Ref);
+        }
+        return pages_[it->second]->sheet.GetValue(pos);
+    }
+
+    void Workbook::CheckReferences_(size_t index, const Rect& cells, const std::vector<Position>& refs,
+                                    const std::vector<SheetReference>& sheet_refs) const {
+        std::vector<RegionCell> starts;
+        for (const SheetReference& reference : sheet_refs) {
+            const auto keys = Expand_(reference);
+            starts.insert(starts.end(), keys.begin(), keys.end());
+        }
+
+        /// A path back to the sheet leaves another sheet through a reference to it, or is a reference of the sheet to itself
+        const bool reads_itself = std::any_of(starts.begin(), starts.end(), [index](const RegionCell& key) { return key.region == index; });
+        if (!links_.HasReaders(index) && !reads_itself) {
+            return;
+        }
+
+        std::transform(refs.begin(), refs.end(), std::back_inserter(starts), [index](const Position& ref) { return RegionCell{index, ref}; });
+        if (Reaches_(std::move(starts), index, cells)) {
+            throw CircularDependencyException("Has circular dependency");
+        }
+    }
+
+    bool Workbook::Reaches_(std::vector<RegionCell> starts, size_t index, const Rect& cells) const {
+        /// Depth-first search over references within sheets, resolved to array anchors as the graphs do, and across them
+        std::unordered_set<RegionCell, RegionCellHasher> visited;
+        std::vector<RegionCell> stack = std::move(starts);
+        while (!stack.empty()) {
+            const RegionCell key = stack.back();
+            stack.pop_back();
+            if (!key.pos.IsValid()) {
+                continue;
+            }
+
+            const Page& page = *pages_[key.region];
+            const Position anchor = page.sheet.GetArrayAnchor(key.pos);
+            if (key.region == index && (cells.Contains(key.pos) || cells.Contains(anchor))) {
+                return true;
+            }
+            if (!visited.insert({key.region, anchor}).second) {
+                continue;
+            }
+
+            for (const graph::Edge& edge : page.sheet.GetGraph().GetIncidentEdges(anchor, graph::DependencyGraph::Direction::forward)) {
+                stack.push_back({key.region, edge.to});
+            }
+            const auto& remote_refs = links_.GetReferences({key.region, anchor});
+            stack.insert(stack.end(), remote_refs.begin(), remote_refs.end());
+        }
+        return false;
+    }
+
+    void Workbook::Relink_(size_t index, const Position& pos) {
+        std::vector<RegionCell> keys;
+        if (const Cell* cell = pages_[index]->sheet.GetCell(pos); cell != nullptr) {
+            for (const SheetReference& reference : cell->GetSheetReferences()) {
+                const auto reference_keys = Expand_(reference);
+                keys.insert(keys.end(), reference_keys.begin(), reference_keys.end());
+            }
+        }
+        links_.Link({index, pos}, std::move(keys));
+    }
+
+    void Workbook::Invalidated_(size_t index, const std::vector<Position>& positions) {
+        if (!links_.HasReaders(index)) {
+            return;
+        }
+        links_.Invalidated(index, positions);
+
+        /// Readers of spilled cells are recorded by position, an anchor stands for its block
+        const Sheet& sheet = pages_[index]->sheet;
+        for (const Position& pos : positions) {
+            if (const Cell* cell = sheet.GetCell(pos); cell != nullptr && cell->IsArray()) {
+                const Size size = cell->GetArraySize();
+                std::vector<Position> block;
+                block.reserve(static_cast<size_t>(size.rows) * static_cast<size_t>(size.cols));
+                for (int row = 0; row < size.rows; ++row) {
+                    for (int col = 0; col < size.cols; ++col) {
+                        block.push_back({pos.row + row, pos.col + col});
+                    }
+                }
+                links_.Invalidated(index, block);
+            }
+        }
+    }
+
+    void Workbook::InvalidateReaders_(CrossLinks::Readers readers) {
+        CrossLinks::InvalidateReaders(std::move(readers), [this](size_t index, const std::vector<Position>& positions) {
+            pages_[index]->sheet.InvalidateCells(positions);
+            return links_.TakeReaders(index);
+        });
+    }
+
+    void Workbook::Propagate_(size_t index, const std::vector<Position>& positions) {
+        std::for_each(positions.begin(), positions.end(), [&](const Position& pos) { Relink_(index, pos); });
+        InvalidateReaders_(links_.TakeReaders(index));
+    }
+
+    std::vector<std::vector<size_t>> Workbook::GetComponents_() const {
+        /// Tarjan's algorithm: a component is complete once the search returns to its first sheet, after all sheets it reads
+        static constexpr size_t UNVISITED = std::numeric_limits<size_t>::max();
+
+        const size_t count = pages_.size();
+        std::vector<size_t> order(count, UNVISITED);
+        std::vector<size_t> low(count, 0);
+        std::vector<bool> on_stack(count, false);
+        std::vector<size_t> stack;
+        std::vector<std::vector<size_t>> components;
+        size_t next = 0;
+
+        const std::function<void(size_t)> visit = [&](size_t sheet) {
+            order[sheet] = low[sheet] = next++;
+            stack.push_back(sheet);
+            on_stack[sheet] = true;
+            for (const auto& [read, references] : links_.GetReadRegions(sheet)) {
+                if (order[read] == UNVISITED) {
+                    visit(read);
+                    low[sheet] = std::min(low[sheet], low[read]);
+                } else if (on_stack[read]) {
+                    low[sheet] = std::min(low[sheet], order[read]);
+                }
+            }
+            if (low[sheet] != order[sheet]) {
+                return;
+            }
+
+            std::vector<size_t> component;
+            size_t member = UNVISITED;
+            while (member != sheet) {
+                member = stack.back();
+                stack.pop_back();
+                on_stack[member] = false;
+                component.push_back(member);
+            }
+            components.push_back(std::move(component));
+        };
+
+        for (size_t sheet = 0; sheet < count; ++sheet) {
+            if (order[sheet] == UNVISITED) {
+                visit(sheet);
+            }
+        }
+        return components;
+    }
+}
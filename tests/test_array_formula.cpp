@@ -0,0 +1,108 @@
+#include <doctest/doctest.h>
+
+#include <sstream>
+
+#include "sheet.h"
+#include "test_utils.h"
+
+TEST_CASE("Array formula spills into target block") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A2"_pos, "2");
+    sheet.SetCell("A3"_pos, "3");
+    sheet.SetArrayFormula({"B1"_pos, {3, 1}}, "=A1:A3*2");
+
+    CHECK(std::get<double>(sheet.GetValue("B1"_pos)) == 2);
+    CHECK(std::get<double>(sheet.GetValue("B2"_pos)) == 4);
+    CHECK(std::get<double>(sheet.GetValue("B3"_pos)) == 6);
+    CHECK(sheet.GetCell("B1"_pos)->GetText() == "{=A1:A3*2}");
+    CHECK(sheet.GetCell("B3"_pos)->GetText().empty());
+    CHECK(std::get<double>(sheet.GetCell("B3"_pos)->GetValue()) == 6);
+
+    /// The whole block is one vertex of the dependency graph
+    CHECK(sheet.GetGraph().GetVertexCount() == 1);
+    CHECK(sheet.GetGraph().GetEdgeCount() == 3);
+
+    std::ostringstream values;
+    sheet.PrintValues(values);
+    CHECK(values.str() == "1\t2\n2\t4\n3\t6\n");
+}
+
+TEST_CASE("Array formula broadcasts rows, columns and scalars") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A2"_pos, "2");
+    sheet.SetCell("B1"_pos, "10");
+    sheet.SetCell("C1"_pos, "20");
+    sheet.SetCell("D1"_pos, "100");
+    sheet.SetArrayFormula({"B2"_pos, {2, 2}}, "=A1:A2*B1:C1+D1");
+
+    CHECK(std::get<double>(sheet.GetValue("B2"_pos)) == 110);
+    CHECK(std::get<double>(sheet.GetValue("C2"_pos)) == 120);
+    CHECK(std::get<double>(sheet.GetValue("B3"_pos)) == 120);
+    CHECK(std::get<double>(sheet.GetValue("C3"_pos)) == 140);
+
+    sheet.SetArrayFormula({"E1"_pos, {2, 1}}, "=A1:A3");
+    CHECK(std::get<FormulaError>(sheet.GetValue("E2"_pos)) == FormulaError::Category::Value);
+}
+
+TEST_CASE("Array formula invalidation and dependents of spilled cells") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A2"_pos, "2");
+    sheet.SetArrayFormula({"B1"_pos, {2, 1}}, "=A1:A2+1");
+    sheet.SetCell("C1"_pos, "=B2*10");
+    CHECK(std::get<double>(sheet.GetValue("C1"_pos)) == 30);
+
+    sheet.SetCell("A2"_pos, "5");
+    CHECK(std::get<double>(sheet.GetValue("B2"_pos)) == 6);
+    CHECK(std::get<double>(sheet.GetValue("C1"_pos)) == 60);
+
+    /// Removing the array turns spilled cells into empty cells
+    sheet.ClearCell("B1"_pos);
+    CHECK(std::get<double>(sheet.GetValue("C1"_pos)) == 0);
+    sheet.SetCell("B2"_pos, "7");
+    CHECK(std::get<double>(sheet.GetValue("C1"_pos)) == 70);
+}
+
+TEST_CASE("Array formula conflicts") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("B2"_pos, "text");
+    CHECK_THROWS_AS(sheet.SetArrayFormula({"B1"_pos, {2, 1}}, "=A1:A2"), ArrayFormulaException);
+    CHECK_THROWS_AS(sheet.SetArrayFormula({"C1"_pos, {2, 1}}, "=C1:C2"), CircularDependencyException);
+    CHECK_THROWS_AS(sheet.SetArrayFormula({"C1"_pos, {2, 1}}, "=A1:"), FormulaException);
+
+    sheet.SetCell("D1"_pos, "=C2");
+    CHECK_THROWS_AS(sheet.SetArrayFormula({"C1"_pos, {2, 1}}, "=D1:D2"), CircularDependencyException);
+
+    sheet.SetArrayFormula({"E1"_pos, {2, 1}}, "=1");
+    CHECK_THROWS_AS(sheet.SetCell("E2"_pos, "1"), ArrayFormulaException);
+    CHECK_THROWS_AS(sheet.ClearCell("E2"_pos), ArrayFormulaException);
+    CHECK_THROWS_AS(sheet.SetArrayFormula({"D2"_pos, {1, 2}}, "=1"), ArrayFormulaException);
+}
+
+TEST_CASE("Array blocks side by side") {
+    spreadsheet::Sheet sheet;
+    sheet.SetArrayFormula({"A1"_pos, {3, 2}}, "=1");
+    sheet.SetArrayFormula({"D2"_pos, {2, 2}}, "=2");
+    sheet.SetArrayFormula({"C3"_pos, {1, 1}}, "=3");
+
+    CHECK(std::get<double>(sheet.GetValue("B3"_pos)) == 1);
+    CHECK(std::get<double>(sheet.GetValue("C3"_pos)) == 3);
+    CHECK(std::get<double>(sheet.GetValue("E3"_pos)) == 2);
+    CHECK(std::get<double>(sheet.GetValue("C2"_pos)) == 0);
+    CHECK(std::get<double>(sheet.GetValue("F2"_pos)) == 0);
+    CHECK_THROWS_AS(sheet.SetCell("E2"_pos, "1"), ArrayFormulaException);
+    sheet.SetCell("C2"_pos, "=E3+C3");
+    CHECK(std::get<double>(sheet.GetValue("C2"_pos)) == 5);
+
+    /// A block replaced at its anchor or cleared frees its positions
+    sheet.SetArrayFormula({"D2"_pos, {1, 1}}, "=4");
+    CHECK(std::get<double>(sheet.GetValue("C2"_pos)) == 3);
+    sheet.SetCell("E3"_pos, "5");
+    sheet.ClearCell("A1"_pos);
+    sheet.SetCell("B3"_pos, "6");
+    sheet.SetCell("A1"_pos, "7");
+    CHECK(std::get<double>(sheet.GetValue("C2"_pos)) == 8);
+    CHECK(sheet.GetPrintableSize() == Size{3, 5});
+}
@@ -0,0 +1,118 @@
+#include <doctest/doctest.h>
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "async.h"
+#include "test_utils.h"
+
+namespace {
+    /// Coroutine started eagerly and never awaited, the way an event-loop host would run a handler
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() {
+                return {};
+            }
+            std::suspend_never initial_suspend() noexcept {
+                return {};
+            }
+            std::suspend_never final_suspend() noexcept {
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() {
+                std::terminate();
+            }
+        };
+    };
+
+    /// Event loop of the host: coroutines are resumed only on the thread that drains it
+    class EventLoop {
+    public:
+        void Post(std::coroutine_handle<> handle) {
+            const std::lock_guard lock(mutex_);
+            handles_.push_back(handle);
+        }
+
+        bool RunOne() {
+            std::coroutine_handle<> handle;
+            {
+                const std::lock_guard lock(mutex_);
+                if (handles_.empty()) {
+                    return false;
+                }
+                handle = handles_.front();
+                handles_.pop_front();
+            }
+            handle.resume();
+            return true;
+        }
+
+    private:
+        std::mutex mutex_;
+        std::deque<std::coroutine_handle<>> handles_;
+    };
+}
+
+TEST_CASE("Asynchronous operations run in submission order") {
+    spreadsheet::AsyncSheet sheet;
+    std::vector<spreadsheet::Task<void>> edits;
+    for (int row = 0; row < 100; ++row) {
+        edits.push_back(sheet.SetCellAsync({row, 0}, row == 0 ? "1" : "=A" + std::to_string(row) + "+1"));
+    }
+    const auto value = sheet.GetValueAsync({99, 0});
+
+    CHECK(value.Get() == CellInterface::Value(100.0));
+    CHECK(edits.back().IsReady());
+    CHECK(sheet.Snapshot().GetValue({99, 0}) == CellInterface::Value(100.0));
+
+    sheet.SetCellAsync("A1"_pos, "2");
+    CHECK(sheet.RecalculateAsync().Get().evaluated == 100);
+    CHECK(sheet.Submit([](const spreadsheet::Sheet& s) { return s.GetPrintableSize(); }).Get() == Size{100, 1});
+}
+
+TEST_CASE("Asynchronous operations report errors through their tasks") {
+    spreadsheet::AsyncSheet sheet;
+    const auto cycle = sheet.SetCellsAsync({{"A1"_pos, "=B1"}, {"B1"_pos, "=A1"}});
+    const auto invalid = sheet.ClearCellAsync(Position::NONE);
+    const auto value = sheet.GetValueAsync("A1"_pos);
+
+    CHECK_THROWS_AS(cycle.Get(), CircularDependencyException);
+    CHECK_THROWS_AS(invalid.Get(), InvalidPositionException);
+    CHECK(value.Get() == CellInterface::Value(0.0));
+}
+
+TEST_CASE("Coroutines await values without blocking the host thread") {
+    EventLoop loop;
+    spreadsheet::AsyncSheet sheet([&loop](std::coroutine_handle<> handle) { loop.Post(handle); });
+    const std::thread::id host = std::this_thread::get_id();
+
+    bool finished = false;
+    bool on_host = true;
+    CellInterface::Value value;
+    std::vector<std::pair<Position, std::string>> cells = {{"A1"_pos, "20"}, {"A2"_pos, "=A1+1"}};
+    /// The coroutine reads its captures through the closure, which has to outlive it
+    const auto run = [&]() -> Detached {
+        co_await sheet.SetCellsAsync(std::move(cells));
+        on_host = on_host && std::this_thread::get_id() == host;
+        value = co_await sheet.GetValueAsync("A2"_pos);
+        on_host = on_host && std::this_thread::get_id() == host;
+        finished = true;
+    };
+    run();
+
+    while (!finished) {
+        if (!loop.RunOne()) {
+            std::this_thread::yield();
+        }
+    }
+    CHECK(on_host);
+    CHECK(value == CellInterface::Value(21.0));
+}
@@ -0,0 +1,81 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sheet.h"
+#include "test_utils.h"
+
+namespace {
+    constexpr int ROWS = 1000;
+    constexpr int ARRAY_ROWS = 100;
+
+    /// Inputs in A, a running sum in B, branches in C, an array formula in E and formulas over it in F
+    void BuildModel(spreadsheet::Sheet& sheet, int seed) {
+        for (int row = 0; row < ROWS; ++row) {
+            const std::string r = std::to_string(row + 1);
+            sheet.SetCell({row, 0}, std::to_string((row * 37 + seed) % 101));
+            sheet.SetCell({row, 1}, row == 0 ? "=A1" : "=B" + std::to_string(row) + "+A" + r);
+            sheet.SetCell({row, 2}, "=IF(A" + r + ">50,B" + r + ",MAX(A" + r + ",E" + std::to_string(row % ARRAY_ROWS + 1) + "))");
+        }
+        sheet.SetArrayFormula({{0, 4}, {ARRAY_ROWS, 1}}, "=A1:A" + std::to_string(ARRAY_ROWS) + "*2");
+        for (int row = 0; row < ARRAY_ROWS; ++row) {
+            sheet.SetCell({row, 5}, "=E" + std::to_string(row + 1) + "+C" + std::to_string(ROWS - row));
+        }
+    }
+
+    std::vector<Position> GetModelPositions() {
+        std::vector<Position> result;
+        for (int row = 0; row < ROWS; ++row) {
+            for (const int col : {0, 1, 2}) {
+                result.push_back({row, col});
+            }
+        }
+        for (int row = 0; row < ARRAY_ROWS; ++row) {
+            result.push_back({row, 4});
+            result.push_back({row, 5});
+        }
+        return result;
+    }
+}
+
+TEST_CASE("Concurrent reads agree with sequential reads") {
+    constexpr int THREADS = 8;
+    const std::vector<Position> positions = GetModelPositions();
+
+    spreadsheet::Sheet sheet;
+    BuildModel(sheet, 0);
+    for (int round = 0; round < 3; ++round) {
+        spreadsheet::Sheet expected;
+        BuildModel(expected, round);
+        std::vector<CellInterface::Value> expected_values;
+        std::transform(positions.begin(), positions.end(), std::back_inserter(expected_values), [&](const Position& pos) { return expected.GetValue(pos); });
+
+        /// Every reader walks the model in its own order, through the sheet and through cell objects
+        std::atomic<int> mismatches = 0;
+        std::vector<std::thread> readers;
+        for (int thread = 0; thread < THREADS; ++thread) {
+            readers.emplace_back([&, thread] {
+                std::vector<size_t> order(positions.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::shuffle(order.begin(), order.end(), std::mt19937(thread + round * THREADS));
+                for (const size_t i : order) {
+                    const auto value = thread % 2 == 0 ? sheet.GetValue(positions[i]) : sheet.GetCell(positions[i])->GetValue();
+                    mismatches += value == expected_values[i] ? 0 : 1;
+                }
+            });
+        }
+        std::for_each(readers.begin(), readers.end(), [](std::thread& reader) { reader.join(); });
+        CHECK(mismatches == 0);
+
+        /// Edits run alone, between the rounds of reads
+        for (int row = 0; row < ROWS; ++row) {
+            sheet.SetCell({row, 0}, std::to_string((row * 37 + round + 1) % 101));
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#include <doctest/doctest.h>
+
+#include <cmath>
+#include <string>
+
+#include "formula.h"
+#include "sheet.h"
+#include "test_utils.h"
+
+TEST_CASE("Comparison operators") {
+    spreadsheet::Sheet sheet;
+    const auto evaluate = [&sheet](std::string expression) {
+        return std::get<double>(ParseFormula(std::move(expression))->Evaluate(sheet));
+    };
+
+    CHECK(evaluate("1<2") == 1);
+    CHECK(evaluate("2<=1") == 0);
+    CHECK(evaluate("1+1=2") == 1);
+    CHECK(evaluate("1<>1") == 0);
+    CHECK(evaluate("3>2>0") == 1);
+    CHECK(evaluate("(1<2)*5") == 5);
+
+    CHECK(ParseFormula("(1<2)<(3>=4)")->GetExpression() == "1<2<(3>=4)");
+    CHECK(ParseFormula("( A1 + 1 ) <> B2")->GetExpression() == "A1+1<>B2");
+    CHECK(ParseFormula("-(1<2)")->GetExpression() == "-(1<2)");
+}
+
+TEST_CASE("Conditional functions") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "5");
+    sheet.SetCell("B1"_pos, "=IF(A1>3,A1*2,A1/2)");
+    sheet.SetCell("B2"_pos, "=IF(A1>10,1)");
+    sheet.SetCell("B3"_pos, "=AND(A1>0,A1<10)+OR(A1>10,A1<0)*10+NOT(A1)*100");
+
+    CHECK(std::get<double>(sheet.GetValue("B1"_pos)) == 10);
+    CHECK(std::get<double>(sheet.GetValue("B2"_pos)) == 0);
+    CHECK(std::get<double>(sheet.GetValue("B3"_pos)) == 1);
+    CHECK(sheet.GetCell("B3"_pos)->GetText() == "=AND(A1>0,A1<10)+OR(A1>10,A1<0)*10+NOT(A1)*100");
+
+    CHECK_THROWS_AS(ParseFormula("IF(1)"), FormulaException);
+    CHECK_THROWS_AS(ParseFormula("FOO(1)"), FormulaException);
+    CHECK_THROWS_AS(ParseFormula("NOT(1,2)"), FormulaException);
+}
+
+TEST_CASE("Untaken branches are not evaluated") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "0");
+    sheet.SetCell("A2"_pos, "text");
+    sheet.SetCell("B1"_pos, "=1/A1");
+    sheet.SetCell("C1"_pos, "=IF(A1=0,0,10/A1)");
+    sheet.SetCell("C2"_pos, "=IF(A1=0,-1,B1)");
+    sheet.SetCell("C3"_pos, "=AND(A1,A2)+OR(1,A2)");
+
+    CHECK(std::get<double>(sheet.GetValue("C1"_pos)) == 0);
+    CHECK(std::get<double>(sheet.GetValue("C2"_pos)) == -1);
+    CHECK(std::get<double>(sheet.GetValue("C3"_pos)) == 1);
+    /// The untaken precedent is not forced
+    CHECK_FALSE(sheet.GetCell("B1"_pos)->HasCache());
+
+    sheet.SetCell("A1"_pos, "4");
+    CHECK(std::get<double>(sheet.GetValue("C1"_pos)) == 2.5);
+    CHECK(std::get<double>(sheet.GetValue("C2"_pos)) == 0.25);
+    CHECK(std::get<FormulaError>(sheet.GetValue("C3"_pos)) == FormulaError::Category::Value);
+}
+
+TEST_CASE("Unconditional references") {
+    /// Only the IF condition and the first AND/OR argument are read whatever the values are
+    CHECK(ParseFormula("IF(B1>0,A1,C1:C2)+MIN(D1,A2)")->GetUnconditionalCells() == std::vector{"B1"_pos, "D1"_pos, "A2"_pos});
+    CHECK(ParseFormula("AND(A1,A2)*OR(B1,B2)-NOT(C1)+A1")->GetUnconditionalCells() == std::vector{"A1"_pos, "B1"_pos, "C1"_pos});
+    CHECK(ParseFormula("-B1:B2")->GetUnconditionalCells() == std::vector{"B1"_pos, "B2"_pos});
+
+    /// Precedents read in a branch are computed on demand, after those read unconditionally
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    for (int row = 1; row < 100; ++row) {
+        sheet.SetCell({row, 0}, "=IF(A" + std::to_string(row) + ">0,A" + std::to_string(row) + "+B" + std::to_string(row) + ",0)");
+        sheet.SetCell({row - 1, 1}, "=A" + std::to_string(row));
+    }
+    CHECK(std::get<double>(sheet.GetValue("A100"_pos)) == std::pow(2., 99));
+}
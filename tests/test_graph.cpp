@@ -0,0 +1,296 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "graph.h"
+#include "test_utils.h"
+
+namespace {
+    std::vector<Position> GetTargets(const graph::DependencyGraph& graph, Position vertex, graph::DependencyGraph::Direction direction) {
+        std::vector<Position> result;
+        for (const graph::Edge& edge : graph.GetIncidentEdges(vertex, direction)) {
+            CHECK(edge.from == vertex);
+            result.push_back(edge.to);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+}
+
+TEST_CASE("Adjacency keeps edits in delta and merges them") {
+    graph::Adjacency adjacency;
+    for (graph::VertexIndex to = 1; to <= 3; ++to) {
+        adjacency.Add(0, to);
+    }
+    adjacency.Add(5, 0);
+    adjacency.Compact();
+    adjacency.Add(0, 4);
+    CHECK(adjacency.Remove(0, 2));
+    CHECK_FALSE(adjacency.Remove(0, 2));
+    CHECK_FALSE(adjacency.Remove(7, 0));
+
+    const auto neighbors = adjacency.GetNeighbors(0);
+    std::vector<graph::VertexIndex> targets(neighbors.begin(), neighbors.end());
+    std::sort(targets.begin(), targets.end());
+    CHECK(targets == std::vector<graph::VertexIndex>{1, 3, 4});
+    CHECK(adjacency.GetDegree(0) == 3);
+    CHECK(adjacency.GetEdgeCount() == 4);
+    CHECK(adjacency.GetVertexCount() == 2);
+    CHECK(adjacency.Has(0, 4));
+    CHECK_FALSE(adjacency.Has(0, 2));
+
+    std::vector<graph::VertexIndex> removed;
+    CHECK(adjacency.RemoveAll(0, [&removed](graph::VertexIndex to) { removed.push_back(to); }) == 3);
+    CHECK(removed.size() == 3);
+    CHECK(adjacency.GetVertexCount() == 1);
+    adjacency.Compact();
+    CHECK(adjacency.GetEdgeCount() == 1);
+    CHECK(adjacency.Has(5, 0));
+}
+
+TEST_CASE("Dependency graph keeps both directions in sync") {
+    graph::DependencyGraph graph;
+    const auto forward = graph::DependencyGraph::Direction::forward;
+    const auto backward = graph::DependencyGraph::Direction::backward;
+
+    CHECK(graph.AddEdge({"A1"_pos, "B1"_pos}));
+    CHECK(graph.AddEdge({"A1"_pos, "B2"_pos}));
+    CHECK(graph.AddEdge({"A2"_pos, "B1"_pos}));
+    CHECK_FALSE(graph.AddEdge({"A2"_pos, "B1"_pos}));
+    CHECK(GetTargets(graph, "B1"_pos, backward) == std::vector{"A1"_pos, "A2"_pos});
+
+    /// Erasing one edge keeps the other edges of both endpoints
+    CHECK(graph.EraseEdge({"A1"_pos, "B1"_pos}));
+    CHECK(GetTargets(graph, "A1"_pos, forward) == std::vector{"B2"_pos});
+    CHECK(GetTargets(graph, "B1"_pos, backward) == std::vector{"A2"_pos});
+
+    CHECK(graph.EraseVertex("A2"_pos));
+    CHECK_FALSE(graph.EraseVertex("A2"_pos));
+    CHECK(GetTargets(graph, "B1"_pos, backward).empty());
+    CHECK(graph.GetEdgeCount() == 1);
+    CHECK(graph.GetVertexCount() == 1);
+
+    /// Many edits go through several merges
+    for (int row = 0; row < 5000; ++row) {
+        graph.AddEdge({{row, 3}, "B1"_pos});
+        if (row % 2 == 0) {
+            graph.EraseVertex({row, 3});
+        }
+    }
+    CHECK(graph.GetEdgeCount() == 2501);
+    CHECK(GetTargets(graph, "B1"_pos, backward).size() == 2500);
+    CHECK(GetTargets(graph, {4999, 3}, forward) == std::vector{"B1"_pos});
+}
+
+TEST_CASE("Dependency graph matches a reference model under random edits") {
+    graph::DependencyGraph graph;
+    std::set<std::pair<Position, Position>> model;
+    std::mt19937 random(7);
+    /// A few hot cells make the backward lists long, as in sheets with one input referenced everywhere
+    const auto random_position = [&random](int size) { return Position{static_cast<int>(random() % size), static_cast<int>(random() % 4)}; };
+
+    const auto check = [&] {
+        CHECK(graph.GetEdgeCount() == model.size());
+        std::set<std::pair<Position, Position>> forward_edges;
+        std::set<std::pair<Position, Position>> backward_edges;
+        for (int row = 0; row < 64; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                for (const graph::Edge& edge : graph.GetIncidentEdges({row, col}, graph::DependencyGraph::Direction::forward)) {
+                    CHECK(forward_edges.emplace(edge.from, edge.to).second);
+                }
+                for (const graph::Edge& edge : graph.GetIncidentEdges({row, col}, graph::DependencyGraph::Direction::backward)) {
+                    CHECK(backward_edges.emplace(edge.to, edge.from).second);
+                }
+            }
+        }
+        CHECK(forward_edges == model);
+        CHECK(backward_edges == model);
+    };
+
+    for (int step = 0; step < 40000; ++step) {
+        const Position from = random_position(64);
+        const Position to = random() % 2 == 0 ? random_position(4) : random_position(64);
+    switch (random() % 8) {
+        case 0: {
+            const bool erased = std::erase_if(model, [&from](const auto& edge) { return edge.first == from; }) > 0;
+            CHECK(graph.EraseVertex(from) == erased);
+            break;
+        }
+        case 1:
+        case 2:
+            CHECK(graph.EraseEdge({from, to}) == (model.erase({from, to}) > 0));
+            break;
+        default:
+            CHECK(graph.AddEdge({from, to}) == model.emplace(from, to).second);
+        }
+        if (step % 1000 == 0) {
+            check();
+        }
+    }
+    check();
+}
+
+TEST_CASE("Traverser visits each reachable vertex once and stops early") {
+    /// 0 -> 1 -> 3, 0 -> 2 -> 3 -> 4, 5 is unreachable
+    graph::Adjacency adjacency;
+    adjacency.Add(0, 1);
+    adjacency.Add(0, 2);
+    adjacency.Add(1, 3);
+    adjacency.Add(2, 3);
+    adjacency.Add(3, 4);
+    adjacency.Add(5, 0);
+
+    graph::Traverser traverser;
+    for (const auto order : {graph::Traverser::Order::depth_first, graph::Traverser::Order::breadth_first}) {
+        std::vector<graph::VertexIndex> visited;
+        CHECK_FALSE(traverser.Run(adjacency, 6, {0}, order, [&visited](graph::VertexIndex, graph::VertexIndex to) {
+            visited.push_back(to);
+            return false;
+        }));
+        if (order == graph::Traverser::Order::breadth_first) {
+            CHECK(visited == std::vector<graph::VertexIndex>{1, 2, 3, 4});
+        }
+        std::sort(visited.begin(), visited.end());
+        CHECK(visited == std::vector<graph::VertexIndex>{1, 2, 3, 4});
+    }
+
+    size_t calls = 0;
+    CHECK(traverser.Run(adjacency, 6, {5, 3}, graph::Traverser::Order::breadth_first, [&calls](graph::VertexIndex, graph::VertexIndex to) {
+        ++calls;
+        return to == 1;
+    }));
+    CHECK(calls <= 3);
+}
+
+TEST_CASE("Long dependency chains do not overflow the stack") {
+    constexpr int LENGTH = 100'000;
+    const auto chain_position = [](int index) { return Position{index % Position::MAX_ROWS, index / Position::MAX_ROWS}; };
+
+    auto sheet = CreateSheet();
+    sheet->SetCell(chain_position(0), "1");
+    for (int i = 1; i < LENGTH; ++i) {
+        sheet->SetCell(chain_position(i), "=" + chain_position(i - 1).ToString() + "+1");
+        /// Evaluating in order keeps each evaluation one level deep
+        sheet->GetCell(chain_position(i))->GetValue();
+    }
+    CHECK(std::get<double>(sheet->GetCell(chain_position(LENGTH - 1))->GetValue()) == LENGTH);
+
+    CHECK_THROWS_AS(sheet->SetCell(chain_position(0), "=" + chain_position(LENGTH - 1).ToString()), CircularDependencyException);
+
+    /// Invalidation reaches the end of the chain
+    sheet->SetCell(chain_position(0), "2");
+    for (int i = 1; i < LENGTH; ++i) {
+        sheet->GetCell(chain_position(i))->GetValue();
+    }
+    CHECK(std::get<double>(sheet->GetCell(chain_position(LENGTH - 1))->GetValue()) == LENGTH + 1);
+}
+
+TEST_CASE("Dependency graph keeps a topological order and detects cycles with it") {
+    graph::DependencyGraph graph;
+    graph::DirectedGraph reference;
+    std::vector<std::pair<Position, Position>> edges;
+    std::mt19937 random(11);
+    const auto random_position = [&random] { return Position{static_cast<int>(random() % 200), 0}; };
+
+    for (int step = 0; step < 3000; ++step) {
+        const Position from = random_position();
+        const std::vector<Position> refs = {random_position(), random_position()};
+
+        /// A plain search from every reference is the reference answer
+        const bool expected = reference.DetectCircularDependency(from, refs);
+        REQUIRE(graph.DetectCircularDependency(from, refs) == expected);
+        if (expected) {
+            continue;
+        }
+        for (const Position& ref : refs) {
+            graph.AddEdge({from, ref});
+            reference.AddEdge({from, ref});
+            edges.emplace_back(from, ref);
+        }
+        if (step % 7 == 0) {
+            graph.EraseVertex(from);
+            reference.EraseVertex(from);
+            std::erase_if(edges, [&from](const auto& edge) { return edge.first == from; });
+        }
+    }
+
+    CHECK(graph.HasTopologicalOrder());
+    CHECK(std::all_of(edges.begin(), edges.end(), [&graph](const auto& edge) {
+        return graph.GetTopologicalIndex(edge.second) < graph.GetTopologicalIndex(edge.first);
+    }));
+}
+
+TEST_CASE("Bulk edge insertion matches edge by edge insertion") {
+    constexpr int VERTICES = 500;
+    std::mt19937 random(5);
+    const auto random_edges = [&random](size_t count) {
+        graph::EdgeContainer edges;
+        while (edges.size() < count) {
+            const int from = static_cast<int>(random() % VERTICES);
+            const int to = static_cast<int>(random() % VERTICES);
+            if (to < from) {
+                edges.push_back({{from, 0}, {to, 0}});
+            }
+        }
+        return edges;
+    };
+
+    graph::DependencyGraph expected;
+    graph::DependencyGraph bulk;
+    const auto check = [&] {
+        REQUIRE(bulk.GetEdgeCount() == expected.GetEdgeCount());
+        REQUIRE(bulk.GetVertexCount() == expected.GetVertexCount());
+        CHECK(bulk.HasTopologicalOrder());
+        for (int row = 0; row < VERTICES; ++row) {
+            const Position vertex{row, 0};
+            for (const auto direction : {graph::DependencyGraph::Direction::forward, graph::DependencyGraph::Direction::backward}) {
+                const auto targets = GetTargets(bulk, vertex, direction);
+                REQUIRE(targets == GetTargets(expected, vertex, direction));
+                if (direction == graph::DependencyGraph::Direction::forward) {
+                    CHECK(std::all_of(targets.begin(), targets.end(), [&](const Position& to) {
+                        return bulk.GetTopologicalIndex(to) < bulk.GetTopologicalIndex(vertex);
+                    }));
+                }
+            }
+        }
+    };
+
+    /// An empty graph is built in bulk, duplicates are dropped
+    auto edges = random_edges(4000);
+    edges.insert(edges.end(), edges.begin(), edges.begin() + 100);
+    std::for_each(edges.begin(), edges.end(), [&expected](const graph::Edge& edge) { expected.AddEdge(edge); });
+    CHECK(bulk.AddEdges(edges.begin(), edges.end()) == expected.GetEdgeCount());
+    check();
+
+    /// Erased edges leave no stale entries behind the rebuilt arrays
+    for (int row = 0; row < VERTICES; row += 3) {
+        expected.EraseVertex({row, 0});
+        bulk.EraseVertex({row, 0});
+    }
+    check();
+
+    /// A large batch rebuilds the graph with its current edges, a small one is added edge by edge
+    for (const size_t count : {3000, 20}) {
+        edges = random_edges(count);
+        const size_t before = expected.GetEdgeCount();
+        std::for_each(edges.begin(), edges.end(), [&expected](const graph::Edge& edge) { expected.AddEdge(edge); });
+        CHECK(bulk.AddEdges(edges.begin(), edges.end()) == expected.GetEdgeCount() - before);
+        check();
+    }
+    CHECK_FALSE(bulk.DetectCircularDependency({1, 0}, {{2, 0}}));
+    CHECK(bulk.DetectCircularDependency({0, 0}, {{VERTICES - 1, 0}}) == expected.DetectCircularDependency({0, 0}, {{VERTICES - 1, 0}}));
+
+    /// A cycle in the batch drops the order, cycle checks still work without it
+    edges = {{{0, 1}, {1, 1}}, {{1, 1}, {2, 1}}, {{2, 1}, {0, 1}}};
+    graph::DependencyGraph cyclic;
+    CHECK(cyclic.AddEdges(edges.begin(), edges.end()) == 3);
+    CHECK_FALSE(cyclic.HasTopologicalOrder());
+    CHECK(cyclic.DetectCircularDependency({3, 1}, {{0, 1}}) == false);
+    CHECK(cyclic.DetectCircularDependency({1, 1}, {{0, 1}}));
+}
@@ -0,0 +1,151 @@
+#include <doctest/doctest.h>
+
+#include <string>
+#include <vector>
+
+#include "query.h"
+#include "sheet.h"
+#include "test_utils.h"
+
+using spreadsheet::query::Column;
+using spreadsheet::query::RowBitmap;
+
+TEST_CASE("Row bitmap") {
+    RowBitmap lhs(130);
+    RowBitmap rhs(130);
+    lhs.Set(0);
+    lhs.Set(64);
+    lhs.Set(129);
+    rhs.Set(64);
+    rhs.Set(100);
+
+    CHECK((lhs & rhs).ToRows() == std::vector<int>{64});
+    CHECK((lhs | rhs).ToRows() == std::vector<int>{0, 64, 100, 129});
+    CHECK((~lhs).Count() == 127);
+    CHECK_FALSE((~lhs).Test(129));
+    CHECK(RowBitmap(130, true).Count() == 130);
+}
+
+TEST_CASE("Query selects rows by predicates") {
+    spreadsheet::Sheet sheet;
+    const std::vector<std::string> statuses = {"OPEN", "CLOSED", "'OPEN"};
+    for (int row = 0; row < 200; ++row) {
+        sheet.SetCell({row, 0}, std::to_string(row * 10));
+        sheet.SetCell({row, 1}, statuses[row % 3]);
+    }
+    sheet.SetCell({200, 0}, "text");
+    sheet.SetCell({201, 0}, "=A1/0");
+    sheet.SetCell({202, 0}, "=A101+1");
+    sheet.SetCell({203, 2}, "1");
+
+    spreadsheet::query::Query query(sheet);
+    const auto amounts = query.Select(Column{0} > 1000.);
+    CHECK(amounts.Size() == 204);
+    CHECK(amounts.Count() == 99 + 1);
+    CHECK(amounts.Test(202));
+    CHECK_FALSE(amounts.Test(100));
+
+    CHECK(query.Select(Column{0} == 1001.).ToRows() == std::vector<int>{202});
+    CHECK(query.Select(Column{0} != 0.).Count() == 199 + 1);
+    CHECK(query.Select(Column{0} <= 20.).ToRows() == std::vector<int>{0, 1, 2});
+    CHECK(query.Select(Column{0} == "text").ToRows() == std::vector<int>{200});
+    CHECK(query.Select(Column{1} == "OPEN").Count() == 133);
+    CHECK(query.Select(Column{2} == 0.).Count() == 0);
+
+    const auto rows = query.SelectAll({Column{0} >= 1000., Column{0} < 1100., Column{1} == "CLOSED"}).ToRows();
+    CHECK(rows == std::vector<int>{100, 103, 106, 109});
+    CHECK(query.SelectAny({Column{0} < 10., Column{0} > 1980.}).ToRows() == std::vector<int>{0, 199});
+}
+
+TEST_CASE("Query reads number texts as formulas do") {
+    spreadsheet::Sheet sheet;
+    const std::vector<std::string> texts = {"+5", " 5", "0x10", "5 ", "1e999", "five"};
+    for (int row = 0; row < static_cast<int>(texts.size()); ++row) {
+        sheet.SetCell({row, 0}, texts[row]);
+        sheet.SetCell({row, 1}, "=A" + std::to_string(row + 1) + ">1");
+    }
+
+    spreadsheet::query::Query query(sheet);
+    CHECK(query.Select(Column{0} > 1.).ToRows() == std::vector<int>{0, 1, 2});
+    for (int row = 0; row < static_cast<int>(texts.size()); ++row) {
+        CAPTURE(texts[row]);
+        CHECK((sheet.GetValue({row, 1}) == CellInterface::Value(1.0)) == query.Select(Column{0} > 1.).Test(row));
+    }
+}
+
+TEST_CASE("Query reads spilled array values") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A2"_pos, "2");
+    sheet.SetCell("A3"_pos, "3");
+    sheet.SetArrayFormula({"B1"_pos, {3, 1}}, "=A1:A3*10");
+
+    spreadsheet::query::Query query(sheet);
+    CHECK(query.Select(Column{1} >= 20.).ToRows() == std::vector<int>{1, 2});
+}
+
+TEST_CASE("Group by aggregates rows by keys") {
+    spreadsheet::Sheet sheet;
+    const std::vector<std::string> regions = {"north", "south", "west"};
+    for (int row = 0; row < 9000; ++row) {
+        sheet.SetCell({row, 0}, regions[row % 3]);
+        sheet.SetCell({row, 1}, std::to_string(row % 2));
+        sheet.SetCell({row, 2}, std::to_string(row));
+    }
+    sheet.SetCell({9000, 2}, "100");  // row without keys
+    sheet.SetCell({9001, 0}, "north");
+    sheet.SetCell({9001, 1}, "=1-1");
+    sheet.SetCell({9001, 2}, "n/a");
+
+    using spreadsheet::query::AggregateKind;
+    spreadsheet::query::Query query(sheet);
+    const std::vector<spreadsheet::query::Aggregate> aggregates = {
+        {2, AggregateKind::Sum}, {2, AggregateKind::Count}, {2, AggregateKind::Min}, {2, AggregateKind::Max}, {2, AggregateKind::Average}};
+
+    for (size_t threads : {1, 4}) {
+        const auto table = query.GroupBy({0, 1}, aggregates, nullptr, threads);
+        REQUIRE(table.GetGroupCount() == 6);
+        CHECK(table.keys[0] == CellInterface::Value(std::string("north")));
+        CHECK(table.keys[1] == CellInterface::Value(std::string("0")));
+        CHECK(table.keys[2] == CellInterface::Value(std::string("south")));
+        CHECK(table.keys[3] == CellInterface::Value(std::string("1")));
+
+        /// north/0 are rows 0, 6, 12, ... 8994 and the row with a text value
+        CHECK(table.rows[0] == 1501);
+        CHECK(table.values[0] == 1500 * 8994 / 2);
+        CHECK(table.values[1] == 1500);
+        CHECK(table.values[2] == 0);
+        CHECK(table.values[3] == 8994);
+        CHECK(table.values[4] == 8994 / 2);
+    }
+
+    const auto west = query.Select(Column{0} == "west");
+    const auto table = query.GroupBy({1}, {{2, AggregateKind::Count}}, &west);
+    REQUIRE(table.GetGroupCount() == 2);
+    CHECK(table.values == std::vector<double>{1500, 1500});
+
+    table.WriteTo(sheet, "E1"_pos);
+    CHECK(sheet.GetCell("E2"_pos)->GetText() == "1");
+    CHECK(sheet.GetCell("F1"_pos)->GetText() == "1500");
+}
+
+TEST_CASE("Group tables are written without losing digits") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "x");
+    sheet.SetCell("B1"_pos, "1234567.125");
+    sheet.SetCell("A2"_pos, "x");
+    sheet.SetCell("B2"_pos, "1000000.125");
+    sheet.SetCell("A3"_pos, "y");
+    sheet.SetCell("B3"_pos, "0.1");
+
+    using spreadsheet::query::AggregateKind;
+    const auto table = spreadsheet::query::Query(sheet).GroupBy({0}, {{1, AggregateKind::Sum}});
+    REQUIRE(table.GetGroupCount() == 2);
+    table.WriteTo(sheet, "D1"_pos);
+    sheet.SetCell("F1"_pos, "=E1");
+    sheet.SetCell("F2"_pos, "=E2");
+
+    CHECK(sheet.GetCell("E1"_pos)->GetText() == "2234567.25");
+    CHECK(std::get<double>(sheet.GetValue("F1"_pos)) == 2234567.25);
+    CHECK(std::get<double>(sheet.GetValue("F2"_pos)) == 0.1);
+}
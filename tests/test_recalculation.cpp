@@ -0,0 +1,282 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "parallel.h"
+#include "sheet.h"
+#include "test_utils.h"
+
+namespace {
+    Position GetChainPosition(int index) {
+        return {index % Position::MAX_ROWS, index / Position::MAX_ROWS};
+    }
+
+    /// Cell 0 holds `first`, every next cell adds one to the previous
+    void BuildChain(spreadsheet::Sheet& sheet, int length, const std::string& first) {
+        sheet.SetCell(GetChainPosition(0), first);
+        for (int i = 1; i < length; ++i) {
+            sheet.SetCell(GetChainPosition(i), "=" + GetChainPosition(i - 1).ToString() + "+1");
+        }
+    }
+
+    double GetNumber(const spreadsheet::Sheet& sheet, Position pos) {
+        return std::get<double>(sheet.GetValue(pos));
+    }
+}
+
+TEST_CASE("Deep chains are evaluated without recursion") {
+    constexpr int LENGTH = 200'000;
+    spreadsheet::Sheet sheet;
+    BuildChain(sheet, LENGTH, "1");
+
+    /// Nothing was read while building, the whole chain is evaluated by one read
+    CHECK(GetNumber(sheet, GetChainPosition(LENGTH - 1)) == LENGTH);
+    CHECK(std::get<double>(sheet.GetCell(GetChainPosition(LENGTH - 2))->GetValue()) == LENGTH - 1);
+
+    sheet.SetCell(GetChainPosition(0), "5");
+    CHECK_FALSE(sheet.GetCell(GetChainPosition(LENGTH - 1))->HasCache());
+    sheet.Recalculate();
+    CHECK(sheet.GetCell(GetChainPosition(LENGTH - 1))->HasCache());
+    CHECK(GetNumber(sheet, GetChainPosition(LENGTH - 1)) == LENGTH + 4);
+}
+
+TEST_CASE("Lazy recalculation computes values when read") {
+    spreadsheet::Sheet sheet;
+    CHECK(sheet.GetRecalculationMode() == spreadsheet::RecalculationMode::lazy);
+    BuildChain(sheet, 3, "1");
+
+    sheet.SetCell("A1"_pos, "2");
+    CHECK_FALSE(sheet.GetCell("A3"_pos)->HasCache());
+    CHECK(GetNumber(sheet, "A3"_pos) == 4);
+    CHECK(sheet.GetCell("A2"_pos)->HasCache());
+}
+
+TEST_CASE("Eager recalculation computes values on edit") {
+    spreadsheet::Sheet sheet;
+    BuildChain(sheet, 3, "1");
+    sheet.SetRecalculationMode(spreadsheet::RecalculationMode::eager);
+    CHECK(sheet.GetCell("A3"_pos)->HasCache());
+
+    sheet.SetCell("A1"_pos, "3");
+    CHECK(sheet.GetCell("A2"_pos)->HasCache());
+    CHECK(sheet.GetCell("A3"_pos)->HasCache());
+    CHECK(GetNumber(sheet, "A3"_pos) == 5);
+
+    sheet.ClearCell("A1"_pos);
+    CHECK(sheet.GetCell("A3"_pos)->HasCache());
+    CHECK(GetNumber(sheet, "A3"_pos) == 2);
+}
+
+TEST_CASE("Manual recalculation keeps old values until requested") {
+    spreadsheet::Sheet sheet;
+    BuildChain(sheet, 3, "1");
+    CHECK(GetNumber(sheet, "A3"_pos) == 3);
+
+    sheet.SetRecalculationMode(spreadsheet::RecalculationMode::manual);
+    sheet.SetCell("A1"_pos, "10");
+    CHECK(std::get<std::string>(sheet.GetValue("A1"_pos)) == "10");
+    CHECK(GetNumber(sheet, "A3"_pos) == 3);
+
+    sheet.Recalculate();
+    CHECK(GetNumber(sheet, "A2"_pos) == 11);
+    CHECK(GetNumber(sheet, "A3"_pos) == 12);
+
+    /// Leaving the manual mode applies pending edits
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetRecalculationMode(spreadsheet::RecalculationMode::lazy);
+    CHECK(GetNumber(sheet, "A3"_pos) == 3);
+}
+
+TEST_CASE("Parallel recalculation matches sequential results") {
+    constexpr int ROWS = 3000;
+    const auto fill = [](spreadsheet::Sheet& sheet) {
+        std::mt19937 random(5);
+        for (int row = 0; row < ROWS; ++row) {
+            sheet.SetCell({row, 0}, std::to_string(row % 17));
+            /// Wide independent rows, plus references to random earlier rows deepening the DAG
+            const std::string earlier = row > 0 ? Position{static_cast<int>(random() % row), 1}.ToString() : "A1";
+            sheet.SetCell({row, 1}, "=" + Position{row, 0}.ToString() + "*2+IF(" + earlier + ">100,1," + earlier + "/3)");
+            sheet.SetCell({row, 2}, "=" + Position{row, 1}.ToString() + "-" + Position{static_cast<int>(random() % ROWS), 0}.ToString());
+        }
+    };
+
+    spreadsheet::Sheet sequential;
+    sequential.SetRecalculationThreads(1);
+    spreadsheet::Sheet concurrent;
+    concurrent.SetRecalculationThreads(4);
+    CHECK(concurrent.GetRecalculationThreads() == 4);
+    for (spreadsheet::Sheet* sheet : {&sequential, &concurrent}) {
+        sheet->SetRecalculationMode(spreadsheet::RecalculationMode::manual);
+        fill(*sheet);
+        sheet->Recalculate();
+        sheet->SetCell("A1"_pos, "1000");
+        sheet->Recalculate();
+    }
+
+    for (int row = 0; row < ROWS; ++row) {
+        for (int col = 1; col < 3; ++col) {
+            REQUIRE(concurrent.GetCell({row, col})->HasCache());
+            REQUIRE(sequential.GetValue({row, col}) == concurrent.GetValue({row, col}));
+        }
+    }
+}
+
+TEST_CASE("Work-stealing pool runs DAGs repeatedly on the same workers") {
+    /// A 64 x 64 grid: every task waits for its left and upper neighbours
+    constexpr size_t SIDE = 64;
+    constexpr size_t TASKS = SIDE * SIDE;
+
+    parallel::WorkStealingPool pool(4);
+    CHECK(pool.GetThreadCount() == 4);
+    const auto run_grid = [&](size_t failing) {
+        std::vector<std::atomic<std::uint32_t>> pending(TASKS);
+        for (size_t task = 0; task < TASKS; ++task) {
+            pending[task] = (task % SIDE != 0 ? 1 : 0) + (task >= SIDE ? 1 : 0);
+        }
+        std::vector<std::atomic<bool>> done(TASKS);
+        std::atomic<size_t> early = 0;
+        pool.RunDag(
+            pending,
+            [&](size_t task) {
+                if (task == failing) {
+                    throw std::runtime_error("failing task");
+                }
+                if ((task % SIDE != 0 && !done[task - 1]) || (task >= SIDE && !done[task - SIDE])) {
+                    ++early;
+                }
+                done[task] = true;
+            },
+            [&](size_t task, const auto& action) {
+                if (task % SIDE != SIDE - 1) {
+                    action(task + 1);
+                }
+                if (task + SIDE < TASKS) {
+                    action(task + SIDE);
+                }
+            });
+        return std::count(done.begin(), done.end(), true) == static_cast<std::ptrdiff_t>(TASKS) && early == 0;
+    };
+
+    CHECK(run_grid(TASKS));
+    CHECK(run_grid(TASKS));
+    CHECK_THROWS_AS(run_grid(TASKS / 2), std::runtime_error);
+    CHECK(run_grid(TASKS));
+}
+
+TEST_CASE("Recalculation stops where values do not change") {
+    spreadsheet::Sheet sheet;
+    sheet.SetRecalculationMode(spreadsheet::RecalculationMode::manual);
+    sheet.SetCell("A1"_pos, "20");
+    sheet.SetCell("B1"_pos, "=MAX(0,MIN(10,A1))");
+    sheet.SetCell("C1"_pos, "=B1*2");
+    for (int row = 1; row < 100; ++row) {
+        sheet.SetCell({row, 2}, "=" + Position{row - 1, 2}.ToString() + "+1");
+    }
+    sheet.Recalculate();
+    CHECK(GetNumber(sheet, "C100"_pos) == 119);
+
+    /// The clamp saturates: only the input and the clamp are computed
+    sheet.SetCell("A1"_pos, "30");
+    auto stats = sheet.Recalculate();
+    CHECK(stats.evaluated == 2);
+    CHECK(stats.revalidated == 100);
+    CHECK(GetNumber(sheet, "C100"_pos) == 119);
+
+    sheet.SetCell("A1"_pos, "-4");
+    stats = sheet.Recalculate();
+    CHECK(stats.evaluated == 102);
+    CHECK(stats.revalidated == 0);
+    CHECK(GetNumber(sheet, "C100"_pos) == 99);
+}
+
+TEST_CASE("Values read between edits are not mistaken for unchanged ones") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("B1"_pos, "=MIN(A1,5)");
+    sheet.SetCell("C1"_pos, "=B1+1");
+    CHECK(GetNumber(sheet, "C1"_pos) == 2);
+
+    /// B1 changes while C1 is not read, then gets the same value again
+    sheet.SetCell("A1"_pos, "3");
+    CHECK(GetNumber(sheet, "B1"_pos) == 3);
+    sheet.SetCell("A1"_pos, "7");
+    CHECK(GetNumber(sheet, "B1"_pos) == 5);
+    sheet.SetCell("A1"_pos, "5");
+    sheet.Recalculate();
+    CHECK(GetNumber(sheet, "C1"_pos) == 6);
+}
+
+TEST_CASE("Time-sliced recalculation resumes and restarts after edits") {
+    constexpr int LENGTH = 1000;
+    spreadsheet::Sheet sheet;
+    BuildChain(sheet, LENGTH, "1");
+    sheet.Recalculate();
+
+    /// A zero budget still processes one cell per call, in topological order, and finds its dependents
+    sheet.SetCell(GetChainPosition(0), "2");
+    auto progress = sheet.RunFor(std::chrono::microseconds(0));
+    CHECK(progress.stats.evaluated == 1);
+    CHECK(progress.done == 1);
+    CHECK(progress.remaining == 1);
+    progress = sheet.RunFor(std::chrono::microseconds(0));
+    CHECK(progress.done == 2);
+    CHECK(GetNumber(sheet, GetChainPosition(1)) == 3.0);
+
+    /// Values are consistent between slices: cells not reached yet are computed on demand
+    CHECK(GetNumber(sheet, GetChainPosition(LENGTH / 2)) == LENGTH / 2 + 2.0);
+
+    /// An edit supersedes the pass: the next call plans the cells left and the ones the edit affects
+    sheet.SetCell(GetChainPosition(LENGTH - 10), "0");
+    progress = sheet.RunFor(std::chrono::microseconds(0));
+    CHECK(progress.done == 1);
+    while (!progress.IsComplete()) {
+        progress = sheet.RunFor(std::chrono::milliseconds(1));
+    }
+    CHECK(GetNumber(sheet, GetChainPosition(LENGTH - 11)) == LENGTH - 11 + 2.0);
+    CHECK(GetNumber(sheet, GetChainPosition(LENGTH - 1)) == 9.0);
+    CHECK(sheet.RunFor(std::chrono::microseconds(0)).done == 0);
+    CHECK(sheet.Recalculate().evaluated == 0);
+}
+
+TEST_CASE("Time-sliced recalculation publishes values in manual mode") {
+    spreadsheet::Sheet sheet;
+    sheet.SetRecalculationMode(spreadsheet::RecalculationMode::manual);
+    BuildChain(sheet, 100, "1");
+    sheet.Recalculate();
+
+    sheet.SetCell(GetChainPosition(0), "5");
+    CHECK(GetNumber(sheet, GetChainPosition(99)) == 100.0);
+    const auto progress = sheet.RunFor(std::chrono::seconds(10));
+    CHECK(progress.IsComplete());
+    CHECK(progress.stats.evaluated == 100);
+    CHECK(GetNumber(sheet, GetChainPosition(99)) == 104.0);
+}
+
+TEST_CASE("Viewport reads evaluate only what the viewport shows") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A2"_pos, "=A1+1");
+    sheet.SetCell("B2"_pos, "text");
+    sheet.SetCell("D1"_pos, "=A1*100");
+    sheet.SetCell("A9"_pos, "=A2*2");
+    sheet.SetArrayFormula({"C1"_pos, {2, 1}}, "=A1:A2*10");
+
+    const auto values = sheet.GetValues({"A2"_pos, {2, 3}});
+    CHECK(values == std::vector<CellInterface::Value>{2.0, std::string("text"), 20.0, 0.0, 0.0, 0.0});
+
+    /// Precedents of the viewport are computed, cells off-screen are left outdated
+    CHECK(sheet.GetCell("A1"_pos)->HasCache());
+    CHECK_FALSE(sheet.GetCell("D1"_pos)->HasCache());
+    CHECK_FALSE(sheet.GetCell("A9"_pos)->HasCache());
+    CHECK(sheet.Recalculate().evaluated == 2);
+
+    CHECK_THROWS_AS(static_cast<void>(sheet.GetValues({"A1"_pos, {0, 1}})), InvalidPositionException);
+}
@@ -0,0 +1,89 @@
+#include <doctest/doctest.h>
+
+#include <sstream>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "sheet.h"
+#include "test_utils.h"
+
+namespace {
+    std::string GetTexts(const spreadsheet::Sheet& sheet) {
+        std::ostringstream output;
+        sheet.PrintTexts(output);
+        return output.str();
+    }
+
+    double GetNumber(const spreadsheet::Sheet& sheet, Position pos) {
+        return std::get<double>(sheet.GetValue(pos));
+    }
+}
+
+TEST_CASE("Set cells fills a block at once") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCells({{"A1"_pos, "1"}, {"A2"_pos, "=A1+1"}, {"A3"_pos, "=A2+D1"}, {"B1"_pos, "text"}, {"A1"_pos, "2"}});
+
+    CHECK(sheet.GetCell("A1"_pos)->GetText() == "2");
+    CHECK(GetNumber(sheet, "A3"_pos) == 3);
+    /// Referenced cells are created empty, as by `SetCell`
+    CHECK(sheet.GetCell("D1"_pos) != nullptr);
+    CHECK(sheet.GetPrintableSize() == Size{3, 4});
+    CHECK(sheet.GetGraph().HasEdge({"A3"_pos, "A2"_pos}));
+    CHECK(sheet.GetGraph().GetEdgeCount() == 3);
+}
+
+TEST_CASE("Set cells invalidates dependents of the batch") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A2"_pos, "2");
+    sheet.SetCell("B1"_pos, "=A1+A2");
+    sheet.SetCell("C1"_pos, "=B1*10");
+    CHECK(GetNumber(sheet, "C1"_pos) == 30);
+
+    sheet.SetCells({{"A1"_pos, "5"}, {"A2"_pos, "=A1*2"}});
+    CHECK(GetNumber(sheet, "C1"_pos) == 150);
+
+    sheet.SetRecalculationMode(spreadsheet::RecalculationMode::eager);
+    sheet.SetCells({{"A1"_pos, "1"}});
+    CHECK(sheet.GetCell("C1"_pos)->HasCache());
+    CHECK(GetNumber(sheet, "C1"_pos) == 30);
+}
+
+TEST_CASE("Set cells may swap the direction of references") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "=B1+1");
+    sheet.SetCell("B1"_pos, "1");
+    CHECK(GetNumber(sheet, "A1"_pos) == 2);
+
+    /// Either write alone would make a cycle with the current reference of the other cell
+    sheet.SetCells({{"B1"_pos, "=A1+1"}, {"A1"_pos, "5"}});
+    CHECK(GetNumber(sheet, "B1"_pos) == 6);
+    const auto refs = sheet.GetGraph().GetIncidentEdges("A1"_pos, graph::DependencyGraph::Direction::forward);
+    CHECK(refs.begin() == refs.end());
+}
+
+TEST_CASE("Failed set cells leaves the sheet untouched") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("B1"_pos, "=A1");
+    sheet.SetCell("C1"_pos, "=B1");
+    sheet.SetArrayFormula({"E1"_pos, {2, 1}}, "=A1:A2");
+    CHECK(GetNumber(sheet, "C1"_pos) == 1);
+    const std::string texts = GetTexts(sheet);
+    const size_t edges = sheet.GetGraph().GetEdgeCount();
+
+    /// Cycles inside the batch, through unchanged cells and self-references
+    CHECK_THROWS_AS(sheet.SetCells({{"A1"_pos, "2"}, {"F5"_pos, "=G5"}, {"G5"_pos, "=F5"}}), CircularDependencyException);
+    CHECK_THROWS_AS(sheet.SetCells({{"A2"_pos, "3"}, {"A1"_pos, "=C1"}}), CircularDependencyException);
+    CHECK_THROWS_AS(sheet.SetCells({{"H1"_pos, "=H1"}}), CircularDependencyException);
+    CHECK_THROWS_AS(sheet.SetCells({{"A1"_pos, "2"}, {"A2"_pos, "=1+"}}), FormulaException);
+    CHECK_THROWS_AS(sheet.SetCells({{"A1"_pos, "2"}, {"E2"_pos, "3"}}), ArrayFormulaException);
+    CHECK_THROWS_AS(sheet.SetCells({{"A1"_pos, "2"}, {Position::NONE, "3"}}), InvalidPositionException);
+
+    CHECK(GetTexts(sheet) == texts);
+    CHECK(sheet.GetGraph().GetEdgeCount() == edges);
+    CHECK(sheet.GetCell("H1"_pos) == nullptr);
+    CHECK(sheet.GetCell("C1"_pos)->HasCache());
+    CHECK(GetNumber(sheet, "C1"_pos) == 1);
+}
@@ -0,0 +1,126 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "sharded_sheet.h"
+#include "test_utils.h"
+
+TEST_CASE("Sharded sheet follows references across bands") {
+    spreadsheet::ShardedSheet sheet(10);
+    CHECK(sheet.GetShardCount() == (Position::MAX_ROWS + 9) / 10);
+
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A25"_pos, "=A1*2");
+    sheet.SetCell("A5"_pos, "=A25+1");
+    sheet.SetCell("B40"_pos, "=A5+A25");
+    CHECK(sheet.GetValue("B40"_pos) == CellInterface::Value(5.0));
+
+    /// Changed values reach readers in other bands, through as many bands as it takes
+    sheet.SetCell("A1"_pos, "10");
+    CHECK(sheet.GetValue("A5"_pos) == CellInterface::Value(21.0));
+    CHECK(sheet.GetValue("B40"_pos) == CellInterface::Value(41.0));
+
+    /// A reader that stops referencing another band no longer follows it
+    sheet.SetCell("A5"_pos, "7");
+    sheet.SetCell("A25"_pos, "3");
+    CHECK(sheet.GetValue("B40"_pos) == CellInterface::Value(10.0));
+    sheet.ClearCell("A25"_pos);
+    CHECK(sheet.GetValue("B40"_pos) == CellInterface::Value(7.0));
+    CHECK(sheet.GetText("A5"_pos) == "7");
+    CHECK(sheet.GetPrintableSize() == Size{40, 2});
+}
+
+TEST_CASE("Sharded sheet rejects cycles across bands") {
+    spreadsheet::ShardedSheet sheet(10);
+    sheet.SetCell("A1"_pos, "=A25");
+    CHECK_THROWS_AS(sheet.SetCell("A25"_pos, "=A1+1"), CircularDependencyException);
+    CHECK_THROWS_AS(sheet.SetCells({{"A25"_pos, "=A26"}, {"A26"_pos, "=A1"}}), CircularDependencyException);
+    CHECK(sheet.GetText("A25"_pos).empty());
+    CHECK(sheet.GetText("A26"_pos).empty());
+
+    /// A cycle closed by a reference within a band, through references across bands
+    sheet.SetCell("A25"_pos, "=A2");
+    CHECK_THROWS_AS(sheet.SetCell("A2"_pos, "=A1"), CircularDependencyException);
+    CHECK_THROWS_AS(sheet.SetCell("A2"_pos, "=A1+"), FormulaException);
+    sheet.SetCell("A2"_pos, "4");
+    CHECK(sheet.GetValue("A1"_pos) == CellInterface::Value(4.0));
+}
+
+TEST_CASE("Sharded sheet accepts concurrent writers and readers") {
+    constexpr int WRITERS = 4;
+    constexpr int BAND_ROWS = 100;
+    spreadsheet::ShardedSheet sheet(BAND_ROWS);
+    sheet.SetCell({WRITERS * BAND_ROWS, 0}, "1");
+
+    /// Every writer fills its band, the last row of a band reads the band below and the shared cell
+    std::atomic<bool> done = false;
+    std::vector<std::thread> threads;
+    for (int writer = 0; writer < WRITERS; ++writer) {
+        threads.emplace_back([&, writer] {
+            const int first_row = writer * BAND_ROWS;
+            for (int row = first_row; row < first_row + BAND_ROWS; ++row) {
+                sheet.SetCell({row, 0}, std::to_string(row));
+                sheet.SetCell({row, 1}, "=A" + std::to_string(row + 1) + "*2");
+            }
+            sheet.SetCell({first_row, 2}, "=B" + std::to_string(first_row + BAND_ROWS) + "+A" + std::to_string(WRITERS * BAND_ROWS + 1));
+        });
+    }
+    threads.emplace_back([&] {
+        while (!done.load()) {
+            for (int writer = 0; writer < WRITERS; ++writer) {
+                static_cast<void>(sheet.GetValue({writer * BAND_ROWS, 2}));
+            }
+        }
+    });
+    std::for_each(threads.begin(), threads.end() - 1, [](std::thread& thread) { thread.join(); });
+    done = true;
+    threads.back().join();
+
+    for (int writer = 0; writer < WRITERS; ++writer) {
+        const int last_row = writer * BAND_ROWS + BAND_ROWS - 1;
+        CHECK(sheet.GetValue({writer * BAND_ROWS, 2}) == CellInterface::Value(last_row * 2.0 + 1));
+    }
+    sheet.SetCell({WRITERS * BAND_ROWS, 0}, "2");
+    CHECK(sheet.GetValue({0, 2}) == CellInterface::Value((BAND_ROWS - 1) * 2.0 + 2));
+}
+
+TEST_CASE("Sharded sheet reads across bands in both directions while they are written") {
+    constexpr int BAND_ROWS = 10;
+    constexpr int ROUNDS = 200;
+    spreadsheet::ShardedSheet sheet(BAND_ROWS);
+
+    /// A1 reads the second band, which reads the first one back: readers of A1 and A12 lock the bands in opposite orders
+    sheet.SetCell("A2"_pos, "1");
+    sheet.SetCell("A11"_pos, "=A2*2");
+    sheet.SetCell("A12"_pos, "=A1+A2");
+    sheet.SetCell("A1"_pos, "=A11+1");
+    sheet.SetCell("A20"_pos, "1");
+
+    std::atomic<bool> done = false;
+    std::vector<std::thread> threads;
+    for (const Position pos : {"A1"_pos, "A12"_pos, "A1"_pos, "A12"_pos}) {
+        threads.emplace_back([&, pos] {
+            while (!done.load()) {
+                static_cast<void>(sheet.GetValue(pos));
+            }
+        });
+    }
+    for (const Position pos : {"A2"_pos, "A20"_pos}) {
+        threads.emplace_back([&, pos] {
+            for (int round = 1; round <= ROUNDS; ++round) {
+                sheet.SetCell(pos, std::to_string(round));
+            }
+        });
+    }
+    std::for_each(threads.end() - 2, threads.end(), [](std::thread& thread) { thread.join(); });
+    done = true;
+    std::for_each(threads.begin(), threads.end() - 2, [](std::thread& thread) { thread.join(); });
+
+    CHECK(sheet.GetValue("A1"_pos) == CellInterface::Value(ROUNDS * 2.0 + 1));
+    CHECK(sheet.GetValue("A12"_pos) == CellInterface::Value(ROUNDS * 3.0 + 1));
+}
@@ -0,0 +1,141 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "sheet.h"
+#include "test_utils.h"
+
+TEST_CASE("Snapshots keep contents and values of the moment they were taken") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A2"_pos, "=A1+1");
+    sheet.SetCell("B1"_pos, "'=text");
+    const auto before = sheet.Snapshot();
+
+    sheet.SetCell("A1"_pos, "10");
+    sheet.SetCell("A2"_pos, "=A1*2");
+    sheet.ClearCell("B1"_pos);
+    sheet.SetCell("C1"_pos, "=A2");
+    const auto after = sheet.Snapshot();
+
+    CHECK(before.GetText("A2"_pos) == "=A1+1");
+    CHECK(before.GetValue("A2"_pos) == CellInterface::Value(2.0));
+    CHECK(before.GetValue("B1"_pos) == CellInterface::Value("=text"));
+    CHECK(before.GetText("C1"_pos).empty());
+    CHECK(before.GetValue("C1"_pos) == CellInterface::Value(0.0));
+
+    CHECK(after.GetValue("A2"_pos) == CellInterface::Value(20.0));
+    CHECK(after.GetValue("C1"_pos) == CellInterface::Value(20.0));
+    CHECK(after.GetText("B1"_pos).empty());
+    CHECK(after.GetVersion() > before.GetVersion());
+
+    sheet.SetCell("D1"_pos, "=1/0");
+    CHECK(std::get<FormulaError>(sheet.Snapshot().GetValue("D1"_pos)) == FormulaError::Category::Div0);
+    CHECK_THROWS_AS((void)after.GetValue(Position::NONE), InvalidPositionException);
+}
+
+TEST_CASE("Snapshots see array formulas and spilled cells") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCells({{"A1"_pos, "1"}, {"A2"_pos, "2"}, {"A3"_pos, "3"}});
+    sheet.SetArrayFormula({"B1"_pos, {3, 1}}, "=A1:A3*2");
+    sheet.SetCell("C3"_pos, "=B3+1");
+    const auto with_array = sheet.Snapshot();
+
+    sheet.ClearCell("B1"_pos);
+    const auto without_array = sheet.Snapshot();
+
+    CHECK(with_array.GetText("B1"_pos) == "{=A1:A3*2}");
+    CHECK(with_array.GetText("B2"_pos).empty());
+    CHECK(with_array.GetValue("B2"_pos) == CellInterface::Value(4.0));
+    CHECK(with_array.GetValue("C3"_pos) == CellInterface::Value(7.0));
+    CHECK(without_array.GetValue("B2"_pos) == CellInterface::Value(0.0));
+    CHECK(without_array.GetValue("C3"_pos) == CellInterface::Value(1.0));
+}
+
+TEST_CASE("Snapshots evaluate long dependency chains without recursion") {
+    constexpr int DEPTH = 10000;
+    spreadsheet::Sheet sheet;
+    std::vector<std::pair<Position, std::string>> cells = {{{0, 0}, "1"}};
+    for (int row = 1; row < DEPTH; ++row) {
+        cells.emplace_back(Position{row, 0}, "=A" + std::to_string(row) + "+1");
+    }
+    sheet.SetCells(std::move(cells));
+
+    CHECK(sheet.Snapshot().GetValue({DEPTH - 1, 0}) == CellInterface::Value(static_cast<double>(DEPTH)));
+}
+
+TEST_CASE("Snapshots read consistent versions while the sheet is edited") {
+    constexpr int READERS = 4;
+    constexpr int EDITS = 2000;
+    spreadsheet::Sheet sheet;
+    sheet.SetCells({{"A1"_pos, "0"}, {"A2"_pos, "0"}, {"B1"_pos, "=A1-A2"}});
+
+    /// A1 and A2 are always written together: every snapshot sees them equal
+    std::atomic<bool> done = false;
+    std::atomic<int> inconsistent = 0;
+    std::vector<std::thread> readers;
+    for (int thread = 0; thread < READERS; ++thread) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                const auto snapshot = sheet.Snapshot();
+                const bool consistent =
+                    snapshot.GetText("A1"_pos) == snapshot.GetText("A2"_pos) && snapshot.GetValue("B1"_pos) == CellInterface::Value(0.0);
+                inconsistent += consistent ? 0 : 1;
+            }
+        });
+    }
+    for (int edit = 1; edit <= EDITS; ++edit) {
+        sheet.SetCells({{"A1"_pos, std::to_string(edit)}, {"A2"_pos, std::to_string(edit)}});
+    }
+    done = true;
+    std::for_each(readers.begin(), readers.end(), [](std::thread& reader) { reader.join(); });
+
+    CHECK(inconsistent == 0);
+    CHECK(sheet.Snapshot().GetText("A1"_pos) == std::to_string(EDITS));
+}
+
+TEST_CASE("Versions share the text of cells") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCells({{"A1"_pos, "2"}, {"A2"_pos, "1"}, {"B1"_pos, "=A1*10"}, {"C1"_pos, "'text"}});
+    const auto& versions = sheet.GetVersions();
+    for (const Position pos : {"A1"_pos, "B1"_pos, "C1"_pos}) {
+        CHECK(versions.Find(pos, versions.GetVersion())->text == sheet.GetCell(pos)->GetSharedText());
+    }
+    CHECK(versions.Find("D1"_pos, versions.GetVersion()) == nullptr);
+
+    /// References relabeled by a sort get a new buffer, the old one stays with the snapshot
+    const auto before = sheet.Snapshot();
+    sheet.SortRange({"A1"_pos, {2, 1}}, {{0, true}});
+    CHECK(sheet.GetCell("B1"_pos)->GetText() == "=A2*10");
+    CHECK(before.GetText("B1"_pos) == "=A1*10");
+    CHECK(sheet.Snapshot().GetValue("B1"_pos) == CellInterface::Value(20.0));
+}
+
+TEST_CASE("Superseded versions are reclaimed once no snapshot can see them") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "1");
+    {
+        const auto snapshot = sheet.Snapshot();
+        sheet.SetCell("A1"_pos, "2");
+        sheet.SetCell("A1"_pos, "3");
+        CHECK(sheet.GetVersions().GetRetainedCount() == 2);
+        CHECK(snapshot.GetText("A1"_pos) == "1");
+    }
+
+    sheet.SetCell("A2"_pos, "1");
+    CHECK(sheet.GetVersions().GetRetainedCount() == 0);
+
+    /// A snapshot may outlive its sheet
+    auto owner = std::make_unique<spreadsheet::Sheet>();
+    owner->SetCell("A1"_pos, "=2+2");
+    const auto orphan = owner->Snapshot();
+    owner.reset();
+    CHECK(orphan.GetValue("A1"_pos) == CellInterface::Value(4.0));
+}
@@ -0,0 +1,104 @@
+#include <doctest/doctest.h>
+
+#include <string>
+#include <vector>
+
+#include "sheet.h"
+#include "test_utils.h"
+
+namespace {
+    std::vector<std::string> GetTexts(const spreadsheet::Sheet& sheet, int col, int rows) {
+        std::vector<std::string> result;
+        for (int row = 0; row < rows; ++row) {
+            const auto* cell = sheet.GetCell({row, col});
+            result.push_back(cell != nullptr ? cell->GetText() : "");
+        }
+        return result;
+    }
+}
+
+TEST_CASE("Sort range reorders rows by keys") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "3");
+    sheet.SetCell("A2"_pos, "text");
+    sheet.SetCell("A3"_pos, "1");
+    sheet.SetCell("A5"_pos, "2");
+    sheet.SetCell("B1"_pos, "c");
+    sheet.SetCell("B2"_pos, "t");
+    sheet.SetCell("B3"_pos, "a");
+    sheet.SetCell("B4"_pos, "empty");
+    sheet.SetCell("B5"_pos, "b");
+    sheet.SetCell("C1"_pos, "outside");
+
+    sheet.SortRange({"A1"_pos, {5, 2}}, {{0, true}});
+    CHECK(GetTexts(sheet, 0, 5) == std::vector<std::string>{"1", "2", "3", "text", ""});
+    CHECK(GetTexts(sheet, 1, 5) == std::vector<std::string>{"a", "b", "c", "t", "empty"});
+    CHECK(sheet.GetCell("C1"_pos)->GetText() == "outside");
+
+    sheet.SortRange({"A1"_pos, {5, 2}}, {{0, false}});
+    CHECK(GetTexts(sheet, 1, 5) == std::vector<std::string>{"t", "c", "b", "a", "empty"});
+
+    /// Equal keys keep their order, the second key breaks ties
+    sheet.SetCell("A1"_pos, "1");
+    sheet.SetCell("A2"_pos, "1");
+    sheet.SortRange({"A1"_pos, {4, 2}}, {{0, true}});
+    CHECK(GetTexts(sheet, 1, 4) == std::vector<std::string>{"t", "c", "a", "b"});
+    sheet.SortRange({"A1"_pos, {4, 2}}, {{0, true}, {1, true}});
+    CHECK(GetTexts(sheet, 1, 4) == std::vector<std::string>{"a", "c", "t", "b"});
+
+    CHECK_THROWS_AS(sheet.SortRange({"A1"_pos, {4, 2}}, {{2, true}}), InvalidPositionException);
+    CHECK_THROWS_AS(sheet.SortRange({"A1"_pos, {0, 2}}, {{0, true}}), InvalidPositionException);
+}
+
+TEST_CASE("Sort range moves references with cells") {
+    spreadsheet::Sheet sheet;
+    for (int row = 0; row < 16000; row += 1000) {
+        sheet.SetCell({row, 0}, std::to_string(20 - row / 1000));
+        sheet.SetCell({row, 1}, "=A" + std::to_string(row + 1) + "*2");
+    }
+    sheet.SetCell("D1"_pos, "=A1+B1");
+    sheet.SetArrayFormula({"E1"_pos, {3, 1}}, "=A1:A3+B1*0");
+    sheet.SetCell("F1"_pos, "=E1+1");
+    REQUIRE(std::get<double>(sheet.GetValue("D1"_pos)) == 60);
+    REQUIRE(std::get<double>(sheet.GetValue("E1"_pos)) == 20);
+    REQUIRE(std::get<double>(sheet.GetValue("F1"_pos)) == 21);
+
+    sheet.SortRange({"A1"_pos, {Position::MAX_ROWS, 2}}, {{0, true}}, 4);
+
+    /// Row 1 moved to row 16 and empty rows went last; references follow the moved cells
+    CHECK(sheet.GetCell("A1"_pos)->GetText() == "5");
+    CHECK(sheet.GetCell("B1"_pos)->GetText() == "=A1*2");
+    CHECK(sheet.GetCell("B16"_pos)->GetText() == "=A16*2");
+    CHECK(std::get<double>(sheet.GetValue("B16"_pos)) == 40);
+    CHECK(sheet.GetCell("D1"_pos)->GetText() == "=A16+B16");
+    CHECK(std::get<double>(sheet.GetValue("D1"_pos)) == 60);
+
+    /// The range is positional: A1:A3 now holds 5, 6 and 7
+    CHECK(sheet.GetCell("E1"_pos)->GetText() == "{=A1:A3+B16*0}");
+    CHECK(std::get<double>(sheet.GetValue("E3"_pos)) == 7);
+    CHECK(std::get<double>(sheet.GetValue("F1"_pos)) == 6);
+
+    /// Sorting a few rows relinks only the formulas around them
+    sheet.SortRange({"A1"_pos, {2, 2}}, {{0, false}});
+    CHECK(sheet.GetCell("B2"_pos)->GetText() == "=A2*2");
+    CHECK(std::get<double>(sheet.GetValue("B2"_pos)) == 10);
+    CHECK(std::get<double>(sheet.GetValue("F1"_pos)) == 7);
+    sheet.SetCell("A1"_pos, "0");
+    CHECK(std::get<double>(sheet.GetValue("F1"_pos)) == 1);
+
+    /// Dependencies follow the moved cells
+    sheet.SetCell("A16"_pos, "100");
+    CHECK(std::get<double>(sheet.GetValue("D1"_pos)) == 300);
+    CHECK_THROWS_AS(sheet.SetCell("A16"_pos, "=D1"), CircularDependencyException);
+}
+
+TEST_CASE("Sort range rejects array blocks") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "2");
+    sheet.SetCell("A2"_pos, "1");
+    sheet.SetArrayFormula({"B1"_pos, {2, 1}}, "=A1:A2");
+
+    CHECK_THROWS_AS(sheet.SortRange({"A1"_pos, {2, 2}}, {{0, true}}), ArrayFormulaException);
+    sheet.SortRange({"A1"_pos, {2, 1}}, {{0, true}});
+    CHECK(std::get<double>(sheet.GetValue("B1"_pos)) == 1);
+}
@@ -1,10 +1,7 @@
 #include <doctest/doctest.h>
 
 #include "common.h"
-
-inline Position operator"" _pos(const char* str, std::size_t) {
-    return Position::FromString(str);
-}
+#include "test_utils.h"
 
 TEST_CASE("Set and Get Cell") {
     auto sheet = CreateSheet();
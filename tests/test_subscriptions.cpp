@@ -0,0 +1,130 @@
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "sheet.h"
+#include "test_utils.h"
+
+namespace {
+
+    /// Batches delivered to one subscription, in order
+    struct Recorder {
+        std::vector<std::vector<spreadsheet::CellChange>> batches;
+
+        spreadsheet::ChangeCallback Callback() {
+            return [this](const std::vector<spreadsheet::CellChange>& changes) { batches.push_back(changes); };
+        }
+    };
+}
+
+TEST_CASE("Subscriptions receive the changed values of their ranges after recalculation") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCells({{"A1"_pos, "1"}, {"A2"_pos, "6"}, {"B1"_pos, "=A1*2"}, {"B2"_pos, "=MIN(A2,5)"}, {"C1"_pos, "=B1+B2"}});
+
+    Recorder column_b, total;
+    sheet.Subscribe({"B1"_pos, {2, 1}}, column_b.Callback());
+    sheet.Subscribe({"C1"_pos, {1, 1}}, total.Callback());
+    CHECK(sheet.DeliverChanges() == 0);
+
+    /// Values computed on demand only become changes once a recalculation completes
+    sheet.SetCell("A1"_pos, "10");
+    CHECK(sheet.GetValue("C1"_pos) == CellInterface::Value(25.0));
+    CHECK(sheet.DeliverChanges() == 0);
+    sheet.Recalculate();
+    CHECK(sheet.DeliverChanges() == 2);
+    REQUIRE(column_b.batches.size() == 1);
+    REQUIRE(column_b.batches[0].size() == 1);
+    CHECK(column_b.batches[0][0].pos == "B1"_pos);
+    CHECK(column_b.batches[0][0].value == CellInterface::Value(20.0));
+    REQUIRE(total.batches.size() == 1);
+    CHECK(total.batches[0][0].value == CellInterface::Value(25.0));
+
+    /// The saturated MIN keeps its value, so does the total
+    sheet.SetCell("A2"_pos, "7");
+    sheet.Recalculate();
+    CHECK(sheet.DeliverChanges() == 0);
+
+    /// Edits outside the ranges and their dependents are not reported, cleared cells are
+    sheet.SetCell("D1"_pos, "=A2");
+    sheet.ClearCell("B2"_pos);
+    sheet.Recalculate();
+    CHECK(sheet.DeliverChanges() == 2);
+    REQUIRE(column_b.batches.size() == 2);
+    CHECK(column_b.batches[1][0].pos == "B2"_pos);
+    CHECK(column_b.batches[1][0].value == CellInterface::Value(0.0));
+    REQUIRE(total.batches.size() == 2);
+    CHECK(total.batches[1][0].value == CellInterface::Value(20.0));
+
+    CHECK_THROWS_AS(sheet.Subscribe({Position::NONE, {1, 1}}, column_b.Callback()), InvalidPositionException);
+}
+
+TEST_CASE("Subscriptions coalesce changes within their window") {
+    using namespace std::chrono_literals;
+
+    spreadsheet::Sheet sheet;
+    sheet.SetRecalculationMode(spreadsheet::RecalculationMode::eager);
+    sheet.SetCells({{"A1"_pos, "1"}, {"A2"_pos, "=A1+1"}});
+    sheet.SetArrayFormula({"B1"_pos, {2, 1}}, "=A1:A2*10");
+
+    Recorder recorder;
+    const spreadsheet::SubscriptionId id = sheet.Subscribe({"A2"_pos, {1, 2}}, recorder.Callback(), 1h);
+    const auto start = spreadsheet::ChangeFeed::Clock::now();
+
+    sheet.SetCell("A1"_pos, "2");
+    CHECK(sheet.DeliverChanges(start) == 1);
+    REQUIRE(recorder.batches.size() == 1);
+    REQUIRE(recorder.batches[0].size() == 2);
+    CHECK(recorder.batches[0][0].pos == "A2"_pos);
+    CHECK(recorder.batches[0][1].pos == "B2"_pos);
+    CHECK(recorder.batches[0][1].value == CellInterface::Value(30.0));
+
+    /// Three edits within the window are delivered once, with the latest values
+    sheet.SetCell("A1"_pos, "3");
+    sheet.SetCell("A1"_pos, "4");
+    CHECK(sheet.DeliverChanges(start + 30min) == 0);
+    sheet.SetCell("A1"_pos, "5");
+    CHECK(sheet.DeliverChanges(start + 1h) == 1);
+    REQUIRE(recorder.batches.size() == 2);
+    REQUIRE(recorder.batches[1].size() == 2);
+    CHECK(recorder.batches[1][0].value == CellInterface::Value(6.0));
+    CHECK(recorder.batches[1][1].value == CellInterface::Value(60.0));
+
+    /// Pending changes of a cancelled subscription are dropped
+    sheet.SetCell("A1"_pos, "6");
+    sheet.Unsubscribe(id);
+    CHECK(sheet.DeliverChanges(start + 3h) == 0);
+    CHECK(recorder.batches.size() == 2);
+}
+
+TEST_CASE("Changes are delivered on another thread while the sheet is edited") {
+    constexpr int EDITS = 500;
+
+    spreadsheet::Sheet sheet;
+    sheet.SetRecalculationMode(spreadsheet::RecalculationMode::eager);
+    sheet.SetCells({{"A1"_pos, "0"}, {"B1"_pos, "=A1*2"}});
+
+    std::atomic<double> last = 0.0;
+    std::atomic<bool> done = false;
+    sheet.Subscribe({"B1"_pos, {1, 1}}, [&last](const std::vector<spreadsheet::CellChange>& changes) {
+        last = std::get<double>(changes.back().value);
+    });
+
+    std::thread consumer([&] {
+        while (!done) {
+            sheet.DeliverChanges();
+        }
+        sheet.DeliverChanges();
+    });
+    for (int i = 1; i <= EDITS; ++i) {
+        sheet.SetCell("A1"_pos, std::to_string(i));
+    }
+    done = true;
+    consumer.join();
+    CHECK(last == 2.0 * EDITS);
+}
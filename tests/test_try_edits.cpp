@@ -0,0 +1,90 @@
+#include <doctest/doctest.h>
+
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "formula.h"
+#include "sheet.h"
+#include "test_utils.h"
+
+namespace {
+
+    std::string PrintTexts(const spreadsheet::Sheet& sheet) {
+        std::ostringstream output;
+        sheet.PrintTexts(output);
+        return output.str();
+    }
+}
+
+TEST_CASE("Try edits report rejected edits without changing the sheet") {
+    using spreadsheet::EditStatus;
+
+    spreadsheet::Sheet sheet;
+    CHECK(sheet.TrySetCell("A1"_pos, "=B1+1").IsOk());
+    CHECK(sheet.TrySetCell("B1"_pos, "2").IsOk());
+    sheet.SetArrayFormula({"C1"_pos, {2, 1}}, "=A1:A2*2");
+    const std::string texts = PrintTexts(sheet);
+    const Size size = sheet.GetPrintableSize();
+
+    const auto rejected = [&](Position pos, std::string text, EditStatus status, std::uint32_t offset) {
+        const spreadsheet::EditResult result = sheet.TrySetCell(pos, std::move(text));
+        CHECK(result.status == status);
+        CHECK(result.offset == offset);
+        CHECK_FALSE(result.message.empty());
+    };
+    rejected(Position::NONE, "1", EditStatus::invalid_position, 0);
+    rejected("E9"_pos, "=1+", EditStatus::syntax_error, 3);
+    rejected("E9"_pos, "=A1 + $B1", EditStatus::syntax_error, 6);
+    rejected("E9"_pos, "=SUM(A1)", EditStatus::syntax_error, 1);
+    rejected("E9"_pos, "=IF(A1,1,2,3)", EditStatus::syntax_error, 1);
+    rejected("E9"_pos, "=B2:A1*2", EditStatus::syntax_error, 1);
+    rejected("E9"_pos, "=(1+2", EditStatus::syntax_error, 5);
+    rejected("E9"_pos, "=1 2", EditStatus::syntax_error, 3);
+    rejected("B1"_pos, "=A1", EditStatus::circular_dependency, 0);
+    rejected("C2"_pos, "1", EditStatus::array_conflict, 0);
+    CHECK(sheet.TryClearCell("C2"_pos).status == EditStatus::array_conflict);
+    CHECK(sheet.TryClearCell(Position::NONE).status == EditStatus::invalid_position);
+
+    CHECK(PrintTexts(sheet) == texts);
+    CHECK(sheet.GetPrintableSize() == size);
+    CHECK(sheet.GetValue("A1"_pos) == CellInterface::Value(3.0));
+
+    CHECK(sheet.TryClearCell("B1"_pos).IsOk());
+    CHECK(sheet.GetValue("A1"_pos) == CellInterface::Value(1.0));
+
+    /// The throwing methods report the same rejections as exceptions
+    CHECK_THROWS_AS(sheet.SetCell("E9"_pos, "=1+"), FormulaException);
+    CHECK_THROWS_AS(sheet.SetCell("C2"_pos, "1"), ArrayFormulaException);
+    CHECK_THROWS_AS(sheet.ClearCell(Position::NONE), InvalidPositionException);
+}
+
+TEST_CASE("Clearing an empty position keeps the other cells of its row") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "5");
+    sheet.SetCell("A2"_pos, "=A1*2");
+    CHECK(sheet.GetValue("A2"_pos) == CellInterface::Value(10.0));
+
+    CHECK(sheet.TryClearCell("D1"_pos).IsOk());
+    REQUIRE(sheet.GetCell("A1"_pos) != nullptr);
+    CHECK(sheet.GetCell("A1"_pos)->GetText() == "5");
+    CHECK(sheet.GetValue("A2"_pos) == CellInterface::Value(10.0));
+    CHECK(sheet.Snapshot().GetText("A1"_pos) == "5");
+    CHECK(sheet.GetPrintableSize() == Size{2, 1});
+}
+
+TEST_CASE("CheckFormula accepts exactly the formulas the parser accepts") {
+    for (const std::string_view valid : {"1", "1+2*3", "-(A1)", "+-1", ".5e-3", "1E+2", "A1:B2", "Sheet2!A1", "'Q1 data'!A1:B3",
+                                         "IF(A1>=1,MIN(1,2),NOT(B1<>2))", "AND(1)", " ( 1 ) ", "A1=B1", "1e-400"}) {
+        CAPTURE(valid);
+        CHECK_FALSE(CheckFormula(valid).has_value());
+        CHECK_NOTHROW(ParseFormula(std::string(valid)));
+    }
+    for (const std::string_view invalid : {"", " ", "1+", "1.", "1e", "(1", "1)", "A1:", ":A1", "a1", "A", "A0", "ZZZZ1", "B2:A1",
+                                           "FOO(1)", "MIN()", "NOT(1,2)", "IF(1)", "Sheet2!", "Sheet2!1", "'Q1 data'A1", "1,2", "1 2", "#",
+                                           "1e999", "2*1E+400"}) {
+        CAPTURE(invalid);
+        CHECK(CheckFormula(invalid).has_value());
+        CHECK_THROWS_AS(ParseFormula(std::string(invalid)), FormulaException);
+    }
+}
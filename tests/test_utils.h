@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+
+#include "common.h"
+
+inline Position operator"" _pos(const char* str, std::size_t) {
+    return Position::FromString(str);
+}
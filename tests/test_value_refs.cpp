@@ -0,0 +1,42 @@
+#include <doctest/doctest.h>
+
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "sheet.h"
+#include "test_utils.h"
+
+TEST_CASE("Value views reference texts of the sheet without copying them") {
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "'=not a formula");
+    sheet.SetCell("A2"_pos, " 12");
+    sheet.SetCell("A3"_pos, "12 ");
+    sheet.SetCell("A4"_pos, std::string(80, '0') + "7");
+    sheet.SetCell("B1"_pos, "=A2*2");
+    sheet.SetCell("B2"_pos, "=A3*2");
+    sheet.SetCell("B3"_pos, "=A4+1");
+    sheet.SetCell("B4"_pos, "=1/0");
+    sheet.SetArrayFormula({"C1"_pos, {2, 1}}, "=B1:B2");
+
+    const auto text = std::get<std::string_view>(sheet.GetValueRef("A1"_pos));
+    CHECK(text == "=not a formula");
+    CHECK(std::get<std::string_view>(sheet.GetValueRef("A1"_pos)).data() == text.data());
+    CHECK(sheet.GetValue("A1"_pos) == CellInterface::Value("=not a formula"));
+
+    /// Formulas read texts through views as they read copies
+    CHECK(sheet.GetValueRef("B1"_pos) == CellInterface::ValueRef(24.0));
+    CHECK(std::get<FormulaError>(sheet.GetValueRef("B2"_pos)) == FormulaError::Category::Value);
+    CHECK(sheet.GetValueRef("B3"_pos) == CellInterface::ValueRef(8.0));
+    CHECK(std::get<FormulaError>(sheet.GetValueRef("B4"_pos)) == FormulaError::Category::Div0);
+    CHECK(sheet.GetValueRef("C1"_pos) == CellInterface::ValueRef(24.0));
+    CHECK(std::get<FormulaError>(sheet.GetValueRef("C2"_pos)) == FormulaError::Category::Value);
+    CHECK(sheet.GetValueRef("D9"_pos) == CellInterface::ValueRef(0.0));
+    CHECK_THROWS_AS((void)sheet.GetValueRef(Position::NONE), InvalidPositionException);
+
+    const auto snapshot = sheet.Snapshot();
+    sheet.SetCell("A1"_pos, "changed");
+    CHECK(std::get<std::string_view>(snapshot.GetValueRef("A1"_pos)) == "=not a formula");
+    CHECK(std::get<std::string_view>(sheet.GetValueRef("A1"_pos)) == "changed");
+    CHECK(CellInterface::CopyValue(snapshot.GetValueRef("B3"_pos)) == CellInterface::Value(8.0));
+}
@@ -0,0 +1,109 @@
+#include <doctest/doctest.h>
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sheet.h"
+#include "test_utils.h"
+#include "workbook.h"
+
+TEST_CASE("Workbook follows references across sheets") {
+    spreadsheet::Workbook book;
+    book.AddSheet("Sheet1");
+    book.AddSheet("Sheet2");
+    book.AddSheet("Q1 data");
+    CHECK(book.GetSheetNames() == std::vector<std::string>{"Sheet1", "Sheet2", "Q1 data"});
+    CHECK_THROWS_AS(book.AddSheet("Sheet1"), std::invalid_argument);
+    CHECK_THROWS_AS(book.AddSheet("a!b"), std::invalid_argument);
+
+    book.SetCell("Q1 data", "A1"_pos, "1");
+    book.SetCell("Q1 data", "A2"_pos, "2");
+    book.SetCell("Sheet1", "A1"_pos, "=Sheet2!B1*2");
+    book.SetCell("Sheet2", "B1"_pos, "=  'Q1 data'!A1 + A1");
+    book.SetArrayFormula("Sheet2", {"C1"_pos, {2, 1}}, "='Q1 data'!A1:A2*10");
+    book.SetCell("Sheet1", "B1"_pos, "=Sheet2!C2+Sheet1!A1");
+    CHECK(book.GetSheet("Sheet2").GetCell("B1"_pos)->GetText() == "='Q1 data'!A1+A1");
+    CHECK(book.GetValue("Sheet1", "A1"_pos) == CellInterface::Value(2.0));
+    CHECK(book.GetValue("Sheet1", "B1"_pos) == CellInterface::Value(22.0));
+
+    /// Edits reach readers on other sheets, through as many sheets as it takes
+    book.SetCell("Q1 data", "A1"_pos, "5");
+    book.SetCell("Sheet2", "A1"_pos, "1");
+    CHECK(book.GetValue("Sheet1", "A1"_pos) == CellInterface::Value(12.0));
+    book.SetCell("Q1 data", "A2"_pos, "3");
+    CHECK(book.GetValue("Sheet1", "B1"_pos) == CellInterface::Value(42.0));
+    book.ClearCell("Q1 data", "A1"_pos);
+    CHECK(book.GetValue("Sheet1", "A1"_pos) == CellInterface::Value(2.0));
+
+    /// Unknown sheets are rejected, a sheet outside of a workbook reads them as reference errors
+    CHECK_THROWS_AS(book.SetCell("Sheet1", "C1"_pos, "=Sheet3!A1"), FormulaException);
+    CHECK_THROWS_AS(book.SetCell("Sheet3", "C1"_pos, "1"), UnknownSheetException);
+    CHECK_THROWS_AS(static_cast<void>(book.GetValue("sheet1", "A1"_pos)), UnknownSheetException);
+    CHECK(book.GetSheet("Sheet1").GetCell("C1"_pos) == nullptr);
+    spreadsheet::Sheet sheet;
+    sheet.SetCell("A1"_pos, "=Sheet2!A1");
+    CHECK(sheet.GetValue("A1"_pos) == CellInterface::Value(FormulaError(FormulaError::Category::Ref)));
+}
+
+TEST_CASE("Workbook rejects cycles across sheets") {
+    spreadsheet::Workbook book;
+    book.AddSheet("Sheet1");
+    book.AddSheet("Sheet2");
+
+    book.SetCell("Sheet1", "A1"_pos, "=Sheet2!A1");
+    CHECK_THROWS_AS(book.SetCell("Sheet2", "A1"_pos, "=Sheet1!A1+1"), CircularDependencyException);
+    CHECK_THROWS_AS(book.SetCell("Sheet1", "B1"_pos, "=Sheet1!B1"), CircularDependencyException);
+
+    /// A cycle closed by a reference within a sheet, through references across sheets
+    book.SetCell("Sheet2", "A1"_pos, "=B1");
+    CHECK_THROWS_AS(book.SetCell("Sheet2", "B1"_pos, "=Sheet1!A1"), CircularDependencyException);
+    CHECK_THROWS_AS(book.SetCells("Sheet2", {{"C1"_pos, "1"}, {"B1"_pos, "=C1+Sheet1!A1"}}), CircularDependencyException);
+    CHECK(book.GetSheet("Sheet2").GetCell("C1"_pos) == nullptr);
+
+    /// A cycle through a cell an array formula would spill into
+    book.SetCell("Sheet2", "B1"_pos, "=Sheet1!C2");
+    CHECK_THROWS_AS(book.SetArrayFormula("Sheet1", {"C1"_pos, {2, 1}}, "=Sheet2!A1"), CircularDependencyException);
+
+    book.SetCell("Sheet1", "C2"_pos, "4");
+    CHECK(book.GetValue("Sheet1", "A1"_pos) == CellInterface::Value(4.0));
+}
+
+TEST_CASE("Workbook recalculates sheets in dependency order") {
+    constexpr int SHEETS = 6;
+    constexpr int ROWS = 50;
+    spreadsheet::Workbook book;
+    for (int sheet = 0; sheet < SHEETS; ++sheet) {
+        book.AddSheet("S" + std::to_string(sheet));
+    }
+
+    /// Two chains of sheets, S0 <- S2 <- S4 and S1 <- S3 <- S5, the last two sheets reading each other too
+    for (int row = 0; row < ROWS; ++row) {
+        const std::string cell = Position{row, 0}.ToString();
+        book.SetCell("S0", {row, 0}, std::to_string(row));
+        book.SetCell("S1", {row, 0}, std::to_string(row));
+        for (int sheet = 2; sheet < SHEETS; ++sheet) {
+            book.SetCell("S" + std::to_string(sheet), {row, 0}, "=S" + std::to_string(sheet - 2) + '!' + cell + "+1");
+        }
+        book.SetCell("S4", {row, 1}, "=S5!" + cell);
+        book.SetCell("S5", {row, 1}, "=S4!" + cell);
+    }
+    CHECK(book.Recalculate(4).evaluated > 0);
+    CHECK(book.Recalculate(4).evaluated == 0);
+    CHECK(book.GetValue("S5", "A50"_pos) == CellInterface::Value(51.0));
+
+    /// Sheets of one cycle may compute values of each other on demand, a value is computed once either way
+    book.SetCell("S0", "A7"_pos, "100");
+    const auto stats = book.Recalculate(4);
+    CHECK(stats.evaluated >= 3);
+    CHECK(stats.evaluated <= 4);
+    CHECK(book.GetValue("S4", "A7"_pos) == CellInterface::Value(102.0));
+    CHECK(book.GetValue("S5", "B7"_pos) == CellInterface::Value(102.0));
+    CHECK(book.GetValue("S4", "B7"_pos) == CellInterface::Value(8.0));
+
+    /// The workers of the workbook are the only ones: sheets do not start pools of their own
+    for (int sheet = 0; sheet < SHEETS; ++sheet) {
+        CHECK(book.GetSheet("S" + std::to_string(sheet)).GetRecalculationThreads() == 1);
+    }
+}